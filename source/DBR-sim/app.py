@@ -165,19 +165,10 @@ def init(user_args):
     
     if args.dispersal_mode == "all" or args.dispersal_mode == "animal":
 
-        # Export resource grid lookup table
+        # Load resource grid lookup tables from the native cache (computed and cached on first use)
         print("animal species: ", animal_species)
         for species in animal_species:
-            lookup_table, fpath = io.get_lookup_table(species, args.grid_width, args.resource_grid_width * args.resource_grid_width)
-            #lookup_table = None # Hotfix; lookup table might lead to memory leaks (?)
-            if lookup_table is None:
-                print(f"Lookup table file {fpath} not found. Creating new one...")
-                dynamics.precompute_resourcegrid_lookup_table(species)
-                lookup_table = dynamics.get_resource_grid_lookup_table(species)
-                io.export_lookup_table(lookup_table, args.grid_width, species)
-            else:
-                print(f"Lookup table file {fpath} found. Loading...")
-                dynamics.set_resource_grid_lookup_table(lookup_table, species)
+            dynamics.init_resourcegrid_lookup_table(species, cfg.DATA_INTERNAL_DIR, getattr(args, "shared_lookup_tables", False))
 
     return dynamics, color_dicts
 
@@ -204,7 +195,7 @@ def do_visualizations(dynamics, fire_freq_arrays, fire_no_timesteps, verbose, co
         vis.save_image(recruitment_img, imagepath_recruitment, get_max(1000, recruitment_img.shape[0]), interpolation="none")
     
     if ("fire_freq" in visualization_types):
-        fire_freq_arrays.append(dynamics.state.grid.get_distribution(0) == -5)
+        fire_freq_arrays.append(dynamics.state.grid.get_distribution(0, copy=False) == -5)
         if dynamics.time > fire_no_timesteps:
             print("Saving fire frequency img...") if verbose else None
             fire_freq_img = vis.get_fire_freq_image(fire_freq_arrays[-fire_no_timesteps:], color_dicts["fire_freq"], dynamics.state.grid.width, fire_no_timesteps)
@@ -325,6 +316,44 @@ def updateloop(dynamics, color_dicts, **user_args):
     return dynamics, slope, largest_absolute_slope, initial_no_dispersals
 
 
+def get_stop_conditions(user_args):
+    stop_conditions = cpp.StopConditions()
+    stop_conditions.max_timesteps = int(user_args["max_timesteps"])
+    stop_conditions.max_tree_cover = 0.93 if user_args["termination_conditions"] == "all" else 2.0
+    stop_conditions.initial_tree_cover = user_args["treecover"]
+    return stop_conditions
+
+
+def run_headless(dynamics, **user_args):
+    # Headless counterpart of updateloop(). Timesteps and termination checks run natively with the GIL released;
+    # Python is only called back to snapshot the state after each timestep. The snapshots are written to disk by a
+    # background thread while the next timestep is simulated.
+    print("Beginning simulation (native loop)...")
+    export = {"csv_path": user_args["csv_path"], "init_csv": True}
+    args = SimpleNamespace(**user_args)
+    exporter = io.AsyncExporter()
+
+    def observe(dynamics):
+        path, fieldnames, row = io.get_state_row(
+            dynamics, export["csv_path"], export["init_csv"], tree_cover_slope=dynamics.run_statistics.slope, args=args
+        )
+        exporter.submit(io.write_state_row, path, fieldnames, row, export["init_csv"])
+        export["csv_path"] = path
+        export["init_csv"] = False
+        if user_args["report_state"] == "True" or user_args["report_state"] == True:
+            exporter.submit(io.write_state_report, dynamics.time, dynamics.state.get_state_table())
+        return True
+
+    try:
+        termination_cause = dynamics.run(int(user_args["max_timesteps"]), get_stop_conditions(user_args), 1, observe)
+    finally:
+        exporter.close()
+    if termination_cause:
+        print("\nSimulation terminated. Cause:", termination_cause)
+    statistics = dynamics.run_statistics
+    return dynamics, statistics.slope, statistics.largest_absolute_slope, statistics.initial_no_dispersals
+
+
 def test_kernel():
     cpp.init_RNG()
     dist_max = 200
@@ -366,6 +395,8 @@ def main(batch_parameters=None, **user_args):
     user_args["patch_width"] = round(user_args["patch_width"], 2)
 
     dynamics, color_dicts = init(user_args)
+    if user_args["headless"]:
+        return run_headless(dynamics, **user_args)
     return updateloop(dynamics, color_dicts, **user_args)
  
 
@@ -95,6 +95,7 @@ defaults = {
     #"batch_parameters": "{\"control_variable\": \"growth_rate_multiplier_params-><idx>0\", \"control_value\": 0.99}"
     "batch_parameters": "",
     "report_state": False,
+    "shared_lookup_tables": False,
     "animal_group_size": 10,
     "image_size":(1000, 1000),
     "mean_radius":30,
@@ -158,6 +159,19 @@ _parameter_config = {
             ),
         },
     },
+    "shared_lookup_tables": {
+        "keys": {
+            "cli": ["--shared_lookup_tables", "-slt"]
+        },
+        "settings": {
+            "action": "store_true",
+            "help": (
+                "Share resource grid lookup tables between simulations on the same machine through named shared memory. Default false. "
+                "On Linux and macOS the segments (on Linux /dev/shm/dbr_lut_*) persist after the simulations exit, so that later batch processes "
+                "can reuse them; remove them once all processes are done (e.g. with Dynamics.remove_shared_resourcegrid_lookup_tables())."
+            ),
+        },
+    },
     "treecover": {
         "keys": {
             "cli": ["--treecover", "-tc"]
@@ -6,6 +6,8 @@ import datetime
 from shutil import ExecError
 import cv2
 import time
+import queue
+import threading
 from config import *
 import numpy as np
 
@@ -24,7 +26,7 @@ def get_firefree_interval_stats(dynamics, _type):
     return mean, stdev
 
 
-def export_state(
+def get_state_row(
         dynamics, path="", init_csv=True, control_variable=None, control_value=None, tree_cover_slope=0,
         extra_parameters="", secondary_variable=None, secondary_value=None, dependent_var=None, dependent_val=None, initial_no_dispersals=None, dependent_result_range_stdev=None,
         args=None
@@ -52,66 +54,81 @@ def export_state(
         fieldnames.insert(0, "dependent_result_range_stdev")
     if not args.rotate_randomly:
         fieldnames.insert(3, "global_rotation_offset")
+    if init_csv and path == "":
+        print("\n\nExport location:", cfg.EXPORT_DIR)
+        path = os.path.join(cfg.EXPORT_DIR, "Simulation_" + str(datetime.datetime.now()).replace(":", "-") + ".csv")
+
+    tree_sizes = get_tree_sizes(dynamics)
+    firefree_interval_mean, firefree_interval_stdev = get_firefree_interval_stats(dynamics, "current_iteration")
+    firefree_interval_fullsim_mean, firefree_interval_fullsim_stdev = get_firefree_interval_stats(dynamics, "average")
+    fires = dynamics.get_fires()
+    fires = "|".join([str(fire) for fire in fires])
+    result = {
+        "time": str(dynamics.time),
+        "tree_cover": str(dynamics.state.grid.get_tree_cover()), 
+        "slope": str(tree_cover_slope),
+        "population_size": str(dynamics.state.population.size()),
+        "#seeds_produced": str(dynamics.seeds_produced),
+        "fires": fires,
+        "trees[dbh_0-20%]": tree_sizes[0],
+        "trees[dbh_20-40%]": tree_sizes[1],
+        "trees[dbh_40-60%]": tree_sizes[2],
+        "trees[dbh_60-80%]": tree_sizes[3],
+        "trees[dbh_80-100%]": tree_sizes[4],
+        "top_kills": str(dynamics.get_no_fire_induced_topkills()),
+        "deaths": str(dynamics.get_no_fire_induced_deaths()),
+        "extra_parameters": extra_parameters,
+        "firefree_interval_mean": firefree_interval_mean,
+        "firefree_interval_stdev": firefree_interval_stdev,
+        "firefree_interval_full_sim_mean": firefree_interval_fullsim_mean,
+        "firefree_interval_full_sim_stdev": firefree_interval_fullsim_stdev,
+        "recruits": str(dynamics.get_no_recruits("all")),
+        "initial_no_dispersals": str(dynamics.get_initial_no_dispersals()),
+        "time_spent_moving": str(dynamics.get_fraction_time_spent_moving()),
+        "shaded_out": str(dynamics.get_fraction_seedlings_dead_due_to_shade()),
+        "nonseedling_top_kills": str(dynamics.get_no_fire_induced_nonseedling_topkills()),
+        "outcompeted_by_seedlings": str(dynamics.get_fraction_seedlings_outcompeted()),
+        "outcompeted_by_oldstems": str(dynamics.get_fraction_seedlings_outcompeted_by_older_trees()),
+        "germination_attempts": str(dynamics.get_no_germination_attempts()),
+        "oldstem_competition_and_shading": str(dynamics.get_fraction_cases_oldstem_competition_and_shading()),
+        "seedling_competition_and_shading": str(dynamics.get_fraction_cases_seedling_competition_and_shading())
+    }
+    if not args.rotate_randomly:
+        result["global_rotation_offset"] = str(args.global_rotation_offset)
+    if control_variable:
+        result[control_variable] = control_value
+    if secondary_variable:
+        result[secondary_variable] = secondary_value
+    if dependent_var:
+        result[dependent_var] = dependent_val
+    if initial_no_dispersals:
+        result["initial_number_of_dispersals"] = initial_no_dispersals
+    if dependent_result_range_stdev:
+        result["dependent_result_range_stdev"] = dependent_result_range_stdev
+    return path, fieldnames, result
+
+
+def write_state_row(path, fieldnames, result, init_csv):
+    # Append a row obtained from get_state_row() to the CSV file at <path>, writing the header first if the file is new.
     if init_csv and not os.path.exists(path):
-        if path == "":
-            print("\n\nExport location:", cfg.EXPORT_DIR)
-            path = os.path.join(cfg.EXPORT_DIR, "Simulation_" + str(datetime.datetime.now()).replace(":", "-") + ".csv")
         with open(path, 'w', newline='') as csvfile:
             writer = csv.DictWriter(csvfile, fieldnames=fieldnames)
             writer.writeheader()
-        
-
     with open(path, 'a', newline='') as csvfile:
         writer = csv.DictWriter(csvfile, fieldnames=fieldnames)
-        tree_sizes = get_tree_sizes(dynamics)
-        firefree_interval_mean, firefree_interval_stdev = get_firefree_interval_stats(dynamics, "current_iteration")
-        firefree_interval_fullsim_mean, firefree_interval_fullsim_stdev = get_firefree_interval_stats(dynamics, "average")
-        fires = dynamics.get_fires()
-        fires = "|".join([str(fire) for fire in fires])
-        result = {
-            "time": str(dynamics.time),
-            "tree_cover": str(dynamics.state.grid.get_tree_cover()), 
-            "slope": str(tree_cover_slope),
-            "population_size": str(dynamics.state.population.size()),
-            "#seeds_produced": str(dynamics.seeds_produced),
-            "fires": fires,
-            "trees[dbh_0-20%]": tree_sizes[0],
-            "trees[dbh_20-40%]": tree_sizes[1],
-            "trees[dbh_40-60%]": tree_sizes[2],
-            "trees[dbh_60-80%]": tree_sizes[3],
-            "trees[dbh_80-100%]": tree_sizes[4],
-            "top_kills": str(dynamics.get_no_fire_induced_topkills()),
-            "deaths": str(dynamics.get_no_fire_induced_deaths()),
-            "extra_parameters": extra_parameters,
-            "firefree_interval_mean": firefree_interval_mean,
-            "firefree_interval_stdev": firefree_interval_stdev,
-            "firefree_interval_full_sim_mean": firefree_interval_fullsim_mean,
-            "firefree_interval_full_sim_stdev": firefree_interval_fullsim_stdev,
-            "recruits": str(dynamics.get_no_recruits("all")),
-            "initial_no_dispersals": str(dynamics.get_initial_no_dispersals()),
-            "time_spent_moving": str(dynamics.get_fraction_time_spent_moving()),
-            "shaded_out": str(dynamics.get_fraction_seedlings_dead_due_to_shade()),
-            "nonseedling_top_kills": str(dynamics.get_no_fire_induced_nonseedling_topkills()),
-            "outcompeted_by_seedlings": str(dynamics.get_fraction_seedlings_outcompeted()),
-            "outcompeted_by_oldstems": str(dynamics.get_fraction_seedlings_outcompeted_by_older_trees()),
-            "germination_attempts": str(dynamics.get_no_germination_attempts()),
-            "oldstem_competition_and_shading": str(dynamics.get_fraction_cases_oldstem_competition_and_shading()),
-            "seedling_competition_and_shading": str(dynamics.get_fraction_cases_seedling_competition_and_shading())
-        }
-        if not args.rotate_randomly:
-            result["global_rotation_offset"] = str(args.global_rotation_offset)
-        if control_variable:
-            result[control_variable] = control_value
-        if secondary_variable:
-            result[secondary_variable] = secondary_value
-        if dependent_var:
-            result[dependent_var] = dependent_val
-        if initial_no_dispersals:
-            result["initial_number_of_dispersals"] = initial_no_dispersals
-        if dependent_result_range_stdev:
-            result["dependent_result_range_stdev"] = dependent_result_range_stdev
         writer.writerow(result)
-        
+
+
+def export_state(
+        dynamics, path="", init_csv=True, control_variable=None, control_value=None, tree_cover_slope=0,
+        extra_parameters="", secondary_variable=None, secondary_value=None, dependent_var=None, dependent_val=None, initial_no_dispersals=None, dependent_result_range_stdev=None,
+        args=None
+    ):
+    path, fieldnames, result = get_state_row(
+        dynamics, path, init_csv, control_variable, control_value, tree_cover_slope, extra_parameters, secondary_variable, secondary_value,
+        dependent_var, dependent_val, initial_no_dispersals, dependent_result_range_stdev, args
+    )
+    write_state_row(path, fieldnames, result, init_csv)
     return path
 
 
@@ -160,13 +177,16 @@ def save_tree_dbh_values(tree_dbh_values):
         json.dump(tree_dbh_values, dbh_json_file)
 
 def update_state_report(dynamics):
+    write_state_report(dynamics.time, dynamics.state.get_state_table())
+
+def write_state_report(_time, current_state):
+    # <current_state> is a state table (see State.get_state_table) of timestep <_time>.
     state_report_file = f"{cfg.DATA_OUT_DIR}/state_reports/state_report.npy"
-    current_state = dynamics.state.get_state_table()
     germ_index = 3 
     death_index = germ_index + 1
-    tree_dbh_values = load_tree_dbh_values(dynamics.time)
+    tree_dbh_values = load_tree_dbh_values(_time)
 
-    if os.path.exists(state_report_file) and dynamics.time == 1:
+    if os.path.exists(state_report_file) and _time == 1:
         os.remove(state_report_file)
     elif os.path.exists(state_report_file):
         state_report = np.load(state_report_file)
@@ -177,22 +197,22 @@ def update_state_report(dynamics):
             if _id not in state_report[:, 0]:
                 # Use tree format: id, x, y, time of germination, time of death
                 new_tree = list(current_state[i])[:3] # Get the tree id, x and y coordinates
-                new_tree = np.concatenate((new_tree, np.array([dynamics.time, 99999])), axis=0) # Add time of germination and placeholder for time of death
+                new_tree = np.concatenate((new_tree, np.array([_time, 99999])), axis=0) # Add time of germination and placeholder for time of death
                 state_report = np.vstack([state_report, new_tree])
             
         # Update dbh file
         for i in range(current_state.shape[0]):
             _id = int(current_state[i, 0])
             cur_dbh = float(current_state[i][3])
-            tree_dbh_values[dynamics.time][_id] = cur_dbh
+            tree_dbh_values[_time][_id] = cur_dbh
         
         # Update the state report with tree deaths
         for i in range(state_report.shape[0]):
             _id = int(state_report[i, 0])
             if (_id not in current_state[:, 0]) and (int(state_report[i][death_index]) == 99999):
-                state_report[i][death_index] = dynamics.time - 1
+                state_report[i][death_index] = _time - 1
     
-    if dynamics.time == 1:
+    if _time == 1:
         state_report = np.zeros((current_state.shape[0], 5))
         state_report[:,:3] = current_state[:,:3]
         state_report[:,-1] = 99999
@@ -203,3 +223,38 @@ def update_state_report(dynamics):
 
 
 
+
+
+class AsyncExporter:
+    # Runs export functions in submission order on a background thread, so that file I/O overlaps with the next timestep (the
+    # native simulation loop releases the GIL). Arguments must be snapshots (e.g. copied arrays or rows from get_state_row),
+    # not views of the simulation state. submit() blocks while <max_pending> exports are queued. Errors raised by an export
+    # are re-raised by the next submit() or by close().
+    def __init__(self, max_pending=4):
+        self.queue = queue.Queue(maxsize=max_pending)
+        self.error = None
+        self.thread = threading.Thread(target=self._run, daemon=True)
+        self.thread.start()
+
+    def _run(self):
+        while True:
+            job = self.queue.get()
+            if job is None:
+                return
+            if self.error is None:
+                try:
+                    job[0](*job[1])
+                except Exception as error:
+                    self.error = error
+
+    def submit(self, function, *args):
+        if self.error is not None:
+            raise self.error
+        self.queue.put((function, args))
+
+    def close(self):
+        # Wait for all queued exports to finish.
+        self.queue.put(None)
+        self.thread.join()
+        if self.error is not None:
+            raise self.error
@@ -128,7 +128,7 @@ def get_image(img, color_dict, width, height="width"):
     return img
 
 def get_image_from_grid(grid, collect_states, color_dict, invert=False):
-    img = grid.get_distribution(collect_states)
+    img = grid.get_distribution(collect_states, copy=(color_dict is False)) # get_image modifies the array in place only without a color dict
     img = get_image(img, color_dict, grid.width)
     if invert:
         img = ~img
@@ -12,19 +12,26 @@ using namespace help;
 class Strategy {
 public:
 	Strategy() = default;
-	Strategy(string _vector, float _seed_mass, float _diaspore_mass, int _no_seeds_per_diaspore, float _seed_tspeed,
+	Strategy(DispersalVector _vector, float _seed_mass, float _diaspore_mass, int _no_seeds_per_diaspore, float _seed_tspeed,
 		float _pulp_to_seed_ratio, float _recruitment_probability, float _seedling_dbh, float _relative_growth_rate, float _seed_reserve_mass
 	) :
 		vector(_vector), seed_mass(_seed_mass), diaspore_mass(_diaspore_mass), no_seeds_per_diaspore(_no_seeds_per_diaspore),
 		seed_tspeed(_seed_tspeed), pulp_to_seed_ratio(_pulp_to_seed_ratio), recruitment_probability(_recruitment_probability),
 		seedling_dbh(_seedling_dbh), relative_growth_rate(_relative_growth_rate), seed_reserve_mass(_seed_reserve_mass)
 	{}
+	bool operator==(const Strategy& strategy) const
+	{
+		return vector == strategy.vector && seed_mass == strategy.seed_mass && diaspore_mass == strategy.diaspore_mass &&
+			no_seeds_per_diaspore == strategy.no_seeds_per_diaspore && seed_tspeed == strategy.seed_tspeed &&
+			pulp_to_seed_ratio == strategy.pulp_to_seed_ratio && recruitment_probability == strategy.recruitment_probability &&
+			relative_growth_rate == strategy.relative_growth_rate && seed_reserve_mass == strategy.seed_reserve_mass &&
+			seedling_dbh == strategy.seedling_dbh;
+	}
 	void print() {
-		printf("id: %d, seed_mass: %f, diaspore_mass: %f, no_seeds_per_diaspore: %d, vector: %s, pulp to seed ratio: %f, seed terminal speed: %f, germination prob: %f\n",
-			id, seed_mass, diaspore_mass, no_seeds_per_diaspore, vector.c_str(), pulp_to_seed_ratio, seed_tspeed, recruitment_probability
+		printf("seed_mass: %f, diaspore_mass: %f, no_seeds_per_diaspore: %d, vector: %s, pulp to seed ratio: %f, seed terminal speed: %f, germination prob: %f\n",
+			seed_mass, diaspore_mass, no_seeds_per_diaspore, get_vector_name(vector).c_str(), pulp_to_seed_ratio, seed_tspeed, recruitment_probability
 		);
 	}
-	int id = -1;
 	float seed_mass = 0;
 	float diaspore_mass = 0;
 	int no_seeds_per_diaspore = 0;
@@ -34,7 +41,73 @@ public:
 	float relative_growth_rate = 0;
 	float seed_reserve_mass = 0;
 	float seedling_dbh = 0;
-	string vector = "none";
+	DispersalVector vector = DispersalVector::linear;
+};
+
+
+struct StrategyHash {
+	size_t operator()(const Strategy& strategy) const {
+		size_t seed = 0;
+		auto combine = [&seed](size_t value) { seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2); };
+		combine(std::hash<int>()((int)strategy.vector));
+		combine(std::hash<float>()(strategy.seed_mass));
+		combine(std::hash<float>()(strategy.diaspore_mass));
+		combine(std::hash<int>()(strategy.no_seeds_per_diaspore));
+		combine(std::hash<float>()(strategy.seed_tspeed));
+		combine(std::hash<float>()(strategy.pulp_to_seed_ratio));
+		combine(std::hash<float>()(strategy.seedling_dbh));
+		return seed;
+	}
+};
+
+
+class StrategyPool {
+	// Interned storage of strategies. Identical strategies share a single entry, which is referred to by an integer handle.
+	// Entries are reference counted by the crops that use them, and their slots are reused once no crop refers to them anymore.
+	// NOTE: Pointers returned by get() remain valid only until the next call to intern().
+public:
+	StrategyPool() = default;
+	int intern(Strategy& strategy) {
+		auto it = index.find(strategy);
+		if (it != index.end()) return it->second;
+		int handle;
+		if (free_handles.empty()) {
+			handle = strategies.size();
+			strategies.push_back(strategy);
+			refcounts.push_back(0);
+		}
+		else {
+			handle = free_handles.back();
+			free_handles.pop_back();
+			strategies[handle] = strategy;
+		}
+		index[strategy] = handle;
+		return handle;
+	}
+	Strategy* get(int handle) {
+		return &strategies[handle];
+	}
+	void acquire(int handle) {
+		refcounts[handle]++;
+	}
+	void release(int handle) {
+		if (handle < 0) return;
+		refcounts[handle]--;
+		if (refcounts[handle] == 0) {
+			index.erase(strategies[handle]);
+			free_handles.push_back(handle);
+		}
+	}
+	int size() {
+		return strategies.size() - free_handles.size();
+	}
+	size_t get_memory_size() const {
+		return help::get_memory_size(strategies) + help::get_memory_size(refcounts) + help::get_memory_size(free_handles) + help::get_memory_size(index);
+	}
+	vector<Strategy> strategies;
+	vector<int> refcounts;
+	vector<int> free_handles;
+	unordered_map<Strategy, int, StrategyHash> index;
 };
 
 
@@ -63,25 +136,25 @@ public:
 			trait_distributions[trait] = prob_model;
 		}
 	}
-	string pick_vector() {
+	DispersalVector pick_vector() {
 		int vector = trait_distributions["vector"].sample();
-		if (vector == 0) return "linear";
-		else if (vector == 1) return "wind";
-		else return "animal";
+		if (vector == 0) return DispersalVector::linear;
+		else if (vector == 1) return DispersalVector::wind;
+		else return DispersalVector::animal;
 	}
 	float compute_wing_mass(float cumulative_seed_mass) {
 		// Estimate wing mass based on correlation we found in seed- and wing measurement data taken from (Greene and Johnson, 1993)
 		return max(0, (cumulative_seed_mass - 0.03387f) / 3.6609f);
 	}
-	float compute_diaspore_mass(float no_seeds_per_diaspore, float seed_mass, string vector, float fruit_pulp_mass, float &pulp_to_seed_ratio) {
+	float compute_diaspore_mass(float no_seeds_per_diaspore, float seed_mass, DispersalVector vector, float fruit_pulp_mass, float &pulp_to_seed_ratio) {
 		float cumulative_seed_mass = seed_mass * no_seeds_per_diaspore;
 		float diaspore_mass;
-		if (vector == "wind") {
+		if (vector == DispersalVector::wind) {
 			float wing_mass = compute_wing_mass(cumulative_seed_mass);
 			diaspore_mass = cumulative_seed_mass + wing_mass;
 			//printf("cumulative seed mass: %f, wing mass: %f \n", cumulative_seed_mass, wing_mass);
 		}
-		else if (vector == "animal") {
+		else if (vector == DispersalVector::animal) {
 			diaspore_mass = cumulative_seed_mass + fruit_pulp_mass;
 		}
 		else {
@@ -99,12 +172,12 @@ public:
 		if (no_seeds_per_diaspore < 1) no_seeds_per_diaspore = 1; // Ensure at least one seed per diaspore
 		return no_seeds_per_diaspore;
 	}
-	float sample_seed_mass(string vector) {
+	float sample_seed_mass(DispersalVector vector) {
 		float seed_mass = 1.0f;
-		if (vector == "wind") {
+		if (vector == DispersalVector::wind) {
 			seed_mass = trait_distributions["seed_mass_wind"].sample();
 		}
-		if (vector == "animal") seed_mass = trait_distributions["seed_mass_animal"].sample();
+		if (vector == DispersalVector::animal) seed_mass = trait_distributions["seed_mass_animal"].sample();
 		return seed_mass;
 	}
 	float sample_fruit_pulp_mass() {
@@ -124,9 +197,10 @@ public:
 																						// table 2.2 (regression slope 'overall'). We multiply by 0.001 to convert mg/g/day to g/g/day.
 		return relative_growth_rate;
 	}
-	float calculate_seedling_dbh(float seed_reserve_mass, float relative_growth_rate, float seed_mass, string vector) {
-		if (trait_distributions["seedling_dbh_" + vector].sample() >= 0) {
-			return trait_distributions["seedling_dbh_" + vector].sample(); // If a constant value is provided in the parameter file, use that value.
+	float calculate_seedling_dbh(float seed_reserve_mass, float relative_growth_rate, float seed_mass, DispersalVector vector) {
+		string trait = "seedling_dbh_" + get_vector_name(vector);
+		if (trait_distributions[trait].sample() >= 0) {
+			return trait_distributions[trait].sample(); // If a constant value is provided in the parameter file, use that value.
 		}
 
 		float new_mass_grams = pow(10.0f, seed_reserve_mass * exp(relative_growth_rate * 365.25f));				// Mass in grams after 1 year of growth, based on Rose (2003). 
@@ -156,7 +230,7 @@ public:
 
 	void generate(Strategy &strategy) {
 		int no_seeds_per_diaspore = sample_no_seeds_per_diaspore();
-		string vector = pick_vector();
+		DispersalVector vector = pick_vector();
 		float seed_mass = sample_seed_mass(vector);
 		float fruit_pulp_mass = sample_fruit_pulp_mass();
 		float pulp_to_seed_ratio;
@@ -171,7 +245,8 @@ public:
 			seedling_dbh, relative_growth_rate, seed_reserve_mass
 		);
 	}
-	void mutate(Strategy& strategy, float mutation_rate) {
+	bool mutate(Strategy& strategy, float mutation_rate) {
+		// Returns whether the strategy was modified.
 		bool do_mutation = help::get_rand_float(0, 1) < mutation_rate;
 		if (do_mutation) {
 			int trait_idx = help::get_rand_int(0, 3);
@@ -193,6 +268,7 @@ public:
 			strategy.seed_tspeed = calculate_tspeed(strategy.diaspore_mass);
 			strategy.pulp_to_seed_ratio = pulp_to_seed_ratio;
 		}
+		return do_mutation;
 	}
 	map<string, ProbModel> trait_distributions;
 	map<int, string> distribution_types = { { 0, "uniform" }, {1, "linear"}, {2, "normal"}, {3, "discrete"}, {4, "constant"} };
@@ -355,36 +431,36 @@ public:
 class Crop {
 public:
 	Crop() = default;
-	Crop(Strategy &_strategy, Tree& tree) {
+	Crop(int _strategy, Strategy& _strategy_traits, Tree& tree) {
 		strategy = _strategy;
-		seed_mass = _strategy.seed_mass;
+		seed_mass = _strategy_traits.seed_mass;
 		origin = tree.position;
 		id = tree.id;
 	}
-	void compute_no_seeds(Tree &tree, float STR) {
+	void compute_no_seeds(Tree &tree, float STR, Strategy& traits) {
 		float dbh_dependent_factor = (tree.dbh / 30.0f);
 		total_no_seeds_produced = STR * (dbh_dependent_factor * dbh_dependent_factor); // Number of seeds produced by the tree, based on Ribbens et al (1994).
-		no_seeds = (float)total_no_seeds_produced * strategy.recruitment_probability;
+		no_seeds = (float)total_no_seeds_produced * traits.recruitment_probability;
 	}
-	void compute_no_diaspora() {
-		no_diaspora = no_seeds / strategy.no_seeds_per_diaspore;
-		no_seeds = no_diaspora * strategy.no_seeds_per_diaspore; // Ensure that the number of seeds is an exact multiple of the number of seeds per diaspore.
+	void compute_no_diaspora(Strategy& traits) {
+		no_diaspora = no_seeds / traits.no_seeds_per_diaspore;
+		no_seeds = no_diaspora * traits.no_seeds_per_diaspore; // Ensure that the number of seeds is an exact multiple of the number of seeds per diaspore.
 	}
-	void compute_fruit_abundance() {
+	void compute_fruit_abundance(Strategy& traits) {
 		// Compute the number of fruits that will be produced by the tree, rather than the number of fruits that are actually dispersed.
-		fruit_abundance = total_no_seeds_produced / strategy.no_seeds_per_diaspore;
+		fruit_abundance = total_no_seeds_produced / traits.no_seeds_per_diaspore;
 	}
-	void update(Tree& tree, float STR) {
-		compute_no_seeds(tree, STR);
-		compute_no_diaspora();
-		compute_fruit_abundance();
+	void update(Tree& tree, float STR, Strategy& traits) {
+		compute_no_seeds(tree, STR, traits);
+		compute_no_diaspora(traits);
+		compute_fruit_abundance(traits);
 	}
 	int no_seeds = 0; // Number of seeds dispersed.
 	int no_diaspora = 0; // Number of diaspora dispersed.
 	int fruit_abundance = 0;
 	int total_no_seeds_produced = 0; // Number of seeds produced (always equal- or higher than no_seeds).
 	float seed_mass = 0;
-	Strategy strategy;
+	int strategy = -1; // Handle of the crop's strategy in the population's strategy pool.
 	pair<float, float> origin = pair<float, float>(0, 0);
 	int id = -1;
 };
@@ -409,16 +485,16 @@ public:
 			{1, 1.3f}, {2, 1.8f}, {3, 2.1f}, {4, 2.5f}, // From Hoffmann et al (2012), estimated from supplementary figure S1.
 		};
 	}
-	Tree* add(pair<float, float> position, Strategy* _strategy = 0, float dbh = -2) {
+	Tree* add(pair<float, float> position, int parent_strategy = -1, float dbh = -2) {
 		// Create tree
 		if (dbh == -1) dbh = max_dbh;
 		else if (dbh == -2) {
-			if (_strategy == nullptr) {
+			if (parent_strategy == -1) {
 				while (dbh <= 0)
 					dbh = dbh_probability_model.linear_sample();
 			}
 			else {
-				dbh = _strategy->seedling_dbh; // Growth rate determines initial dbh.
+				dbh = strategies.get(parent_strategy)->seedling_dbh; // Growth rate determines initial dbh.
 			}
 		}
 		float growth_multiplier = help::get_rand_float(growth_multiplier_distribution.min_value, growth_multiplier_distribution.max_value);
@@ -426,28 +502,32 @@ public:
 		members[tree.id] = tree;
 		no_created_trees++;
 
-		// Create strategy
-		Strategy strategy;
-		if (_strategy != nullptr) {
-			strategy = *_strategy;
-			strategy_generator.mutate(strategy, mutation_rate);
+		// Create strategy. Offspring share the parent's pooled strategy unless it mutates (copy-on-mutate).
+		int strategy_handle = parent_strategy;
+		if (parent_strategy != -1) {
+			Strategy mutant = *strategies.get(parent_strategy);
+			if (strategy_generator.mutate(mutant, mutation_rate)) strategy_handle = strategies.intern(mutant);
 		}
 		else {
+			Strategy strategy;
 			strategy_generator.generate(strategy);
-		} 
-		strategy.id = tree.id;
+			strategy_handle = strategies.intern(strategy);
+		}
+		strategies.acquire(strategy_handle);
+		Strategy& strategy = *strategies.get(strategy_handle);
 		recruitment_rates.push_back(strategy.recruitment_probability);
 
 		// Create crop
-		Crop crop(strategy, tree);
+		Crop crop(strategy_handle, strategy, tree);
 		crops[tree.id] = crop;
 
 		// Create custom kernel
 		Kernel kernel = *get_kernel(strategy.vector);
-		if (strategy.vector == "wind") {
+		if (strategy.vector == DispersalVector::wind && kernel.type == DispersalVector::wind) {
+			WindKernel& global_kernel = kernel.wind();
 			kernel = Kernel(
-				tree.id, kernel.dist_max, kernel.wspeed_gmean, kernel.wspeed_stdev, kernel.wind_direction,
-				kernel.wind_direction_stdev, strategy.seed_tspeed
+				tree.id, global_kernel.dist_max, global_kernel.wspeed_gmean, global_kernel.wspeed_stdev, global_kernel.wind_direction,
+				global_kernel.wind_direction_stdev, strategy.seed_tspeed
 			);
 		}
 		kernels_individual[tree.id] = kernel;
@@ -457,7 +537,7 @@ public:
 	void add_reproduction_system(Tree &tree) {
 
 	}
-	Kernel* add_kernel(string tree_dispersal_vector, Kernel &kernel) {
+	Kernel* add_kernel(DispersalVector tree_dispersal_vector, Kernel &kernel) {
 		kernels[tree_dispersal_vector] = kernel;
 		return &kernel;
 	}
@@ -468,21 +548,46 @@ public:
 		for (int id : ids) trees.push_back(get(id));
 	}
 	Crop* get_crop(int id) {
-		return &crops[id];
+		return &crops.at(id); // Read-only lookup, as this is also called from the dispersal worker threads.
 	}
-	Kernel* get_kernel(string vector) {
+	Kernel* get_kernel(DispersalVector vector) {
 		return &kernels[vector];
 	}
 	Kernel* get_kernel(int id) {
 		return &kernels_individual[id];
 	}
+	Strategy* get_strategy(Crop* crop) {
+		return strategies.get(crop->strategy);
+	}
 	int size() {
 		return members.size();
 	}
+	size_t get_tree_memory_size() const {
+		size_t bytes = help::get_memory_size(members);
+		for (auto& [id, tree] : members) bytes += help::get_memory_size(tree.resprout_growthcurve);
+		return bytes;
+	}
+	size_t get_crop_memory_size() const {
+		return help::get_memory_size(crops);
+	}
+	size_t get_kernel_memory_size() const {
+		// Wind kernel cdfs are shared between copies of a kernel until it is rebuilt, so each cdf is counted once.
+		size_t bytes = help::get_memory_size(kernels) + help::get_memory_size(kernels_individual);
+		set<const double*> cdfs;
+		auto add_cdf = [&](const Kernel& kernel) {
+			const WindKernel* wind = std::get_if<WindKernel>(&kernel.payload);
+			if (wind != nullptr && wind->cdf != nullptr && cdfs.insert(wind->cdf.get()).second) bytes += (size_t)wind->resolution * sizeof(double);
+		};
+		for (auto& [vector, kernel] : kernels) add_cdf(kernel);
+		for (auto& [id, kernel] : kernels_individual) add_cdf(kernel);
+		return bytes;
+	}
 	bool remove(Tree* tree) {
 		return remove(tree->id);
 	}
 	bool remove(int id) {
+		auto crop = crops.find(id);
+		if (crop != crops.end()) strategies.release(crop->second.strategy);
 		bool removed = members.erase(id);
 		removed = removed && crops.erase(id);
 		removed = removed && delete_kernel(id);
@@ -519,10 +624,11 @@ public:
 	
 	unordered_map<int, Tree> members;
 	unordered_map<int, Crop> crops;
-	unordered_map<string, Kernel> kernels;
+	unordered_map<DispersalVector, Kernel> kernels;
 	unordered_map<int, Kernel> kernels_individual;
 	help::LinearProbabilityModel dbh_probability_model;
 	StrategyGenerator strategy_generator;
+	StrategyPool strategies;
 	float max_dbh = 0;
 	float cellsize = 0;
 	float seed_mass = 0;
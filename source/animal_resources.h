@@ -1,7 +1,18 @@
 #pragma once
 #include "diaspora.h"
+#include "mapped_file.h"
 
 
+class LookupTableHeader {
+public:
+	// Header of a cached distance lookup table file. The table (width^4 floats) follows directly after it.
+	char magic[8] = { 'D', 'B', 'R', 'L', 'U', 'T', '0', '2' };
+	uint64_t key = 0;
+	int width = 0;
+	int ready = 0;		// Set once the table has been written (used for tables in shared memory).
+	int creator = 0;	// Process id of the process that fills a table in shared memory.
+};
+
 
 class ResourceCell {
 public:
@@ -36,6 +47,19 @@ public:
 };
 
 
+class CellSelection {
+public:
+	// Scratch buffers for selecting a destination cell, so that animals on different threads do not share them.
+	CellSelection() = default;
+	CellSelection(int size) {
+		d = make_shared<float[]>(size);
+		selection_probabilities = DiscreteProbabilityModel(size);
+	}
+	shared_ptr<float[]> d = 0;
+	DiscreteProbabilityModel selection_probabilities;
+};
+
+
 class ResourceGrid : public Grid {
 public:
 	ResourceGrid() = default;
@@ -49,6 +73,7 @@ public:
 		size = width * width;
 		lookup_table_size = size * size;
 		cells = make_shared<ResourceCell[]>(size);
+		cell_locks = shared_ptr<mutex[]>(new mutex[size]);
 		selection_probabilities = DiscreteProbabilityModel(size);
 		species = _species;
 		animal_kernel_params = _animal_kernel_params;
@@ -56,6 +81,27 @@ public:
 		init_cells();
 		init_neighbor_offsets();
 	}
+	ResourceGrid(const ResourceGrid&) = default;
+	ResourceGrid copy(State* _state) const {
+		// Independent copy for a simulation that references <_state> (see Dynamics::fork()). Copying by value shares the arrays.
+		// The distance lookup tables are read-only and remain shared.
+		ResourceGrid resource_grid(*this);
+		static_cast<Grid&>(resource_grid) = Grid::copy();
+		resource_grid.state = _state;
+		resource_grid.grid = &_state->grid;
+		resource_grid.cells = help::copy_array(cells, size);
+		resource_grid.cell_locks = shared_ptr<mutex[]>(new mutex[size]);
+		for (auto& [species, _c] : resource_grid.c) _c = help::copy_array(_c, size);
+		for (auto& [species, _f] : resource_grid.f) _f = help::copy_array(_f, size);
+		resource_grid.dist_aggregate = help::copy_array(dist_aggregate, size);
+		resource_grid.cover = help::copy_array(cover, size);
+		resource_grid.fruit_abundance = help::copy_array(fruit_abundance, size);
+		resource_grid.d = help::copy_array(d, size);
+		resource_grid.visits = help::copy_array(visits, size);
+		resource_grid.color_distribution = help::copy_array(color_distribution, size);
+		resource_grid.selection_probabilities = selection_probabilities.copy();
+		return resource_grid;
+	}
 	void init_property_distributions(vector<string> &species) {
 		d = make_shared<float[]>(size);
 		cover = make_shared<float[]>(size);
@@ -68,7 +114,6 @@ public:
 		for (int i = 0; i < species.size(); i++) {
 			c[species[i]] = make_shared<float[]>(size);
 			f[species[i]] = make_shared<float[]>(size);
-			dist_lookup_table[species[i]] = make_shared<float[]>(lookup_table_size);
 		}
 	}
 	void reset() {
@@ -76,43 +121,62 @@ public:
 			cells[i].reset();
 		}
 		has_fruits = false;
+		resources_up_to_date = false;
 		total_no_fruits = 0;
 	}
 	void add_tree(Tree* tree) {
 		ResourceCell* cell = get_resource_cell_at_position(tree->position);
 		cell->add_tree(tree->id);
 	}
-	float get_tree_cover_within_resourcegrid_bb(ResourceCell* rcell, pair<int, int> bb_min, pair<int, int> bb_max, vector<int>& trees) {
-		int no_forest_cells = 0;
-		int no_cells = 0;
-		for (int x = bb_min.first; x < bb_max.first; x++) {
-			for (int y = bb_min.second; y < bb_max.second; y++) {
-				Cell* cell = grid->get_cell_at_position(pair<int, int>(x, y));
-				for (int tree_id : cell->trees) {
-					if (!help::is_in(&trees, tree_id)) {
-						trees.push_back(tree_id);
-					}
-					if (state->population.get(tree_id)->life_phase == 2) {
-						rcell->fruits.add_fruits(
-							state->population.get_crop(tree_id),
-							state->population.get(tree_id)->crown_area * cell_area_inv
-						);
-					}
-					//printf("Tree %i, fruit abundance: %i \n", tree_id, rcell->fruits[tree_id]);
+	int get_resource_cell_idx_of_gridcell(pair<int, int> gb_position) {
+		int x = min(gb_position.first / no_gridcells_per_resource_cell, width - 1);
+		int y = min(gb_position.second / no_gridcells_per_resource_cell, width - 1);
+		return y * width + x;
+	}
+	void assign_trees_and_fruits() {
+		// Assign each tree to the resource cells of the grid cells it occupies, and add the crops of mature trees to their fruit
+		// stocks. As in Grid::populate_tree_domain, these are the cells its crown spans (only for crowns of at least half a cell)
+		// and the capped cell at its center, which holds its stem.
+		vector<int> overlapped_cells;
+		for (auto& [tree_id, tree] : state->population.members) {
+			overlapped_cells.clear();
+			TreeDomainIterator it(grid->cell_width, &tree);
+			if (tree.crown_area >= grid->cell_area_half) {
+				while (it.next()) {
+					if (!tree.radius_spans(it.real_cell_position)) continue;
+					pair<int, int> gb_position = it.gb_cell_position;
+					grid->cap(gb_position);
+					int idx = get_resource_cell_idx_of_gridcell(gb_position);
+					if (!help::is_in(&overlapped_cells, idx)) overlapped_cells.push_back(idx);
+				}
+			}
+			int center_idx = get_resource_cell_idx_of_gridcell(grid->idx_2_pos(grid->get_capped_center_idx(it.tree_center_gb)));
+			if (!help::is_in(&overlapped_cells, center_idx)) overlapped_cells.push_back(center_idx);
+			for (int idx : overlapped_cells) {
+				cells[idx].add_tree(tree_id);
+				if (tree.life_phase == 2) {
+					cells[idx].fruits.add_fruits(state->population.get_crop(tree_id), tree.crown_area * cell_area_inv);
 				}
-				no_forest_cells += cell->state;
-				no_cells++;
 			}
 		}
-		return (float)no_forest_cells / (float)no_cells;
 	}
 	void compute_cover() {
+		// Tree and fruit assignment and cover are computed once per timestep, and shared by all species. Cover is the fraction of
+		// forest grid cells; resource cells at the far edges may hold more grid cells than the others, if the grid width is not a
+		// multiple of the resource grid width.
+		if (resources_up_to_date) return;
+		assign_trees_and_fruits();
+		vector<int> no_gridcells(size, 0);
+		for (int i = 0; i < size; i++) cover[i] = 0.0f;
+		for (int i = 0; i < grid->no_cells; i++) {
+			int idx = get_resource_cell_idx_of_gridcell(grid->idx_2_pos(i));
+			cover[idx] += grid->distribution[i].state;
+			no_gridcells[idx]++;
+		}
 		for (int i = 0; i < size; i++) {
-			ResourceCell* cell = &cells[i];
-			if (cell->trees.size() == 0) cover[i] = 0.0f;
-			cover[i] = get_tree_cover_within_resourcegrid_bb(cell, cell->grid_bb_min, cell->grid_bb_max, cell->trees);
-			cover[i] = asin(sqrt(cover[i]));
+			cover[i] = (no_gridcells[i] > 0) ? asin(sqrt(cover[i] / (float)no_gridcells[i])) : 0.0f;
 		}
+		resources_up_to_date = true;
 	}
 	void compute_fruit_abundance() {
 		for (int i = 0; i < size; i++) {
@@ -137,9 +201,14 @@ public:
 		location = state->grid.cell_width * location; // Convert to real position, at the origin of a stategrid-cell.
 	}
 	bool extract_fruit(pair<float, float> pos, Fruit &fruit, int tree_id) {
+		// Fruit stocks are locked per cell, so that animals dispersing in parallel can extract fruits concurrently.
 		ResourceCell* cell = get_resource_cell_at_position(pos);
-		bool success = cell->extract_random_fruit(fruit, tree_id);
-		total_no_fruits -= success;
+		bool success;
+		{
+			lock_guard<mutex> lock(cell_locks[cell->idx]);
+			success = cell->extract_random_fruit(fruit, tree_id);
+		}
+		atomic_ref<int>(total_no_fruits).fetch_sub(success);
 		return success;
 	}
 	pair<int, int> _idx_2_pos(int idx) {
@@ -277,48 +346,190 @@ public:
 		if (verbosity > 0) printf("collected %s for species %s \n", collect.c_str(), species.c_str());
 		return color_distribution;
 	}
-	shared_ptr<float[]> get_lookup_table(string species) {
-		return dist_lookup_table[species];
+	const float* get_lookup_table(string species) {
+		return dist_lookup_table.at(species);
+	}
+	void reference_dist_lookup_table(string species, const float* table, shared_ptr<void> storage) {
+		// Tables are referenced rather than owned, so that they can reside in (read-only) mapped memory shared by several
+		// processes. <storage> keeps the underlying buffer or mapping alive for as long as the table is referenced.
+		dist_lookup_table[species] = table;
+		dist_lookup_table_storage[species] = storage;
 	}
 	ResourceCell* select_random_cell() {
 		int idx = help::get_rand_int(0, size - 1);
 		return &cells[idx];
 	}
 	void precompute_dist_lookup_table(string species) {
-		float a_d = animal_kernel_params[species]["a_d"];
+		// Rows of the table are distributed over threads. Each row is computed in two branch-free passes over contiguous
+		// arrays (periodic distances, then the distance kernel), which the compiler can vectorize.
+		Timer timer; timer.start();
+		float a_d_recipr = 1.0f / animal_kernel_params[species]["a_d"];
 		float b_d = animal_kernel_params[species]["b_d"];
-		float a_d_recipr = 1.0f / a_d;
+		shared_ptr<float[]> table = make_shared<float[]>(lookup_table_size);
+		vector<float> xs(size), ys(size);
 		for (int i = 0; i < size; i++) {
-			pair<float, float> curpos = get_rc_real_position(cells[i].pos);
-			for (int j = 0; j < size; j++) {
-				pair<float, float> target_pos = get_rc_real_position(cells[j].pos);
-				float dist = get_resourcegrid_dist(curpos, target_pos);
-				float val = tanh(pow((-dist * a_d_recipr), b_d));
-				dist_lookup_table[species][size * (cells[i].pos.first + cells[i].pos.second * width) + cells[j].pos.first + cells[j].pos.second * width] = val;
+			pair<float, float> position = get_rc_real_position(cells[i].pos);
+			xs[i] = position.first;
+			ys[i] = position.second;
+		}
+		atomic<int> next_row = 0;
+		auto compute_rows = [&]() {
+			for (int i = next_row++; i < size; i = next_row++) {
+				compute_dist_lookup_table_row(table.get() + (size_t)size * i, xs[i], ys[i], xs.data(), ys.data(), a_d_recipr, b_d);
 			}
-			if (i % width == 0) printf("Finished row %i / %i\n", i / width, width);
+		};
+		int no_threads = max(1, (int)thread::hardware_concurrency());
+		vector<thread> workers;
+		for (int t = 1; t < no_threads; t++) workers.push_back(thread(compute_rows));
+		compute_rows();
+		for (auto& worker : workers) worker.join();
+		reference_dist_lookup_table(species, table.get(), table);
+		timer.stop();
+		printf("Computed dist lookup table for species %s (%i threads, %f seconds) \n", species.c_str(), no_threads, timer.elapsedSeconds());
+	}
+	void compute_dist_lookup_table_row(float* row, float x, float y, const float* xs, const float* ys, float a_d_recipr, float b_d) {
+		// Distances are taken to the nearest periodic image of each cell (equivalent to get_resourcegrid_dist()).
+		for (int j = 0; j < size; j++) {
+			float dx = fabsf(xs[j] - x);
+			float dy = fabsf(ys[j] - y);
+			dx = min(dx, width_r - dx);
+			dy = min(dy, width_r - dy);
+			row[j] = sqrtf(dx * dx + dy * dy);
+		}
+		for (int j = 0; j < size; j++) {
+			row[j] = tanh(pow((-row[j] * a_d_recipr), b_d));
 		}
-		printf("Computed dist lookup table for species %s \n", species.c_str());
 	}
-	void set_dist_lookup_table(shared_ptr<float[]> lookup_table, string species) {
-		for (int i = 0; i < width * width * width * width; i++) {
-			dist_lookup_table[species][i] = lookup_table[i];
+	uint64_t get_lookup_table_key(string species) {
+		// FNV-1a hash of the parameters which determine the contents of the lookup table.
+		float params[3] = { animal_kernel_params[species]["a_d"], animal_kernel_params[species]["b_d"], cell_width };
+		uint64_t key = 14695981039346656037ull;
+		auto hash_bytes = [&key](const void* bytes, size_t no_bytes) {
+			for (size_t i = 0; i < no_bytes; i++) {
+				key ^= ((const unsigned char*)bytes)[i];
+				key *= 1099511628211ull;
+			}
+		};
+		hash_bytes(&width, sizeof(width));
+		hash_bytes(params, sizeof(params));
+		return key;
+	}
+	string get_lookup_table_cache_path(string species, string cache_dir) {
+		char filename[64];
+		snprintf(filename, sizeof(filename), "dist_lookup_table_%016llx.bin", (unsigned long long)get_lookup_table_key(species));
+		return (std::filesystem::path(cache_dir) / filename).string();
+	}
+	bool load_dist_lookup_table(string species, string cache_dir) {
+		// Map a cached table into memory. The table is used in place, without copying.
+		string path = get_lookup_table_cache_path(species, cache_dir);
+		shared_ptr<MappedFile> file = make_shared<MappedFile>();
+		if (!file->open(path)) return false;
+		LookupTableHeader header;
+		if (file->size() != sizeof(header) + sizeof(float) * (size_t)lookup_table_size) return false;
+		memcpy(&header, file->data(), sizeof(header));
+		if (memcmp(header.magic, LookupTableHeader().magic, sizeof(header.magic)) != 0 || header.key != get_lookup_table_key(species)
+			|| header.width != width) {
+			return false;
 		}
+		reference_dist_lookup_table(species, (const float*)(file->data() + sizeof(header)), file);
+		printf("Loaded dist lookup table for species %s from %s \n", species.c_str(), path.c_str());
+		return true;
+	}
+	bool save_dist_lookup_table(string species, string cache_dir) {
+		LookupTableHeader header;
+		header.key = get_lookup_table_key(species);
+		header.width = width;
+		std::error_code error;
+		std::filesystem::create_directories(cache_dir, error);
+		string path = get_lookup_table_cache_path(species, cache_dir);
+		bool success = MappedFile::write(
+			path, &header, sizeof(header), dist_lookup_table.at(species), sizeof(float) * (size_t)lookup_table_size
+		);
+		if (!success) printf("WARNING: Could not write dist lookup table cache file %s \n", path.c_str());
+		return success;
+	}
+	void init_dist_lookup_table(string species, string cache_dir, bool shared_memory = false) {
+		// Load the lookup table from the cache directory, or compute and cache it if no table exists for the current parameters.
+		// In shared memory mode, all processes on the machine reference a single copy of the table.
+		if (shared_memory && attach_shared_dist_lookup_table(species, cache_dir)) return;
+		if (load_dist_lookup_table(species, cache_dir)) return;
+		precompute_dist_lookup_table(species);
+		save_dist_lookup_table(species, cache_dir);
+	}
+	string get_shared_lookup_table_name(string species) {
+		char name[64];
+#ifdef _WIN32
+		snprintf(name, sizeof(name), "Local\\dbr_lut_%016llx", (unsigned long long)get_lookup_table_key(species));
+#else
+		snprintf(name, sizeof(name), "/dbr_lut_%016llx", (unsigned long long)get_lookup_table_key(species));
+#endif
+		return name;
+	}
+	bool attach_shared_dist_lookup_table(string species, string cache_dir, bool take_over = true) {
+		// Reference the table in a named shared memory segment. The first process to request the segment fills it, from
+		// the cache directory if possible; other processes wait until it is ready. If the filling process exits before the table
+		// is ready, the segment is removed and recreated by a waiting process (on Windows, where segments cannot be removed while
+		// mapped, the waiting processes fall back to private tables instead).
+		string name = get_shared_lookup_table_name(species);
+		shared_ptr<MappedFile> segment = make_shared<MappedFile>();
+		bool created = false;
+		if (!segment->open_shared_memory(name, sizeof(LookupTableHeader) + sizeof(float) * (size_t)lookup_table_size, created)) {
+			printf("WARNING: Could not open shared memory segment %s. Using a private lookup table instead. \n", name.c_str());
+			return false;
+		}
+		LookupTableHeader* header = (LookupTableHeader*)segment->data();
+		if (created) {
+			char* data = segment->mutable_data();
+			int creator = (int)MappedFile::get_process_id();
+			atomic_ref<int>(((LookupTableHeader*)data)->creator).store(creator, memory_order_release);
+			if (!load_dist_lookup_table(species, cache_dir)) {
+				precompute_dist_lookup_table(species);
+				save_dist_lookup_table(species, cache_dir);
+			}
+			memcpy(data + sizeof(LookupTableHeader), dist_lookup_table.at(species), sizeof(float) * (size_t)lookup_table_size);
+			LookupTableHeader filled_header;
+			filled_header.key = get_lookup_table_key(species);
+			filled_header.width = width;
+			filled_header.creator = creator;
+			memcpy(data, &filled_header, sizeof(LookupTableHeader));
+			atomic_ref<int>(((LookupTableHeader*)data)->ready).store(1, memory_order_release);
+		}
+		else {
+			for (int i = 0; atomic_ref<int>(header->ready).load(memory_order_acquire) != 1; i++) {
+				int creator = atomic_ref<int>(header->creator).load(memory_order_acquire);
+				bool creator_lost = (creator != 0) ? !MappedFile::is_process_alive(creator) : (i >= 600); // No creator after a minute.
+				if (creator_lost) {
+					printf("WARNING: The process filling shared lookup table %s exited before it was ready. \n", name.c_str());
+					segment->close();
+					if (!take_over) return false;
+					MappedFile::remove_shared_memory(name);
+					return attach_shared_dist_lookup_table(species, cache_dir, false);
+				}
+				if (i == 36000) { // Give up after an hour.
+					printf("WARNING: Timed out waiting for shared lookup table %s. \n", name.c_str());
+					return false;
+				}
+				this_thread::sleep_for(milliseconds(100));
+			}
+			if (header->key != get_lookup_table_key(species) || header->width != width) return false;
+		}
+		reference_dist_lookup_table(species, (const float*)(segment->data() + sizeof(LookupTableHeader)), segment);
+		printf("Attached to shared dist lookup table %s for species %s \n", name.c_str(), species.c_str());
+		return true;
 	}
-	void compute_d(pair<int, int>& curpos, string species) {
+	void remove_shared_dist_lookup_table(string species) {
+		// Remove the named segment, so that it is released once the processes referencing it exit.
+		MappedFile::remove_shared_memory(get_shared_lookup_table_name(species));
+	}
+	void set_dist_lookup_table(const float* lookup_table, string species) {
+		shared_ptr<float[]> table = make_shared<float[]>(lookup_table_size);
+		memcpy(table.get(), lookup_table, sizeof(float) * (size_t)lookup_table_size);
+		reference_dist_lookup_table(species, table.get(), table);
+	}
+	void compute_d(pair<int, int>& curpos, const string& species, float* _d) {
+		const float* lookup_table = dist_lookup_table.at(species) + size * (curpos.first + curpos.second * width);
 		for (int i = 0; i < size; i++) {
-			//pair<float, float> cell_pos = get_real_position(cells[i].pos);
-			//float dist = get_resourcegrid_dist(get_real_position(curpos), cell_pos);
-			//d[i] = tanh(pow((-dist * 0.5), 0.4));
-			//continue;
-			
-			pair<int, int> target_pos = cells[i].pos;
-		    int lookup_idx = size * (curpos.first + curpos.second * width) + target_pos.first + target_pos.second * width;
-			/*if (lookup_idx < 0 || lookup_idx > size * size) {
-				printf("cur pos: %i, %i, target pos: %i, %i \n", curpos.first, curpos.second, target_pos.first, target_pos.second);
-				printf("Idx: %i (limits: %i - %i) \n", lookup_idx, 0, size * size);
-			}*/
-			d[i] = dist_lookup_table[species][lookup_idx];
+			_d[i] = lookup_table[cells[i].pos.first + cells[i].pos.second * width];
 		}
 	}
 	void compute_c(string species, float a_c, float b_c) {
@@ -351,19 +562,50 @@ public:
 	ResourceCell* select_cell(string species, pair<float, float> cur_position, bool fruit_agnostic_selection = false) {
 		pair<int, int> gridbased_curpos = get_rc_gridbased_position(cur_position);
 		cap(gridbased_curpos);
-		compute_d(gridbased_curpos, species);
-		compute_k(species, fruit_agnostic_selection);
+		compute_d(gridbased_curpos, species, d.get());
+		compute_k(species, fruit_agnostic_selection, d.get(), selection_probabilities);
 		int idx = selection_probabilities.sample();
 		visits[idx] += 1;
 		visits_sum += 1;
 		return &cells[idx];
 	}
+	ResourceCell* select_cell(const string& species, pair<float, float> cur_position, bool fruit_agnostic_selection, CellSelection* selection) {
+		// Thread-safe variant of select_cell(), which uses the given scratch buffers instead of the shared ones.
+		pair<int, int> gridbased_curpos = get_rc_gridbased_position(cur_position);
+		cap(gridbased_curpos);
+		compute_d(gridbased_curpos, species, selection->d.get());
+		compute_k(species, fruit_agnostic_selection, selection->d.get(), selection->selection_probabilities);
+		int idx = selection->selection_probabilities.sample();
+		atomic_ref<int>(visits[idx]).fetch_add(1);
+		atomic_ref<float>(visits_sum).fetch_add(1.0f);
+		return &cells[idx];
+	}
+	size_t get_cell_memory_size() const {
+		// Resource cells (with their tree lists and fruit stocks) and the underlying grid.
+		if (cells == nullptr) return 0;
+		size_t bytes = Grid::get_cell_memory_size() + Grid::get_layer_memory_size() + (size_t)size * (sizeof(ResourceCell) + sizeof(mutex));
+		for (int i = 0; i < size; i++) bytes += help::get_memory_size(cells[i].trees) + cells[i].fruits.get_memory_size();
+		return bytes;
+	}
+	size_t get_table_memory_size() const {
+		// Per-cell properties (distance, cover, fruit abundance, visits, ...) and selection probabilities.
+		if (cells == nullptr) return 0;
+		size_t no_float_tables = 4 + c.size() + f.size(); // d, cover, fruit_abundance, dist_aggregate, and c and f per species.
+		size_t no_int_tables = 2; // visits, color_distribution
+		return (size_t)size * (no_float_tables * sizeof(float) + no_int_tables * sizeof(int) + 2 * sizeof(double));
+	}
+	size_t get_lookup_table_memory_size() const {
+		// Distance lookup tables. These may be shared with other simulations (see LookupTableCache) or mapped from a file.
+		return dist_lookup_table.size() * (size_t)lookup_table_size * sizeof(float);
+	}
 	State* state = 0;
 	Grid* grid = 0;
 	shared_ptr<ResourceCell[]> cells = 0;
+	shared_ptr<mutex[]> cell_locks = 0;
 	map<string, shared_ptr<float[]>> c;
 	map<string, shared_ptr<float[]>> f;
-	map<string, shared_ptr<float[]>> dist_lookup_table;
+	map<string, const float*> dist_lookup_table; // Read-only; see reference_dist_lookup_table().
+	map<string, shared_ptr<void>> dist_lookup_table_storage;
 	vector<string> species;
 	map<string, map<string, float>> animal_kernel_params;	
 	shared_ptr<float[]> dist_aggregate = 0;
@@ -377,34 +619,37 @@ public:
 	int total_no_fruits = 0;
 	int lookup_table_size = 0;
 	int size = 0;
+	int no_gridcells_per_resource_cell = 1; // Number of grid cells along each axis of a resource cell.
 	DiscreteProbabilityModel selection_probabilities;
 	shared_ptr<pair<float,float>[]> neighbor_offsets = 0;
 	bool has_fruits = false;
+	bool resources_up_to_date = false;
 
 private:
 	void init_cells() {
 		int no_gridcells_along_x_per_resource_cell = round((float)grid->width / (float)width);
+		no_gridcells_per_resource_cell = max(1, no_gridcells_along_x_per_resource_cell);
 		for (int i = 0; i < size; i++) {
 			cells[i] = ResourceCell(idx_2_pos(i), i);
 			cells[i].grid_bb_min = no_gridcells_along_x_per_resource_cell * cells[i].pos;
 			cells[i].grid_bb_max = cells[i].grid_bb_min + pair<int, int>(no_gridcells_along_x_per_resource_cell - 1, no_gridcells_along_x_per_resource_cell - 1);
 		}
 	}
-	void compute_k(string species, bool try_fruit_agnostic_selection = false) {
-		shared_ptr<float[]> _c = c[species];
-		shared_ptr<float[]> _f = f[species];
+	void compute_k(const string& species, bool try_fruit_agnostic_selection, float* _d, DiscreteProbabilityModel& probabilities) {
+		float* _c = c.at(species).get();
+		float* _f = f.at(species).get();
 		float sum = 0.0f;
 		for (int i = 0; i < size; i++) {
 			if (try_fruit_agnostic_selection) {
-				selection_probabilities.probabilities[i] = d[i] * _c[i];
+				probabilities.probabilities[i] = _d[i] * _c[i];
 			}
 			else {
-				selection_probabilities.probabilities[i] = d[i] * _c[i] * _f[i];
-				sum += selection_probabilities.probabilities[i];
+				probabilities.probabilities[i] = _d[i] * _c[i] * _f[i];
 			}
+			sum += probabilities.probabilities[i];
 		}
-		selection_probabilities.normalize(sum);
-		selection_probabilities.build_cdf();
+		probabilities.normalize(sum);
+		probabilities.build_cdf();
 	}
 };
 
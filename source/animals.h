@@ -3,6 +3,54 @@
 #include "grid_agent.forward.h"
 
 
+enum class AnimalEventType { move = 0, arrive = 1, defecate = 2 };
+
+
+class AnimalEvent {
+public:
+	AnimalEvent() = default;
+	AnimalEvent(float _time, int _animal, AnimalEventType _type, long long _sequence_no, int _crop_id = -1) :
+		time(_time), animal(_animal), type(_type), sequence_no(_sequence_no), crop_id(_crop_id)
+	{}
+	bool operator>(const AnimalEvent& event) const {
+		if (time != event.time) return time > event.time;
+		return sequence_no > event.sequence_no; // Events scheduled earlier are processed first when times are equal.
+	}
+	float time = 0;
+	int animal = -1;
+	AnimalEventType type = AnimalEventType::move;
+	long long sequence_no = 0;
+	int crop_id = -1;
+};
+
+
+class SeedDeposit {
+public:
+	SeedDeposit() = default;
+	SeedDeposit(float _time, int _animal, int _crop_id, pair<float, float> _location) :
+		time(_time), animal(_animal), crop_id(_crop_id), location(_location)
+	{}
+	bool operator<(const SeedDeposit& deposit) const {
+		if (time != deposit.time) return time < deposit.time;
+		return animal < deposit.animal;
+	}
+	float time = 0;
+	int animal = -1;
+	int crop_id = -1;
+	pair<float, float> location;
+};
+
+
+class AnimalDispersalStats {
+public:
+	float time_spent_resting = 0;
+	float time_spent_moving = 0;
+	float distance_travelled = 0;
+	int no_seeds_eaten = 0;
+	int no_moves = 0;
+};
+
+
 class Animal {
 public:
 	Animal() = default;
@@ -21,39 +69,26 @@ public:
 	}
 	void reset() {
 		curtime = 0;
-		stomach_content.clear();
+		arrival_time = 0;
+		iteration = 0;
+		moving = false;
 		total_no_seeds_consumed = 0;
+		no_fruit_agnostic_selections = 0;
+		no_random_destinations = 0;
+		pending_defecations = {};
 	}
-	void update(
-		int& no_seeds_dispersed, int _iteration, State* state, ResourceGrid* resource_grid, int& no_seeds_eaten,
-		float& time_spent_resting, float& distance_travelled, float& average_gut_passage_time, float& average_gut_time,
-		int& no_seeds_defecated, float& time_spent_moving, int& no_seedlings_dead_due_to_shade, int& no_seedling_competitions,
-		int& no_competitions_with_older_trees, int& no_germination_attempts, int& no_cases_seedling_competition_and_shading,
-		int& no_cases_oldstem_competition_and_shading
-	) {
-		iteration = _iteration;
-
-		pair<int, int> move_time_interval(curtime, -1);
-		move(resource_grid, distance_travelled);
-		move_time_interval.second = curtime;
-		time_spent_moving += travel_time;
-
-		digest(
-			resource_grid, no_seeds_dispersed, no_seeds_defecated, state, move_time_interval,
-			no_seedlings_dead_due_to_shade, no_seedling_competitions, no_competitions_with_older_trees, no_germination_attempts,
-			no_cases_seedling_competition_and_shading, no_cases_oldstem_competition_and_shading
-		);
-
-		pair<int, int> rest_time_interval(curtime, -1);
+	void seed_RNG(unsigned int base_seed, unsigned int index) {
+		// Give the animal its own random stream, so that its trajectory does not depend on how animals are scheduled over threads.
+		seed_seq sequence{ base_seed, index };
+		rng.seed(sequence);
+		gut_passage_time_distribution.generator.seed(rng());
+		rest_time_distribution.generator.seed(rng());
+	}
+	void arrive(ResourceGrid* resource_grid, float& time_spent_resting, int& no_seeds_eaten, vector<pair<float, int>>& defecations) {
+		// Rest at the destination and eat. The defecation times of the ingested seeds are returned in <defecations>, as (time, crop id) pairs.
+		float rest_begin_time = curtime;
 		rest(time_spent_resting);
-		eat(resource_grid, rest_time_interval.first, no_seeds_eaten);
-		rest_time_interval.second = curtime;
-
-		digest(
-			resource_grid, no_seeds_dispersed, no_seeds_defecated, state, rest_time_interval,
-			no_seedlings_dead_due_to_shade, no_seedling_competitions, no_competitions_with_older_trees, no_germination_attempts,
-			no_cases_seedling_competition_and_shading, no_cases_oldstem_competition_and_shading
-		);
+		eat(resource_grid, rest_begin_time, no_seeds_eaten, defecations);
 	}
 	void rest(float& time_spent_resting) {
 		moving = false;
@@ -72,10 +107,11 @@ public:
 		}
 		return appetite;
 	}
-	void eat(ResourceGrid* resource_grid, float begin_time, int& no_seeds_eaten) {
+	void eat(ResourceGrid* resource_grid, float begin_time, int& no_seeds_eaten, vector<pair<float, int>>& defecations) {
 		float biomass_appetite = get_biomass_appetite();
 		vector<pair<float, int>> consumed_seed_gpts_plus_cropids = {};
-		float fruit_mass = resource_grid->state->population.get_crop(last_tree_visited)->strategy.diaspore_mass;
+		Population* population = &resource_grid->state->population;
+		float fruit_mass = population->get_strategy(population->get_crop(last_tree_visited))->diaspore_mass;
 		while (biomass_appetite >= fruit_mass) {
 			Fruit fruit;
 
@@ -83,27 +119,25 @@ public:
 
 			if (!fruit_available) break;
 
-			eat_fruit(fruit, consumed_seed_gpts_plus_cropids);
+			int no_seeds_per_diaspore = population->strategies.get(fruit.strategy)->no_seeds_per_diaspore;
+			eat_fruit(fruit, no_seeds_per_diaspore, consumed_seed_gpts_plus_cropids);
 
-			no_seeds_eaten += fruit.strategy.no_seeds_per_diaspore;
+			no_seeds_eaten += no_seeds_per_diaspore;
 			biomass_appetite -= fruit_mass;
 		}
-		set_defecation_times(begin_time, consumed_seed_gpts_plus_cropids);
+		set_defecation_times(begin_time, consumed_seed_gpts_plus_cropids, defecations);
 	}
-	void set_defecation_times(float begin_time, vector<pair<float, int>>& consumed_seed_gpts_plus_cropids) {
+	void set_defecation_times(float begin_time, vector<pair<float, int>>& consumed_seed_gpts_plus_cropids, vector<pair<float, int>>& defecations) {
 		float time_stepsize = (curtime - begin_time) / (float)consumed_seed_gpts_plus_cropids.size();
 		for (int i = consumed_seed_gpts_plus_cropids.size() - 1; i >= 0; i--) {
 			float ingestion_time = curtime - (float)(i + 1) * time_stepsize;
 			float gut_passage_time = consumed_seed_gpts_plus_cropids[i].first;
 			int crop_id = consumed_seed_gpts_plus_cropids[i].second;
-			int defecation_time = round(gut_passage_time + ingestion_time);
-			if (stomach_content[defecation_time].size() == 0) stomach_content[defecation_time] = { crop_id };
-			else stomach_content[defecation_time].push_back(crop_id);
+			defecations.push_back(pair<float, int>(gut_passage_time + ingestion_time, crop_id));
 		}
 	}
-	void eat_fruit(Fruit &fruit, vector<pair<float, int>>& consumed_seed_gpts_plus_cropids) {
-		vector<Seed> seeds;
-		for (int i = 0; i < fruit.strategy.no_seeds_per_diaspore; i++) {
+	void eat_fruit(Fruit &fruit, int no_seeds_per_diaspore, vector<pair<float, int>>& consumed_seed_gpts_plus_cropids) {
+		for (int i = 0; i < no_seeds_per_diaspore; i++) {
 			float gut_passage_time = gut_passage_time_distribution.get_gamma_sample();
 			
 			// Multiply GPT by 60 to convert minutes to seconds.
@@ -113,102 +147,117 @@ public:
 			total_no_seeds_consumed++;
 		}
 	}
-	void digest(
-		ResourceGrid* resource_grid, int& no_seeds_dispersed, int& no_seeds_defecated,
-		State* state, pair<int, int>& time_interval, int& no_seedlings_dead_due_to_shade, int& no_seedling_competitions,
-		int& no_competitions_with_older_trees, int& no_germination_attempts, int& no_cases_seedling_competition_and_shading,
-		int& no_cases_oldstem_competition_and_shading
+	pair<float, float> select_destination(
+		ResourceGrid* resource_grid, int recursion_depth = 0, bool try_fruit_agnostic_selection = false, CellSelection* selection = 0
 	) {
-		vector<int> deletion_schedule;
-		for (int defecation_time = time_interval.first; defecation_time <= time_interval.second; defecation_time++) {
-			if (stomach_content[defecation_time].size() == 0) continue; // Skip if there are no seeds with this defecation time in the stomach.
-
-			for (int crop_id : stomach_content[defecation_time]) {
-				if (iteration < 5) continue; // Do not disperse in the first 5 iterations (after Morales et al 2013)
-
-				// Create seed and calculate time since defecation.
-				Seed seed(state->population.get_crop(crop_id)->strategy);
-				float time_since_defecation = curtime - defecation_time;
-
-				// Defecate seed.
-				defecate(
-					seed, time_since_defecation, no_seeds_dispersed, resource_grid, no_seedlings_dead_due_to_shade,
-					no_seedling_competitions, no_competitions_with_older_trees, no_germination_attempts,
-					no_cases_seedling_competition_and_shading, no_cases_oldstem_competition_and_shading
-				);
-
-				no_seeds_defecated++;
-			}
-			stomach_content[defecation_time].clear(); // Remove all seeds with this defecation time from the stomach.
-		}
-	}
-	pair<float, float> select_destination(ResourceGrid* resource_grid, int recursion_depth = 0, bool try_fruit_agnostic_selection = false) {
-		ResourceCell* cell = resource_grid->select_cell(species, position, try_fruit_agnostic_selection);
+		ResourceCell* cell;
+		if (selection) cell = resource_grid->select_cell(species, position, try_fruit_agnostic_selection, selection);
+		else cell = resource_grid->select_cell(species, position, try_fruit_agnostic_selection);
 		if (cell->trees.size() == 0) {
 			if (recursion_depth > 10) {
+				// Counted rather than logged, since this may run on a worker thread (see Animals::log_destination_fallbacks()).
 				if (try_fruit_agnostic_selection) {
-					printf("\n\n WARNING: No cell containing trees found after recursing 10 times. Selecting random location instead...\n\n");
+					no_random_destinations++;
 					return resource_grid->grid->get_random_real_position();
 				}
-				printf("Trying fruit-agnostic selection...\n");
+				no_fruit_agnostic_selections++;
 				if (try_fruit_agnostic_selection == false) recursion_depth = 0; // Reset recursion counter if we are trying fruit-agnostic selection.
-				return select_destination(resource_grid, recursion_depth + 1, true);
+				return select_destination(resource_grid, recursion_depth + 1, true, selection);
 			}
-			return select_destination(resource_grid, recursion_depth + 1, try_fruit_agnostic_selection);
+			return select_destination(resource_grid, recursion_depth + 1, try_fruit_agnostic_selection, selection);
 		}
 		pair<float, float> destination;
 		last_tree_visited = resource_grid->get_random_forested_location(cell, destination);
 		return destination;
 	}
-	void move(ResourceGrid* resource_grid, float& distance_travelled) {
+	void move(ResourceGrid* resource_grid, float& distance_travelled, CellSelection* selection = 0) {
 		moving = true;
-		pair<float, float> destination = select_destination(resource_grid);
+		iteration++;
+		pair<float, float> destination = select_destination(resource_grid, 0, false, selection);
 		float distance;
 		trajectory = resource_grid->get_shortest_trajectory(position, destination, distance);
 		position = destination;
 		distance_travelled += distance;
 		travel_time = distance * recipr_speed;
 		curtime += travel_time;
+		arrival_time = curtime;
 	}
 	pair<float, float> get_backwards_traced_location(float time_since_defecation) {
+		if (travel_time <= 0) return position;
 		return position - (time_since_defecation / travel_time) * trajectory;
 	}
-	void defecate(
-		Seed &seed, float time_since_defecation, int &no_seeds_dispersed, ResourceGrid* resource_grid,
+	bool defecate(
+		int crop_id, float defecation_time, int &no_seeds_dispersed, ResourceGrid* resource_grid,
 		int& no_seedlings_dead_due_to_shade, int& no_seedling_competitions, int& no_competitions_with_older_trees,
 		int& no_germination_attempts, int& no_cases_seedling_competition_and_shading, int& no_cases_oldstem_competition_and_shading
 	) {
-		pair<float, float> seed_deposition_location;
-		if (moving) {
-			seed_deposition_location = get_backwards_traced_location(time_since_defecation);
-		}
-		else {
-			seed_deposition_location = position;
-		}
+		// Returns whether the seed was deposited. Seeds are lost during the first 5 moves (after Morales et al 2013).
+		if (iteration <= 5) return false;
 
-		int prev_seed_dispersed_number = no_seeds_dispersed;
-		seed.deposition_location = seed_deposition_location;
+		deposit(
+			crop_id, get_deposition_location(defecation_time), no_seeds_dispersed, resource_grid, no_seedlings_dead_due_to_shade,
+			no_seedling_competitions, no_competitions_with_older_trees, no_germination_attempts,
+			no_cases_seedling_competition_and_shading, no_cases_oldstem_competition_and_shading
+		);
+		return true;
+	}
+	pair<float, float> get_deposition_location(float defecation_time) {
+		// Seeds defecated while the animal is moving are deposited along its trajectory; otherwise at its resting location.
+		if (moving) return get_backwards_traced_location(arrival_time - defecation_time);
+		return position;
+	}
+	static void deposit(
+		int crop_id, pair<float, float> location, int& no_seeds_dispersed, ResourceGrid* resource_grid,
+		int& no_seedlings_dead_due_to_shade, int& no_seedling_competitions, int& no_competitions_with_older_trees,
+		int& no_germination_attempts, int& no_cases_seedling_competition_and_shading, int& no_cases_oldstem_competition_and_shading
+	) {
+		Seed seed(resource_grid->state->population.get_crop(crop_id)->strategy, crop_id, location);
 		bool germination = seed.germinate_if_location_is_viable(
 			resource_grid->state, no_seedlings_dead_due_to_shade, no_seedling_competitions, no_competitions_with_older_trees, no_germination_attempts,
 			no_cases_seedling_competition_and_shading, no_cases_oldstem_competition_and_shading
 		);
 		no_seeds_dispersed += germination;
 	}
+	void step(ResourceGrid* resource_grid, CellSelection* selection, int animal_idx, AnimalDispersalStats& stats, vector<SeedDeposit>& deposits) {
+		// Perform one move and the subsequent rest, without touching any shared state other than the (locked) fruit stocks.
+		// Seeds defecated in the process are appended to <deposits> rather than germinated, since germination modifies the population.
+		move(resource_grid, stats.distance_travelled, selection);
+		stats.time_spent_moving += travel_time;
+		stats.no_moves++;
+		collect_deposits(arrival_time, animal_idx, deposits);
+
+		vector<pair<float, int>> defecations;
+		arrive(resource_grid, stats.time_spent_resting, stats.no_seeds_eaten, defecations);
+		for (auto& defecation : defecations) pending_defecations.push(defecation);
+		collect_deposits(curtime, animal_idx, deposits);
+	}
+	void collect_deposits(float until, int animal_idx, vector<SeedDeposit>& deposits) {
+		while (!pending_defecations.empty() && pending_defecations.top().first <= until) {
+			auto [defecation_time, crop_id] = pending_defecations.top();
+			pending_defecations.pop();
+			if (iteration <= 5) continue; // Seeds are lost during the first 5 moves (after Morales et al 2013).
+			deposits.push_back(SeedDeposit(defecation_time, animal_idx, crop_id, get_deposition_location(defecation_time)));
+		}
+	}
 	map<string, float> traits;
-	unordered_map<int, vector<int>> stomach_content; // { defecation_time: crop_ids }
 	pair<float, float> position;
 	pair<float, float> trajectory;
 	string species;
 	GammaProbModel gut_passage_time_distribution;
 	GammaProbModel rest_time_distribution;
+	priority_queue<pair<float, int>, vector<pair<float, int>>, greater<pair<float, int>>> pending_defecations; // (defecation time, crop id), used by parallel dispersal.
+	mt19937 rng;
 	float curtime = 0;
+	float arrival_time = 0;
 	float recipr_speed = 0;
 	float travel_time = 0;
 	int last_tree_visited = -1;
-	int iteration = -1;
+	int iteration = 0; // Number of moves made in the current dispersal round.
 	int animal_group_size = 20;
 	int verbosity = 0;
 	int total_no_seeds_consumed = 0;
+	int no_fruit_agnostic_selections = 0;	// Moves for which no cell with trees was found, so fruit abundance was ignored.
+	int no_random_destinations = 0;			// Moves for which no cell with trees was found at all.
 	bool moving = false;
 };
 
@@ -263,55 +312,212 @@ public:
 			}
 		}
 	}
+	void schedule(float time, int animal, AnimalEventType type, int crop_id = -1) {
+		events.push(AnimalEvent(time, animal, type, no_scheduled_events++, crop_id));
+	}
 	void disperse(int& no_seeds_dispersed, int no_seeds_to_disperse, State* state, ResourceGrid* resource_grid,
 		float& fraction_time_spent_moving, int& no_seedlings_dead_due_to_shade, int& no_seedling_competitions,
 		int& no_competitions_with_older_trees, int& no_germination_attempts, int& no_cases_seedling_competition_and_shading,
 		int& no_cases_oldstem_competition_and_shading, int enforce_no_recruits
 	) {
+		// Discrete-event simulation of animal movement. Moves, arrivals and individual gut passages are processed
+		// in order of simulated time, so the cost scales with the number of events rather than with simulated seconds.
+		if (no_threads > 1) {
+			disperse_parallel(
+				no_seeds_dispersed, no_seeds_to_disperse, state, resource_grid, fraction_time_spent_moving, no_seedlings_dead_due_to_shade,
+				no_seedling_competitions, no_competitions_with_older_trees, no_germination_attempts, no_cases_seedling_competition_and_shading,
+				no_cases_oldstem_competition_and_shading
+			);
+			return;
+		}
 		place(state);
 		resource_grid->reset_color_arrays();
-		int iteration = 0;
+		events = priority_queue<AnimalEvent, vector<AnimalEvent>, greater<AnimalEvent>>();
+		no_scheduled_events = 0;
+
+		// Flatten the population and schedule the first move of every animal.
+		vector<Animal*> animals;
+		vector<int> species_indices;
+		vector<string> species_names;
+		vector<int> species_popsizes;
+		for (auto& [species, species_population] : total_animal_population) {
+			if (species_population.size() == 0) continue;
+			resource_grid->update_cover_probabilities(species, species_population[0].traits);
+			resource_grid->update_fruit_probabilities(species, species_population[0].traits);
+			for (auto& animal : species_population) {
+				schedule(animal.curtime, animals.size(), AnimalEventType::move);
+				animals.push_back(&animal);
+				species_indices.push_back(species_names.size());
+			}
+			species_names.push_back(species);
+			species_popsizes.push_back(species_population.size());
+		}
+		vector<int> moves_since_refresh(species_names.size(), 0);
 
 		int no_seeds_eaten = 0;
 		int no_seeds_defecated = 0;
+		int no_moves = 0;
 		float time_spent_resting = 0;
 		float time_spent_moving = 0;
-		while (no_seeds_defecated < no_seeds_to_disperse) {
-			int prev_no_seeds_dispersed = no_seeds_dispersed;
-			int prev_no_seeds_defecated = no_seeds_defecated;
-			float average_gut_passage_time = 0;
-			int cur_no_seeds_defecated = 0;
-			float distance_travelled = 0;
-			float average_gut_time = 0;
-			int cur_no_seeds_eaten = 0;
-			float average_curtime = 0;
+		float distance_travelled = 0;
+		vector<pair<float, int>> defecations;
+		while (no_seeds_defecated < no_seeds_to_disperse && !events.empty()) {
+			AnimalEvent event = events.top();
+			events.pop();
+			Animal* animal = animals[event.animal];
+			if (event.type == AnimalEventType::move) {
+				// Refresh the species' fruit probabilities once all of its animals have moved since the last refresh.
+				int species_idx = species_indices[event.animal];
+				if (moves_since_refresh[species_idx] == species_popsizes[species_idx]) {
+					resource_grid->update_fruit_probabilities(species_names[species_idx], animal->traits);
+					moves_since_refresh[species_idx] = 0;
+				}
+				moves_since_refresh[species_idx]++;
+
+				animal->move(resource_grid, distance_travelled);
+				time_spent_moving += animal->travel_time;
+				schedule(animal->curtime, event.animal, AnimalEventType::arrive);
+				no_moves++;
+				if (no_moves % 100000 == 0) {
+					DBR_LOG(state->logger, LogLevel::debug, "-- Animal dispersal progress: %f %%\n", (float)no_seeds_defecated * 100.0f / (float)no_seeds_to_disperse);
+				}
+			}
+			else if (event.type == AnimalEventType::arrive) {
+				defecations.clear();
+				animal->arrive(resource_grid, time_spent_resting, no_seeds_eaten, defecations);
+				for (auto& [defecation_time, crop_id] : defecations) {
+					schedule(defecation_time, event.animal, AnimalEventType::defecate, crop_id);
+				}
+				schedule(animal->curtime, event.animal, AnimalEventType::move);
+			}
+			else {
+				no_seeds_defecated += animal->defecate(
+					event.crop_id, event.time, no_seeds_dispersed, resource_grid, no_seedlings_dead_due_to_shade,
+					no_seedling_competitions, no_competitions_with_older_trees, no_germination_attempts,
+					no_cases_seedling_competition_and_shading, no_cases_oldstem_competition_and_shading
+				);
+			}
+		}
+		state->logger.metric("animal_moves", no_moves);
+		log_destination_fallbacks(state);
+		DBR_LOG(state->logger, LogLevel::info, "-- Number of animal moves spent dispersing fruits: %d\n", no_moves);
+		fraction_time_spent_moving = time_spent_moving / (time_spent_moving + time_spent_resting);
+	}
+	void disperse_parallel(int& no_seeds_dispersed, int no_seeds_to_disperse, State* state, ResourceGrid* resource_grid,
+		float& fraction_time_spent_moving, int& no_seedlings_dead_due_to_shade, int& no_seedling_competitions,
+		int& no_competitions_with_older_trees, int& no_germination_attempts, int& no_cases_seedling_competition_and_shading,
+		int& no_cases_oldstem_competition_and_shading
+	) {
+		// Animals are simulated in parallel over epochs of <epoch_duration> simulated seconds. Within an epoch, each thread
+		// advances its share of the animals independently, using per-animal random streams and per-cell locks on the fruit stocks.
+		// Between epochs, the seeds defecated during the epoch are germinated serially in order of defecation time.
+		place(state);
+		resource_grid->reset_color_arrays();
+
+		// The caller's random stream (e.g. that of an ensemble replicate) is used for everything outside of the animals' own steps.
+		std::mt19937* caller_RNG = help::get_thread_RNG();
+		vector<Animal*> animals;
+		unsigned int base_seed = help::get_rand();
+		for (auto& [species, species_population] : total_animal_population) {
+			if (species_population.size() == 0) continue;
+			resource_grid->update_cover_probabilities(species, species_population[0].traits);
+			resource_grid->update_fruit_probabilities(species, species_population[0].traits);
+			for (auto& animal : species_population) {
+				animal.seed_RNG(base_seed, animals.size());
+				animals.push_back(&animal);
+			}
+		}
+		if (animals.size() == 0) return;
+
+		vector<CellSelection> selections;
+		vector<AnimalDispersalStats> stats(no_threads);
+		vector<vector<SeedDeposit>> deposits(no_threads);
+		for (int t = 0; t < no_threads; t++) selections.push_back(CellSelection(resource_grid->size));
+
+		int no_seeds_defecated = 0;
+		int no_epochs = 0;
+		float epoch_end = epoch_duration;
+		bool done = false;
+		auto complete_epoch = [&]() noexcept {
+			// Runs on whichever thread arrives last, so the germination draws are taken from the caller's stream explicitly.
+			help::set_thread_RNG(caller_RNG);
+			vector<SeedDeposit> epoch_deposits;
+			for (auto& thread_deposits : deposits) {
+				epoch_deposits.insert(epoch_deposits.end(), thread_deposits.begin(), thread_deposits.end());
+				thread_deposits.clear();
+			}
+			sort(epoch_deposits.begin(), epoch_deposits.end());
+			for (auto& deposit : epoch_deposits) {
+				if (no_seeds_defecated >= no_seeds_to_disperse) break;
+				Animal::deposit(
+					deposit.crop_id, deposit.location, no_seeds_dispersed, resource_grid, no_seedlings_dead_due_to_shade,
+					no_seedling_competitions, no_competitions_with_older_trees, no_germination_attempts,
+					no_cases_seedling_competition_and_shading, no_cases_oldstem_competition_and_shading
+				);
+				no_seeds_defecated++;
+			}
 			for (auto& [species, species_population] : total_animal_population) {
-				if (iteration == 0) resource_grid->update_cover_probabilities(species, species_population[0].traits);
+				if (species_population.size() == 0) continue;
 				resource_grid->update_fruit_probabilities(species, species_population[0].traits);
-				for (auto& animal : species_population) {
-					float _average_gut_time = 0;
-					float _average_gut_passage_time = 0;
-					animal.update(
-						no_seeds_dispersed, iteration, state, resource_grid, cur_no_seeds_eaten, time_spent_resting,
-						distance_travelled, _average_gut_passage_time, _average_gut_time, no_seeds_defecated, time_spent_moving,
-						no_seedlings_dead_due_to_shade, no_seedling_competitions, no_competitions_with_older_trees,
-						no_germination_attempts, no_cases_seedling_competition_and_shading, no_cases_oldstem_competition_and_shading
-					);
-					average_curtime += animal.curtime;
-					average_gut_time += _average_gut_time;
-					average_gut_passage_time += _average_gut_passage_time;
-					if (no_seeds_defecated < no_seeds_to_disperse) break;
+			}
+			no_epochs++;
+			if (no_epochs % 10 == 0) {
+				DBR_LOG(state->logger, LogLevel::debug, "-- Animal dispersal progress: %f %%\n", (float)no_seeds_defecated * 100.0f / (float)no_seeds_to_disperse);
+			}
+			done = no_seeds_defecated >= no_seeds_to_disperse;
+			epoch_end += epoch_duration;
+			help::set_thread_RNG(nullptr);
+		};
+		barrier sync(no_threads, complete_epoch);
+		auto work = [&](int thread_idx) {
+			while (!done) {
+				for (int i = thread_idx; i < animals.size(); i += no_threads) {
+					Animal* animal = animals[i];
+					help::set_thread_RNG(&animal->rng);
+					while (animal->curtime < epoch_end) {
+						animal->step(resource_grid, &selections[thread_idx], i, stats[thread_idx], deposits[thread_idx]);
+					}
 				}
-				if (no_seeds_defecated < no_seeds_to_disperse) break;
+				help::set_thread_RNG(nullptr);
+				sync.arrive_and_wait();
 			}
-			if (iteration % 600 == 0 && iteration > 0) {
-				printf("-- Animal dispersal progress: %f %%\n", (float)no_seeds_defecated * 100.0f / (float)no_seeds_to_disperse);
+		};
+		vector<thread> workers;
+		for (int t = 1; t < no_threads; t++) workers.push_back(thread(work, t));
+		work(0);
+		for (auto& worker : workers) worker.join();
+		help::set_thread_RNG(caller_RNG);
+
+		AnimalDispersalStats total;
+		for (auto& thread_stats : stats) {
+			total.time_spent_moving += thread_stats.time_spent_moving;
+			total.time_spent_resting += thread_stats.time_spent_resting;
+			total.no_moves += thread_stats.no_moves;
+		}
+		state->logger.metric("animal_moves", total.no_moves);
+		log_destination_fallbacks(state);
+		DBR_LOG(state->logger, LogLevel::info, "-- Number of animal moves spent dispersing fruits: %d (%d threads, %d epochs)\n", total.no_moves, no_threads, no_epochs);
+		fraction_time_spent_moving = total.time_spent_moving / (total.time_spent_moving + total.time_spent_resting);
+	}
+	void log_destination_fallbacks(State* state) {
+		// Report the moves of this dispersal round for which Animal::select_destination() found no cell with trees.
+		int no_fruit_agnostic_selections = 0;
+		int no_random_destinations = 0;
+		for (auto& [species, species_population] : total_animal_population) {
+			for (auto& animal : species_population) {
+				no_fruit_agnostic_selections += animal.no_fruit_agnostic_selections;
+				no_random_destinations += animal.no_random_destinations;
 			}
-			no_seeds_eaten += cur_no_seeds_eaten;
-			iteration++;
 		}
-		printf("-- Number of iterations spent dispersing fruits: %d\n", iteration);
-		fraction_time_spent_moving = time_spent_moving / (time_spent_moving + time_spent_resting);
+		if (no_fruit_agnostic_selections > 0) {
+			DBR_LOG(state->logger, LogLevel::trace, "-- Fruit-agnostic cell selection used for %d animal moves.\n", no_fruit_agnostic_selections);
+		}
+		if (no_random_destinations > 0) {
+			DBR_LOG(state->logger, LogLevel::warning,
+				"WARNING: No cell containing trees found after recursing 10 times for %d animal moves. Random locations were selected instead.\n",
+				no_random_destinations
+			);
+		}
 	}
 	int popsize() {
 		int total_popsize = 0;
@@ -320,8 +526,24 @@ public:
 		}
 		return total_popsize;
 	}
+	size_t get_memory_size() const {
+		// Animals with their traits and stomach contents (seeds awaiting defecation), and the event queue. Priority queues do
+		// not expose their capacity, so only their occupied size is counted.
+		size_t bytes = events.size() * sizeof(AnimalEvent);
+		for (auto& [species, species_population] : total_animal_population) {
+			bytes += help::get_memory_size(species_population);
+			for (const Animal& animal : species_population) {
+				bytes += help::get_memory_size(animal.traits) + animal.pending_defecations.size() * sizeof(pair<float, int>);
+			}
+		}
+		return bytes;
+	}
 	map<string, vector<Animal>> total_animal_population;
 	map<string, map<string, float>> animal_kernel_params;
+	priority_queue<AnimalEvent, vector<AnimalEvent>, greater<AnimalEvent>> events;
+	long long no_scheduled_events = 0;
+	float epoch_duration = 3600.0f; // Simulated seconds between synchronizations of the threads in parallel dispersal.
+	int no_threads = 1;
 	int animal_group_size = 0;
 	float total_no_animals = 0;
 	int verbose = 0;
@@ -0,0 +1,413 @@
+#include <thread>
+#include "scaling.h"
+
+
+// Benchmark driver: times core routines of the simulation (micro benchmarks) and complete timesteps (macro benchmarks) with fixed
+// random seeds and the parameter files in data_in, and writes the results as JSON, so that the performance of two versions can be
+// compared on the same machine.
+//
+// Usage: dbr_bench [--data_in DIR] [--out bench.json] [--filter TEXT] [--repetitions N] [--steps N] [--quick]
+//                  [--widths W,W,..] [--covers C,C,..] [--scaling DIMENSIONS] [--densities D,D,..] [--predict W,W,..]
+//                  [key=value ...]
+//
+// Micro benchmarks: sampling from the probability models, building wind kernels, fire percolation, populating tree domains,
+// computing the shade on trees, and selecting resource cells for animals. Macro benchmarks: Dynamics::update() with wind, animal and
+// mixed dispersal for every combination of grid width and initial tree cover, with the mean time per simulation phase (see
+// profiler.h). Each benchmark starts from the same seed, so that repeated runs process identical work.
+//
+// With --scaling, the grid width, initial tree cover and animal population density are swept instead (each separately, around a
+// grid of 200 cells wide with a tree cover of 0.5 and mixed dispersal), and the time of every simulation phase and the memory of
+// every subsystem are fitted as power laws of the grid cells, population size and number of animals (see scaling.h). The fits can
+// be extrapolated to larger grids with --predict, to check which domain sizes fit on a machine before launching experiments.
+
+
+void print_usage() {
+	printf(
+		"Usage: dbr_bench [--data_in DIR] [--out bench.json] [--filter TEXT] [--repetitions N] [--steps N] [--quick]\n"
+		"                 [--widths W,W,..] [--covers C,C,..] [--scaling DIMENSIONS] [--densities D,D,..] [--predict W,W,..]\n"
+		"                 [key=value ...]\n"
+		"  --data_in DIR      Directory containing the parameter files (default: ../data_in).\n"
+		"  --out FILE         Benchmark results, as JSON (default: bench.json).\n"
+		"  --filter TEXT      Only run the benchmarks whose name contains TEXT.\n"
+		"  --repetitions N    Number of timed repetitions of each micro benchmark (default: 10, 3 with --quick).\n"
+		"  --steps N          Number of timed timesteps of each macro benchmark (default: 5, 2 with --quick).\n"
+		"  --quick            Use a single grid width (100) and tree cover (0.5) and fewer repetitions, e.g. as a smoke test.\n"
+		"  --widths W,W,..    Grid widths of the benchmarks that depend on the grid (default: 100,200,400).\n"
+		"  --covers C,C,..    Initial tree covers of the benchmarks that depend on the grid (default: 0.2,0.5,0.8).\n"
+		"  --scaling DIMS     Sweep the comma-separated dimensions (grid_width, treecover, animal_density, or 'all') instead, and fit\n"
+		"                     the phase times and memory as power laws. Widths default to 100,150,200,300,400 and covers to\n"
+		"                     0.2,0.35,0.5,0.65,0.8 (50,100, 0.3,0.6 and 100,400 with --quick).\n"
+		"  --densities D,D,.. Animal population densities (per km^2) of the animal_density sweep (default: 100,200,400,800,1600).\n"
+		"  --predict W,W,..   Extrapolate the step time, init time and memory of the grid_width sweep to these grid widths.\n"
+		"  key=value          Override a simulation parameter, e.g. random_seed=3 (default: 1) or lookup_table_dir=tables.\n"
+	);
+}
+
+vector<string> split(string text) {
+	vector<string> items;
+	for (size_t begin = 0, end = 0; end != string::npos; begin = end + 1) {
+		end = text.find(',', begin);
+		items.push_back(text.substr(begin, end - begin));
+	}
+	return items;
+}
+
+vector<float> parse_list(string text) {
+	vector<float> values;
+	for (string& item : split(text)) values.push_back(stof(item));
+	return values;
+}
+
+string format_cover(float cover) {
+	char text[16];
+	snprintf(text, sizeof(text), "%.2f", cover);
+	return text;
+}
+
+string get_compiler() {
+#if defined(__clang__)
+	return "clang " __clang_version__;
+#elif defined(__GNUC__)
+	return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+	return "msvc " + to_string(_MSC_VER);
+#else
+	return "unknown";
+#endif
+}
+
+
+class BenchmarkSuite {
+public:
+	// Runs the benchmarks and collects their results. The simulations that the micro benchmarks operate on (fixtures) are created
+	// once per scenario, grid width and tree cover, after one warm-up timestep so that crops, fruits and resources exist.
+	BenchmarkSuite(SimulationConfig _config, vector<int> _widths, vector<float> _covers, int _repetitions, int _no_steps, string _filter) :
+		config(_config), widths(_widths), covers(_covers), repetitions(_repetitions), no_steps(_no_steps), filter(_filter)
+	{
+		seed = config.get_int("random_seed");
+	}
+	void run() {
+		run_probability_model_benchmarks();
+		for (int width : widths) {
+			for (float cover : covers) {
+				run_grid_benchmarks(width, cover);
+				fixtures.clear();
+			}
+		}
+		for (int width : widths) {
+			for (float cover : covers) {
+				for (auto& [scenario, _] : scenarios) run_update_benchmark(scenario, width, cover);
+			}
+		}
+	}
+	void write(string path) {
+		JsonValue output;
+		output.set("suite", "dbr_bench");
+		output.set("random_seed", seed);
+		output.set("compiler", get_compiler());
+#ifdef NDEBUG
+		output.set("optimized", true);
+#else
+		output.set("optimized", false);
+#endif
+		output.set("hardware_threads", (int)std::thread::hardware_concurrency());
+		output.set("peak_memory_bytes", (double)help::get_peak_memory_usage());
+		JsonValue benchmarks;
+		benchmarks.type = JsonValue::Type::array;
+		for (BenchmarkResult& result : results) benchmarks.array.push_back(result.to_json());
+		output.set("benchmarks", benchmarks);
+		ofstream file(path);
+		if (!file) throw std::runtime_error("Could not write benchmark results to " + path);
+		file << output.dump() << "\n";
+	}
+	vector<BenchmarkResult> results;
+
+private:
+	bool is_selected(string name) {
+		return filter == "" || name.find(filter) != string::npos;
+	}
+	void add(BenchmarkResult result) {
+		printf("%-48s %10.3f ms  (median %.3f, stdev %.3f)", result.name.c_str(), result.get_mean(), result.get_median(), result.get_stdev());
+		if (result.no_items > 1) printf("  %s items/s", help::readable_number((int)result.get_items_per_second()).c_str());
+		printf("\n");
+		results.push_back(result);
+	}
+	void reseed() {
+		help::init_RNG(seed);
+	}
+	SimulationConfig get_config(string scenario, int width, float cover) {
+		SimulationConfig _config = config;
+		_config.set("dispersal_mode", scenarios.at(scenario).first);
+		_config.set("strategy_distribution_params", scenarios.at(scenario).second);
+		_config.set("grid_width", to_string(width));
+		_config.set("treecover", to_string(cover));
+		_config.set("resource_grid_width", to_string(max(4, width / 10))); // Keeps the resource cells 10 grid cells wide.
+		return _config;
+	}
+	Dynamics& get_fixture(string scenario, int width, float cover) {
+		string key = scenario + "/" + to_string(width) + "/" + to_string(cover);
+		if (fixtures.find(key) == fixtures.end()) {
+			reseed();
+			fixtures[key] = make_unique<Dynamics>();
+			init_benchmark_dynamics(*fixtures[key], get_config(scenario, width, cover));
+			fixtures[key]->update();
+		}
+		return *fixtures[key];
+	}
+	JsonValue get_grid_params(string scenario, int width, float cover) {
+		JsonValue params;
+		params.set("scenario", scenario);
+		params.set("grid_width", width);
+		params.set("treecover", (double)cover);
+		return params;
+	}
+	void run_probability_model_benchmarks() {
+		const int no_samples = 1000000;
+		JsonValue params;
+		params.set("samples", no_samples);
+
+		if (is_selected("prob_model/discrete_sample")) {
+			reseed();
+			help::DiscreteProbabilityModel model(4096);
+			double* probabilities = new double[model.size];
+			for (int i = 0; i < model.size; i++) probabilities[i] = help::get_rand_double(0, 1);
+			double integral;
+			model.set_probabilities(probabilities, integral);
+			model.normalize(integral);
+			model.build_cdf();
+			delete[] probabilities;
+			JsonValue _params = params;
+			_params.set("size", model.size);
+			add(run_benchmark("prob_model/discrete_sample", _params, repetitions, [&]() {
+				int sum = 0;
+				for (int i = 0; i < no_samples; i++) sum += model.sample();
+				if (sum == -1) printf("\n"); // Keeps the samples from being optimized away.
+				return (double)no_samples;
+			}));
+		}
+		if (is_selected("prob_model/linear_sample")) {
+			reseed();
+			help::LinearProbabilityModel model(1, 0, 0, 200);
+			add(run_benchmark("prob_model/linear_sample", params, repetitions, [&]() {
+				float sum = 0;
+				for (int i = 0; i < no_samples; i++) sum += model.linear_sample();
+				if (sum == -1) printf("\n");
+				return (double)no_samples;
+			}));
+		}
+
+		map<string, float> wind = config.get_object("multi_disperser_params").at("wind").as_float_map();
+		auto create_wind_kernel = [&](float height) {
+			Kernel kernel(1, config.get_float("cell_width") * 1000, wind["wspeed_gmean"], wind["wspeed_stdev"], wind["wind_direction"], wind["wind_direction_stdev"], 0.5f);
+			kernel.wind().update(height);
+			return kernel;
+		};
+		if (is_selected("prob_model/wind_kernel_build")) {
+			reseed();
+			const int no_builds = 100;
+			JsonValue _params;
+			_params.set("builds", no_builds);
+			add(run_benchmark("prob_model/wind_kernel_build", _params, repetitions, [&]() {
+				for (int i = 0; i < no_builds; i++) create_wind_kernel(5.0f + 0.2f * i);
+				return (double)no_builds;
+			}));
+		}
+		if (is_selected("prob_model/wind_kernel_sample")) {
+			reseed();
+			Kernel kernel = create_wind_kernel(10.0f);
+			add(run_benchmark("prob_model/wind_kernel_sample", params, repetitions, [&]() {
+				float sum = 0;
+				for (int i = 0; i < no_samples; i++) sum += kernel.get_wind_dispersed_dist();
+				if (sum == -1) printf("\n");
+				return (double)no_samples;
+			}));
+		}
+	}
+	void run_grid_benchmarks(int width, float cover) {
+		JsonValue params = get_grid_params("wind", width, cover);
+		string suffix = "/" + to_string(width) + "/" + format_cover(cover);
+
+		string name = "grid/percolate" + suffix;
+		if (is_selected(name)) {
+			// Fires are lit in a fresh copy of the simulation in every repetition, since burning changes the grid.
+			Dynamics& fixture = get_fixture("wind", width, cover);
+			Dynamics branch;
+			const int no_fires = 20;
+			JsonValue _params = params;
+			_params.set("fires", no_fires);
+			reseed();
+			add(run_benchmark(name, _params, repetitions, [&]() {
+				int no_topkills = 0, no_nonseedling_topkills = 0, no_ash_cells = 0;
+				for (int i = 0; i < no_fires; i++) {
+					no_ash_cells += branch.percolate(branch.grid->get_random_cell(), branch.time, no_topkills, no_nonseedling_topkills).first;
+				}
+				return (double)no_ash_cells;
+			}, [&]() {
+				fixture.fork(branch);
+				branch.time++;
+			}));
+		}
+
+		name = "grid/populate_tree_domain" + suffix;
+		if (is_selected(name)) {
+			Dynamics& fixture = get_fixture("wind", width, cover);
+			add(run_benchmark(name, params, repetitions, [&]() {
+				fixture.grid->reset();
+				for (auto& [id, tree] : fixture.pop->members) fixture.grid->populate_tree_domain(&tree);
+				return (double)fixture.pop->size();
+			}, nullptr));
+			fixture.grid->update_grass_LAIs();
+		}
+
+		name = "state/compute_shade" + suffix;
+		if (is_selected(name)) {
+			Dynamics& fixture = get_fixture("wind", width, cover);
+			add(run_benchmark(name, params, repetitions, [&]() {
+				float sum = 0;
+				for (auto& [id, tree] : fixture.pop->members) sum += fixture.state.compute_shade_on_individual_tree(&tree);
+				if (sum == -1) printf("\n");
+				return (double)fixture.pop->size();
+			}));
+		}
+
+		name = "resource_grid/select_cell" + suffix;
+		if (is_selected(name)) {
+			Dynamics& fixture = get_fixture("animal", width, cover);
+			ResourceGrid& resource_grid = fixture.resource_grid;
+			string species = resource_grid.species[0];
+			resource_grid.update_cover_probabilities(species, resource_grid.animal_kernel_params[species]);
+			resource_grid.update_fruit_probabilities(species, resource_grid.animal_kernel_params[species]);
+			const int no_selections = 200;
+			JsonValue _params = get_grid_params("animal", width, cover);
+			_params.set("species", species);
+			_params.set("resource_grid_width", resource_grid.width);
+			_params.set("selections", no_selections);
+			reseed();
+			add(run_benchmark(name, _params, repetitions, [&]() {
+				for (int i = 0; i < no_selections; i++) resource_grid.select_cell(species, fixture.grid->get_random_real_position());
+				return (double)no_selections;
+			}));
+		}
+	}
+	void run_update_benchmark(string scenario, int width, float cover) {
+		string name = "update/" + scenario + "/" + to_string(width) + "/" + format_cover(cover);
+		if (!is_selected(name)) return;
+		reseed();
+		Dynamics dynamics;
+		init_benchmark_dynamics(dynamics, get_config(scenario, width, cover));
+		dynamics.update(); // Warm-up step: the first timestep has no crops or fruits yet.
+		add(time_updates(dynamics, no_steps, name, get_grid_params(scenario, width, cover)));
+		dynamics.free();
+	}
+	SimulationConfig config;
+	vector<int> widths;
+	vector<float> covers;
+	int repetitions = 10;
+	int no_steps = 5;
+	string filter;
+	int seed = 0;
+	map<string, unique_ptr<Dynamics>> fixtures;
+	// Dispersal mode and strategy distribution parameters per scenario.
+	const map<string, pair<string, string>> scenarios = {
+		{ "wind", { "wind", "windkernel.json" } },
+		{ "animal", { "animal", "animalkernel.json" } },
+		{ "mixed", { "all", "mixedkernel.json" } }
+	};
+};
+
+
+int main(int argc, char** argv) {
+	string data_in_dir = "../data_in";
+	string output_path = "bench.json";
+	string filter = "";
+	int repetitions = -1;
+	int no_steps = -1;
+	bool quick = false;
+	vector<float> widths = { 100, 200, 400 };
+	vector<float> covers = { 0.2f, 0.5f, 0.8f };
+	vector<float> densities = { 100, 200, 400, 800, 1600 };
+	bool widths_given = false, covers_given = false, densities_given = false;
+	string scaling = "";
+	vector<float> predicted_widths;
+	vector<pair<string, string>> overrides;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "-h" || arg == "--help") {
+			print_usage();
+			return 0;
+		}
+		bool has_value = (i + 1 < argc);
+		if (arg == "--data_in" && has_value) data_in_dir = argv[++i];
+		else if (arg == "--out" && has_value) output_path = argv[++i];
+		else if (arg == "--filter" && has_value) filter = argv[++i];
+		else if (arg == "--repetitions" && has_value) repetitions = atoi(argv[++i]);
+		else if (arg == "--steps" && has_value) no_steps = atoi(argv[++i]);
+		else if (arg == "--quick") quick = true;
+		else if (arg == "--widths" && has_value) { widths = parse_list(argv[++i]); widths_given = true; }
+		else if (arg == "--covers" && has_value) { covers = parse_list(argv[++i]); covers_given = true; }
+		else if (arg == "--scaling" && has_value) scaling = argv[++i];
+		else if (arg == "--densities" && has_value) { densities = parse_list(argv[++i]); densities_given = true; }
+		else if (arg == "--predict" && has_value) predicted_widths = parse_list(argv[++i]);
+		else if (arg.find('=') != string::npos) overrides.push_back({ arg.substr(0, arg.find('=')), arg.substr(arg.find('=') + 1) });
+		else {
+			printf("Unrecognized argument: %s\n", arg.c_str());
+			print_usage();
+			return 2;
+		}
+	}
+	if (scaling != "") {
+		if (!widths_given) widths = quick ? vector<float>{ 50, 100 } : vector<float>{ 100, 150, 200, 300, 400 };
+		if (!covers_given) covers = quick ? vector<float>{ 0.3f, 0.6f } : vector<float>{ 0.2f, 0.35f, 0.5f, 0.65f, 0.8f };
+		if (!densities_given && quick) densities = { 100, 400 };
+	}
+	else if (quick) {
+		if (!widths_given) widths = { 100 };
+		if (!covers_given) covers = { 0.5f };
+	}
+	if (repetitions < 1) repetitions = quick ? 3 : 10;
+	if (no_steps < 1) no_steps = quick ? 2 : 5;
+
+	try {
+		SimulationConfig config;
+		config.data_in_dir = data_in_dir;
+		config.set("log_level", "warning");
+		if (scaling != "") {
+			config.set("grid_width", "200");
+			config.set("resource_grid_width", "20");
+			config.set("treecover", "0.5");
+			config.set("strategy_distribution_params", "mixedkernel.json");
+		}
+		for (auto& [key, value] : overrides) config.set(key, value);
+		if (config.get_int("random_seed") == -999) config.set("random_seed", "1"); // The default (a random seed) would make runs incomparable.
+		vector<int> grid_widths;
+		for (float width : widths) grid_widths.push_back((int)width);
+
+		if (scaling != "") {
+			vector<ScalingDimension> dimensions;
+			for (string& name : split(scaling == "all" ? "grid_width,treecover,animal_density" : scaling)) {
+				ScalingDimension dimension;
+				dimension.name = name;
+				if (name == "grid_width") dimension.values = widths;
+				else if (name == "treecover") dimension.values = covers;
+				else dimension.values = densities;
+				dimensions.push_back(dimension);
+			}
+			ScalingStudy study(config, dimensions, no_steps, 1);
+			study.run();
+			vector<int> _predicted_widths;
+			for (float width : predicted_widths) _predicted_widths.push_back((int)width);
+			study.write(output_path, _predicted_widths);
+			printf("Wrote scaling results to %s.\n", output_path.c_str());
+			return 0;
+		}
+		BenchmarkSuite suite(config, grid_widths, covers, repetitions, no_steps, filter);
+		suite.run();
+		suite.write(output_path);
+		printf("Wrote %i benchmark results to %s.\n", (int)suite.results.size(), output_path.c_str());
+	}
+	catch (std::exception& error) {
+		printf("Error: %s\n", error.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <functional>
+#include "simulation_config.h"
+
+
+class BenchmarkResult {
+public:
+	// Timings of a single benchmark: one sample per repetition, in milliseconds. <no_items> is the number of items (samples drawn,
+	// trees, cells burned, ...) processed per repetition, from which the throughput is derived. <details> holds any further output
+	// of the benchmark, such as the mean time per simulation phase.
+	BenchmarkResult() = default;
+	BenchmarkResult(string _name, string _group, JsonValue _params) : name(_name), group(_group), params(_params) {}
+	double get_mean() const {
+		if (samples.empty()) return 0;
+		double sum = 0;
+		for (double sample : samples) sum += sample;
+		return sum / samples.size();
+	}
+	double get_median() const {
+		if (samples.empty()) return 0;
+		vector<double> sorted = samples;
+		sort(sorted.begin(), sorted.end());
+		size_t middle = sorted.size() / 2;
+		return (sorted.size() % 2 == 1) ? sorted[middle] : (sorted[middle - 1] + sorted[middle]) / 2.0;
+	}
+	double get_min() const {
+		return samples.empty() ? 0 : *min_element(samples.begin(), samples.end());
+	}
+	double get_max() const {
+		return samples.empty() ? 0 : *max_element(samples.begin(), samples.end());
+	}
+	double get_stdev() const {
+		// Sample standard deviation.
+		if (samples.size() < 2) return 0;
+		double mean = get_mean();
+		double sum = 0;
+		for (double sample : samples) sum += (sample - mean) * (sample - mean);
+		return sqrt(sum / (samples.size() - 1));
+	}
+	double get_items_per_second() const {
+		double mean = get_mean();
+		return (mean > 0) ? no_items / (mean / 1000.0) : 0;
+	}
+	JsonValue to_json() const {
+		JsonValue result;
+		result.set("name", name);
+		result.set("group", group);
+		result.set("params", params);
+		result.set("repetitions", (int)samples.size());
+		result.set("mean_ms", get_mean());
+		result.set("median_ms", get_median());
+		result.set("min_ms", get_min());
+		result.set("max_ms", get_max());
+		result.set("stdev_ms", get_stdev());
+		JsonValue _samples;
+		_samples.type = JsonValue::Type::array;
+		for (double sample : samples) _samples.array.push_back(sample);
+		result.set("samples_ms", _samples);
+		if (no_items > 0) {
+			result.set("items", no_items);
+			result.set("items_per_second", get_items_per_second());
+		}
+		for (auto& [key, value] : details.object) result.set(key, value);
+		return result;
+	}
+	string name;
+	string group;	// "micro" or "macro"
+	JsonValue params;
+	vector<double> samples;
+	double no_items = 0;
+	JsonValue details;
+};
+
+
+inline void init_benchmark_dynamics(Dynamics& dynamics, const SimulationConfig& config) {
+	// Initialize <dynamics> from <config> in place (the state holds pointers into itself, so it should not be moved afterwards).
+	dynamics = config.create_dynamics();
+	dynamics.profiler.enabled = true;
+	config.init_dynamics(dynamics);
+}
+
+inline JsonValue get_mean_phase_times(Profiler& profiler, int no_steps) {
+	// Mean time per timestep (ms) of every phase recorded by <profiler>, by phase path.
+	JsonValue phases;
+	for (Profiler::Phase& phase : profiler.phases) phases.set(phase.path, phase.total_ns / 1e6 / no_steps);
+	return phases;
+}
+
+inline BenchmarkResult time_updates(Dynamics& dynamics, int no_steps, string name, JsonValue params) {
+	// Time <no_steps> calls of Dynamics::update(), one sample per timestep. The phase statistics of the profiler are reset first, so
+	// that the result also holds the mean time per phase over the timed steps.
+	BenchmarkResult result(name, "macro", params);
+	dynamics.profiler.reset();
+	for (int i = 0; i < no_steps; i++) {
+		Timer timer; timer.start();
+		dynamics.update();
+		timer.stop();
+		result.samples.push_back(timer.elapsedMilliseconds());
+	}
+	result.no_items = 1;
+	result.details.set("phases_ms", get_mean_phase_times(dynamics.profiler, no_steps));
+	result.details.set("population_size", dynamics.pop->size());
+	result.details.set("tree_cover", (double)dynamics.grid->get_tree_cover());
+	size_t memory = 0;
+	for (auto& [subsystem, bytes] : dynamics.get_memory_usage()) memory += bytes;
+	result.details.set("memory_bytes", (double)memory);
+	return result;
+}
+
+inline BenchmarkResult run_benchmark(string name, JsonValue params, int repetitions, std::function<double()> body, std::function<void()> setup = nullptr) {
+	// Time <repetitions> calls of <body>, which returns the number of items it processed. <setup> is called before every repetition,
+	// outside of the timed region.
+	BenchmarkResult result(name, "micro", params);
+	for (int i = 0; i < repetitions; i++) {
+		if (setup) setup();
+		Timer timer; timer.start();
+		result.no_items = body();
+		timer.stop();
+		result.samples.push_back(timer.elapsedMilliseconds());
+	}
+	return result;
+}
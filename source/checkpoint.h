@@ -0,0 +1,653 @@
+#pragma once
+#include <sstream>
+#include "dynamics.h"
+#include "mapped_file.h"
+
+
+// Binary checkpoints of the full simulation state.
+//
+// A checkpoint file consists of a CheckpointHeader followed by a sequence of sections, each stored as an 8-character tag, a 64-bit
+// payload size and the payload. Values are stored in native byte order; the header records it, so that files written on a machine
+// with a different byte order are rejected rather than misread. Loading maps the file into memory and reads from the mapping.
+//
+// Random number generator and distribution states are stored in their standard textual representation. This includes the random
+// stream of the saving thread if it draws from its own generator (see help::set_thread_RNG()), which is restored into the generator
+// of the loading thread. The global rand() stream cannot be captured portably; instead, saving draws a resume seed from it and
+// reseeds it, and loading reseeds the stream with the same seed. In both cases, a simulation that continues after a checkpoint was
+// saved reproduces one that is loaded from it.
+//
+// The iteration order of the population's hash maps determines the order in which trees are processed. It is restored by recreating
+// each map with its original bucket count and inserting the entries in reverse iteration order. This reproduces the order exactly
+// with libstdc++, which prepends new entries to their bucket; with other standard libraries a loaded simulation is valid, but may
+// continue differently from the one that was saved.
+
+
+class CheckpointHeader {
+public:
+	char magic[8] = { 'D', 'B', 'R', 'C', 'K', 'P', 'T', '0' };
+	uint32_t version = 2;
+	uint32_t byte_order = 0x01020304;
+};
+
+
+class CheckpointWriter {
+public:
+	void begin_section(string tag) {
+		char padded_tag[8] = {};
+		memcpy(padded_tag, tag.c_str(), min(tag.size(), sizeof(padded_tag)));
+		append(padded_tag, sizeof(padded_tag));
+		section_begin = buffer.size();
+		put((uint64_t)0);
+	}
+	void end_section() {
+		uint64_t size = buffer.size() - section_begin - sizeof(uint64_t);
+		memcpy(buffer.data() + section_begin, &size, sizeof(size));
+	}
+	template<typename... T> void write(const T&... values) {
+		(put(values), ...);
+	}
+	template<typename T> void write_array(const T* values, size_t count) {
+		append(values, sizeof(T) * count);
+	}
+	template<typename T> void write_random_state(const T& generator_or_distribution) {
+		ostringstream stream;
+		stream << generator_or_distribution;
+		put(stream.str());
+	}
+	void save(string path) {
+		CheckpointHeader header;
+		if (!MappedFile::write(path, &header, sizeof(header), buffer.data(), buffer.size())) {
+			throw std::runtime_error("Could not write checkpoint to " + path);
+		}
+	}
+	vector<char> buffer;
+
+private:
+	void append(const void* bytes, size_t no_bytes) {
+		buffer.insert(buffer.end(), (const char*)bytes, (const char*)bytes + no_bytes);
+	}
+	template<typename T> void put(const T& value) {
+		static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be written directly.");
+		append(&value, sizeof(T));
+	}
+	template<typename A, typename B> void put(const pair<A, B>& value) {
+		put(value.first);
+		put(value.second);
+	}
+	void put(const string& value) {
+		put((uint64_t)value.size());
+		append(value.data(), value.size());
+	}
+	template<typename T> void put(const vector<T>& values) {
+		put((uint64_t)values.size());
+		if constexpr (std::is_trivially_copyable_v<T>) append(values.data(), sizeof(T) * values.size());
+		else for (auto& value : values) put(value);
+	}
+	template<typename K, typename V> void put(const map<K, V>& values) {
+		put((uint64_t)values.size());
+		for (auto& [key, value] : values) {
+			put(key);
+			put(value);
+		}
+	}
+	size_t section_begin = 0;
+};
+
+
+class CheckpointReader {
+public:
+	CheckpointReader(string path) {
+		if (!file.open(path)) throw std::runtime_error("Could not open checkpoint " + path);
+		CheckpointHeader header;
+		if (file.size() < sizeof(header)) throw std::runtime_error(path + " is not a checkpoint file.");
+		memcpy(&header, file.data(), sizeof(header));
+		if (memcmp(header.magic, CheckpointHeader().magic, sizeof(header.magic)) != 0) {
+			throw std::runtime_error(path + " is not a checkpoint file.");
+		}
+		if (header.byte_order != CheckpointHeader().byte_order) {
+			throw std::runtime_error("Checkpoint " + path + " was written on a machine with a different byte order.");
+		}
+		if (header.version != CheckpointHeader().version) {
+			throw std::runtime_error("Checkpoint " + path + " has unsupported format version " + to_string(header.version) + ".");
+		}
+		position = sizeof(header);
+		end = file.size();
+		while (position < end) {
+			char padded_tag[9] = {};
+			get_bytes(padded_tag, 8);
+			uint64_t size = read<uint64_t>();
+			if (size > file.size() - position) throw std::runtime_error("Checkpoint " + path + " is truncated.");
+			sections[padded_tag] = pair<size_t, size_t>(position, position + size);
+			position += size;
+		}
+	}
+	bool has(string tag) {
+		return sections.find(tag) != sections.end();
+	}
+	void seek(string tag) {
+		auto section = sections.find(tag);
+		if (section == sections.end()) throw std::runtime_error("Checkpoint has no '" + tag + "' section.");
+		position = section->second.first;
+		end = section->second.second;
+	}
+	template<typename... T> void read(T&... values) {
+		(get(values), ...);
+	}
+	template<typename T> T read() {
+		T value;
+		get(value);
+		return value;
+	}
+	template<typename T> void read_array(T* values, size_t count) {
+		get_bytes(values, sizeof(T) * count);
+	}
+	template<typename T> void read_random_state(T& generator_or_distribution) {
+		istringstream stream(read<string>());
+		stream >> generator_or_distribution;
+		if (stream.fail()) throw std::runtime_error("Checkpoint contains an invalid random number generator state.");
+	}
+
+private:
+	void get_bytes(void* bytes, size_t no_bytes) {
+		if (no_bytes > end - position) throw std::runtime_error("Checkpoint section is shorter than expected.");
+		memcpy(bytes, file.data() + position, no_bytes);
+		position += no_bytes;
+	}
+	template<typename T> void get(T& value) {
+		static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be read directly.");
+		get_bytes(&value, sizeof(T));
+	}
+	template<typename A, typename B> void get(pair<A, B>& value) {
+		get(value.first);
+		get(value.second);
+	}
+	void get(string& value) {
+		uint64_t size = read<uint64_t>();
+		if (size > end - position) throw std::runtime_error("Checkpoint section is shorter than expected.");
+		value.assign(file.data() + position, size);
+		position += size;
+	}
+	template<typename T> void get(vector<T>& values) {
+		uint64_t size = read<uint64_t>();
+		if (size > end - position) throw std::runtime_error("Checkpoint section is shorter than expected.");
+		values.resize(size);
+		if constexpr (std::is_trivially_copyable_v<T>) get_bytes(values.data(), sizeof(T) * size);
+		else for (auto& value : values) get(value);
+	}
+	template<typename K, typename V> void get(map<K, V>& values) {
+		uint64_t size = read<uint64_t>();
+		values.clear();
+		for (uint64_t i = 0; i < size; i++) {
+			K key;
+			get(key);
+			get(values[key]);
+		}
+	}
+	MappedFile file;
+	map<string, pair<size_t, size_t>> sections; // Tag -> (begin, end) of the section's payload.
+	size_t position = 0;
+	size_t end = 0;
+};
+
+
+namespace checkpoint {
+
+	template<typename K, typename V, typename WriteValue>
+	void write_hash_map(CheckpointWriter& checkpoint, unordered_map<K, V>& values, WriteValue write_value) {
+		checkpoint.write((uint64_t)values.bucket_count(), (uint64_t)values.size());
+		for (auto& [key, value] : values) {
+			checkpoint.write(key);
+			write_value(value);
+		}
+	}
+
+	template<typename K, typename V, typename ReadValue>
+	void read_hash_map(CheckpointReader& checkpoint, unordered_map<K, V>& values, ReadValue read_value) {
+		// Restores the iteration order of the written map (see the notes at the top of this file).
+		uint64_t bucket_count = checkpoint.read<uint64_t>();
+		uint64_t size = checkpoint.read<uint64_t>();
+		vector<pair<K, V>> entries(size);
+		for (auto& [key, value] : entries) {
+			checkpoint.read(key);
+			read_value(value);
+		}
+		unordered_map<K, V> restored(bucket_count);
+		for (auto entry = entries.rbegin(); entry != entries.rend(); entry++) restored.insert(std::move(*entry));
+		values = std::move(restored);
+	}
+
+	inline void write_prob_model(CheckpointWriter& checkpoint, ProbModel& model) {
+		LinearProbabilityModel& linear = model;
+		UniformProbModel& uniform = model;
+		checkpoint.write(model.type, model.prob0, model.prob1, model.prob2);
+		checkpoint.write(linear.q1, linear.q2, linear.min, linear.max, linear.a, linear.b, uniform.min, uniform.max);
+		checkpoint.write(model.min_value, model.max_value, model.constant);
+		checkpoint.write_random_state(model.distribution);
+		checkpoint.write_random_state(model.generator);
+	}
+
+	inline void read_prob_model(CheckpointReader& checkpoint, ProbModel& model) {
+		LinearProbabilityModel& linear = model;
+		UniformProbModel& uniform = model;
+		checkpoint.read(model.type, model.prob0, model.prob1, model.prob2);
+		checkpoint.read(linear.q1, linear.q2, linear.min, linear.max, linear.a, linear.b, uniform.min, uniform.max);
+		checkpoint.read(model.min_value, model.max_value, model.constant);
+		checkpoint.read_random_state(model.distribution);
+		checkpoint.read_random_state(model.generator);
+	}
+
+	inline void write_strategy(CheckpointWriter& checkpoint, Strategy& strategy) {
+		checkpoint.write(
+			strategy.seed_mass, strategy.diaspore_mass, strategy.no_seeds_per_diaspore, strategy.seed_tspeed, strategy.pulp_to_seed_ratio,
+			strategy.recruitment_probability, strategy.relative_growth_rate, strategy.seed_reserve_mass, strategy.seedling_dbh, strategy.vector
+		);
+	}
+
+	inline void read_strategy(CheckpointReader& checkpoint, Strategy& strategy) {
+		checkpoint.read(
+			strategy.seed_mass, strategy.diaspore_mass, strategy.no_seeds_per_diaspore, strategy.seed_tspeed, strategy.pulp_to_seed_ratio,
+			strategy.recruitment_probability, strategy.relative_growth_rate, strategy.seed_reserve_mass, strategy.seedling_dbh, strategy.vector
+		);
+	}
+
+	inline void write_kernel(CheckpointWriter& checkpoint, Kernel& kernel) {
+		checkpoint.write((uint8_t)kernel.payload.index(), kernel.type, kernel.id);
+		if (holds_alternative<LinearDiffusionKernel>(kernel.payload)) {
+			LinearDiffusionKernel& linear = kernel.linear();
+			checkpoint.write(linear.q1, linear.q2, linear.min, linear.max, linear.a, linear.b);
+		}
+		else if (holds_alternative<WindKernel>(kernel.payload)) {
+			// The cdf is not stored; it is rebuilt on loading (see read_kernel()).
+			WindKernel& wind = kernel.wind();
+			checkpoint.write(wind.xmax, wind.resolution, wind.piece_width, wind.built);
+			checkpoint.write(
+				wind.wspeed_gmean, wind.wspeed_stdev, wind.wind_direction, wind.wind_direction_stdev, wind.seed_tspeed, wind.abs_height,
+				wind.prev_build_height, wind.domain_size, wind.dist_max
+			);
+		}
+	}
+
+	inline void read_kernel(CheckpointReader& checkpoint, Kernel& kernel) {
+		uint8_t payload = checkpoint.read<uint8_t>();
+		checkpoint.read(kernel.type, kernel.id);
+		if (payload == 1) {
+			LinearDiffusionKernel linear;
+			checkpoint.read(linear.q1, linear.q2, linear.min, linear.max, linear.a, linear.b);
+			kernel.payload = linear;
+		}
+		else if (payload == 2) {
+			WindKernel wind;
+			checkpoint.read(wind.xmax, wind.resolution, wind.piece_width, wind.built);
+			checkpoint.read(
+				wind.wspeed_gmean, wind.wspeed_stdev, wind.wind_direction, wind.wind_direction_stdev, wind.seed_tspeed, wind.abs_height,
+				wind.prev_build_height, wind.domain_size, wind.dist_max
+			);
+			if (wind.built) {
+				// Kernels are only rebuilt by WindKernel::update(), at the height recorded in prev_build_height.
+				float abs_height = wind.abs_height;
+				wind.abs_height = wind.prev_build_height;
+				wind.build();
+				wind.abs_height = abs_height;
+			}
+			kernel.payload = wind;
+		}
+		else kernel.payload = monostate();
+	}
+
+	inline void write_dynamics(CheckpointWriter& checkpoint, Dynamics& dynamics) {
+		checkpoint.begin_section("dynamics");
+		checkpoint.write(
+			dynamics.unsuppressed_flammability, dynamics.min_suppressed_flammability, dynamics.max_suppressed_flammability,
+			dynamics.self_ignition_factor, dynamics.rainfall, dynamics.seed_bearing_threshold, dynamics.growth_rate_multiplier,
+			dynamics.radius_suppr_flamm_min, dynamics.flamm_delta_radius, dynamics.max_dbh, dynamics.seedling_discard_dbh, dynamics.cell_width,
+			dynamics.saturation_threshold, dynamics.fire_resistance_argmin, dynamics.fire_resistance_argmax, dynamics.fire_resistance_stretch,
+			dynamics.background_mortality, dynamics.fraction_time_spent_moving, dynamics.mutation_rate, dynamics.STR, dynamics._enforce_no_recruits
+		);
+		checkpoint.write(
+			dynamics.no_cases_seedling_competition_and_shading, dynamics.no_cases_oldstem_competition_and_shading,
+			dynamics.no_germination_attempts, dynamics.no_competitions_with_older_trees, dynamics.no_seedlings_dead_due_to_shade,
+			dynamics.no_seedling_competitions, dynamics.no_wind_seedlings, dynamics.no_animal_seedlings, dynamics.no_recruits
+		);
+		checkpoint.write(
+			dynamics.timestep, dynamics.time, dynamics.pop_size, dynamics.verbosity, dynamics.seeds_produced, dynamics.resource_grid_width,
+			dynamics.animal_group_size, dynamics.animal_dispersal_threads, dynamics.no_fire_induced_deaths, dynamics.no_fire_induced_topkills,
+			dynamics.no_fire_induced_nonseedling_topkills, dynamics.initial_no_effective_dispersals
+		);
+		RunStatistics& statistics = dynamics.run_statistics;
+		checkpoint.write(
+			statistics.tree_cover, statistics.slope, statistics.largest_absolute_slope, statistics.initial_no_dispersals, statistics.no_steps,
+			statistics.termination_cause
+		);
+		checkpoint.write(dynamics.fires, dynamics.strategy_distribution_params, dynamics.state.initial_tree_cover, dynamics.state.saturation_threshold);
+		checkpoint.write_random_state(dynamics.random_generator);
+		checkpoint.end_section();
+
+		// Parameters needed to construct the state before the remaining sections can be read into it.
+		Population& population = dynamics.state.population;
+		checkpoint.begin_section("init");
+		checkpoint.write(
+			dynamics.state.grid.width, population.dbh_probability_model.q1, population.dbh_probability_model.q2,
+			population.growth_multiplier_distribution.distribution.stddev(), population.growth_multiplier_distribution.min_value,
+			population.growth_multiplier_distribution.max_value
+		);
+		checkpoint.end_section();
+	}
+
+	inline void read_dynamics(CheckpointReader& checkpoint, Dynamics& dynamics) {
+		checkpoint.seek("dynamics");
+		checkpoint.read(
+			dynamics.unsuppressed_flammability, dynamics.min_suppressed_flammability, dynamics.max_suppressed_flammability,
+			dynamics.self_ignition_factor, dynamics.rainfall, dynamics.seed_bearing_threshold, dynamics.growth_rate_multiplier,
+			dynamics.radius_suppr_flamm_min, dynamics.flamm_delta_radius, dynamics.max_dbh, dynamics.seedling_discard_dbh, dynamics.cell_width,
+			dynamics.saturation_threshold, dynamics.fire_resistance_argmin, dynamics.fire_resistance_argmax, dynamics.fire_resistance_stretch,
+			dynamics.background_mortality, dynamics.fraction_time_spent_moving, dynamics.mutation_rate, dynamics.STR, dynamics._enforce_no_recruits
+		);
+		checkpoint.read(
+			dynamics.no_cases_seedling_competition_and_shading, dynamics.no_cases_oldstem_competition_and_shading,
+			dynamics.no_germination_attempts, dynamics.no_competitions_with_older_trees, dynamics.no_seedlings_dead_due_to_shade,
+			dynamics.no_seedling_competitions, dynamics.no_wind_seedlings, dynamics.no_animal_seedlings, dynamics.no_recruits
+		);
+		checkpoint.read(
+			dynamics.timestep, dynamics.time, dynamics.pop_size, dynamics.verbosity, dynamics.seeds_produced, dynamics.resource_grid_width,
+			dynamics.animal_group_size, dynamics.animal_dispersal_threads, dynamics.no_fire_induced_deaths, dynamics.no_fire_induced_topkills,
+			dynamics.no_fire_induced_nonseedling_topkills, dynamics.initial_no_effective_dispersals
+		);
+		RunStatistics& statistics = dynamics.run_statistics;
+		checkpoint.read(
+			statistics.tree_cover, statistics.slope, statistics.largest_absolute_slope, statistics.initial_no_dispersals, statistics.no_steps,
+			statistics.termination_cause
+		);
+		float initial_tree_cover, state_saturation_threshold;
+		checkpoint.read(dynamics.fires, dynamics.strategy_distribution_params, initial_tree_cover, state_saturation_threshold);
+		checkpoint.read_random_state(dynamics.random_generator);
+
+		checkpoint.seek("init");
+		int width = checkpoint.read<int>();
+		float dbh_q1, dbh_q2, growth_multiplier_stdev, growth_multiplier_min, growth_multiplier_max;
+		checkpoint.read(dbh_q1, dbh_q2, growth_multiplier_stdev, growth_multiplier_min, growth_multiplier_max);
+		dynamics.init_state(width, dbh_q1, dbh_q2, growth_multiplier_stdev, growth_multiplier_min, growth_multiplier_max);
+		dynamics.state.initial_tree_cover = initial_tree_cover;
+		dynamics.state.saturation_threshold = state_saturation_threshold;
+	}
+
+	inline void write_kernels(CheckpointWriter& checkpoint, Dynamics& dynamics) {
+		// Only the parameters of the global kernels are stored; the kernels, resource grid and animals are recreated from them.
+		checkpoint.begin_section("kernels");
+		bool linear = dynamics.global_kernel_exists(DispersalVector::linear);
+		checkpoint.write(linear);
+		if (linear) {
+			LinearDiffusionKernel& kernel = dynamics.global_kernels[DispersalVector::linear].linear();
+			checkpoint.write(kernel.q1, kernel.q2, kernel.min, kernel.max);
+		}
+		bool wind = dynamics.global_kernel_exists(DispersalVector::wind);
+		checkpoint.write(wind);
+		if (wind) {
+			WindKernel& kernel = dynamics.global_kernels[DispersalVector::wind].wind();
+			checkpoint.write(kernel.wspeed_gmean, kernel.wspeed_stdev, kernel.wind_direction, kernel.wind_direction_stdev);
+		}
+		bool animal = dynamics.global_kernel_exists(DispersalVector::animal);
+		checkpoint.write(animal);
+		if (animal) checkpoint.write(dynamics.resource_grid.animal_kernel_params);
+		checkpoint.end_section();
+	}
+
+	inline void read_kernels(CheckpointReader& checkpoint, Dynamics& dynamics) {
+		checkpoint.seek("kernels");
+		if (checkpoint.read<bool>()) {
+			float q1, q2, min, max;
+			checkpoint.read(q1, q2, min, max);
+			dynamics.set_global_linear_kernel(q1, q2, min, max);
+		}
+		if (checkpoint.read<bool>()) {
+			float wspeed_gmean, wspeed_stdev, wind_direction, wind_direction_stdev;
+			checkpoint.read(wspeed_gmean, wspeed_stdev, wind_direction, wind_direction_stdev);
+			dynamics.set_global_wind_kernel(wspeed_gmean, wspeed_stdev, wind_direction, wind_direction_stdev);
+		}
+		if (checkpoint.read<bool>()) {
+			map<string, map<string, float>> animal_kernel_params;
+			checkpoint.read(animal_kernel_params);
+			dynamics.set_global_animal_kernel(animal_kernel_params);
+		}
+	}
+
+	inline void write_grid(CheckpointWriter& checkpoint, Dynamics& dynamics) {
+		Grid& grid = dynamics.state.grid;
+		checkpoint.begin_section("grid");
+		checkpoint.write(grid.width, grid.cell_width, grid.tree_cover, grid.no_savanna_cells, grid.no_forest_cells, grid.state_distribution_dirty);
+		checkpoint.write(grid.touched_state_cells, grid.seedling_cells);
+		checkpoint.write_array(grid.state_distribution.get(), grid.no_cells);
+		checkpoint.write_array(dynamics.fire_free_interval_averages.get(), grid.no_cells);
+		for (int i = 0; i < grid.no_cells; i++) {
+			Cell& cell = grid.distribution[i];
+			checkpoint.write(
+				cell.state, cell.time_last_fire, cell.trees, cell.seedling_present, cell.resprout_present, cell.stem, cell.get_LAI(),
+				cell.query_grass_LAI()
+			);
+		}
+		checkpoint.end_section();
+	}
+
+	inline void read_grid(CheckpointReader& checkpoint, Dynamics& dynamics) {
+		Grid& grid = dynamics.state.grid;
+		checkpoint.seek("grid");
+		int width;
+		float cell_width;
+		checkpoint.read(width, cell_width);
+		if (width != grid.width || cell_width != grid.cell_width) throw std::runtime_error("Checkpoint grid does not match the simulation parameters.");
+		checkpoint.read(grid.tree_cover, grid.no_savanna_cells, grid.no_forest_cells, grid.state_distribution_dirty);
+		checkpoint.read(grid.touched_state_cells, grid.seedling_cells);
+		checkpoint.read_array(grid.state_distribution.get(), grid.no_cells);
+		checkpoint.read_array(dynamics.fire_free_interval_averages.get(), grid.no_cells);
+		for (int i = 0; i < grid.no_cells; i++) {
+			Cell& cell = grid.distribution[i];
+			float LAI, grass_LAI;
+			checkpoint.read(cell.state, cell.time_last_fire, cell.trees, cell.seedling_present, cell.resprout_present, cell.stem, LAI, grass_LAI);
+			cell.restore_LAI(LAI, grass_LAI);
+		}
+	}
+
+	inline void write_population(CheckpointWriter& checkpoint, Population& population) {
+		checkpoint.begin_section("pop");
+		checkpoint.write(
+			population.max_dbh, population.cellsize, population.seed_mass, population.mutation_rate, population.seed_bearing_threshold,
+			population.no_created_trees, population.recruitment_rates, population.resprout_growthcurve
+		);
+		LinearProbabilityModel& dbh_model = population.dbh_probability_model;
+		checkpoint.write(dbh_model.q1, dbh_model.q2, dbh_model.min, dbh_model.max, dbh_model.a, dbh_model.b);
+		write_prob_model(checkpoint, population.growth_multiplier_distribution);
+		checkpoint.write((uint64_t)population.strategy_generator.trait_distributions.size());
+		for (auto& [trait, model] : population.strategy_generator.trait_distributions) {
+			checkpoint.write(trait);
+			write_prob_model(checkpoint, model);
+		}
+
+		StrategyPool& strategies = population.strategies;
+		checkpoint.write((uint64_t)strategies.strategies.size());
+		for (auto& strategy : strategies.strategies) write_strategy(checkpoint, strategy);
+		checkpoint.write(strategies.refcounts, strategies.free_handles);
+
+		write_hash_map(checkpoint, population.members, [&](Tree& tree) {
+			checkpoint.write(
+				tree.radius, tree.dbh, tree.bark_thickness, tree.shade, tree.LAI, tree.height, tree.lowest_branch, tree.crown_area,
+				tree.growth_multiplier, tree.position, tree.id, tree.age, tree.life_phase, tree.last_mortality_check
+			);
+			// Trees are created with the population's resprout growth curve, so it is only stored if it differs.
+			bool own_growthcurve = (tree.resprout_growthcurve != population.resprout_growthcurve);
+			checkpoint.write(own_growthcurve);
+			if (own_growthcurve) checkpoint.write(tree.resprout_growthcurve);
+		});
+		write_hash_map(checkpoint, population.crops, [&](Crop& crop) {
+			checkpoint.write(
+				crop.no_seeds, crop.no_diaspora, crop.fruit_abundance, crop.total_no_seeds_produced, crop.seed_mass, crop.strategy, crop.origin,
+				crop.id
+			);
+		});
+		write_hash_map(checkpoint, population.kernels_individual, [&](Kernel& kernel) {
+			write_kernel(checkpoint, kernel);
+		});
+		checkpoint.end_section();
+	}
+
+	inline void read_population(CheckpointReader& checkpoint, Population& population) {
+		checkpoint.seek("pop");
+		checkpoint.read(
+			population.max_dbh, population.cellsize, population.seed_mass, population.mutation_rate, population.seed_bearing_threshold,
+			population.no_created_trees, population.recruitment_rates, population.resprout_growthcurve
+		);
+		LinearProbabilityModel& dbh_model = population.dbh_probability_model;
+		checkpoint.read(dbh_model.q1, dbh_model.q2, dbh_model.min, dbh_model.max, dbh_model.a, dbh_model.b);
+		read_prob_model(checkpoint, population.growth_multiplier_distribution);
+		uint64_t no_traits = checkpoint.read<uint64_t>();
+		population.strategy_generator.trait_distributions.clear();
+		for (uint64_t i = 0; i < no_traits; i++) {
+			string trait = checkpoint.read<string>();
+			read_prob_model(checkpoint, population.strategy_generator.trait_distributions[trait]);
+		}
+
+		StrategyPool& strategies = population.strategies;
+		strategies = StrategyPool();
+		strategies.strategies.resize(checkpoint.read<uint64_t>());
+		for (auto& strategy : strategies.strategies) read_strategy(checkpoint, strategy);
+		checkpoint.read(strategies.refcounts, strategies.free_handles);
+		vector<bool> is_free(strategies.strategies.size(), false);
+		for (int handle : strategies.free_handles) is_free[handle] = true;
+		for (int handle = 0; handle < strategies.strategies.size(); handle++) {
+			if (!is_free[handle]) strategies.index[strategies.strategies[handle]] = handle;
+		}
+
+		read_hash_map(checkpoint, population.members, [&](Tree& tree) {
+			checkpoint.read(
+				tree.radius, tree.dbh, tree.bark_thickness, tree.shade, tree.LAI, tree.height, tree.lowest_branch, tree.crown_area,
+				tree.growth_multiplier, tree.position, tree.id, tree.age, tree.life_phase, tree.last_mortality_check
+			);
+			if (checkpoint.read<bool>()) checkpoint.read(tree.resprout_growthcurve);
+			else tree.resprout_growthcurve = population.resprout_growthcurve;
+		});
+		read_hash_map(checkpoint, population.crops, [&](Crop& crop) {
+			checkpoint.read(
+				crop.no_seeds, crop.no_diaspora, crop.fruit_abundance, crop.total_no_seeds_produced, crop.seed_mass, crop.strategy, crop.origin,
+				crop.id
+			);
+		});
+		read_hash_map(checkpoint, population.kernels_individual, [&](Kernel& kernel) {
+			read_kernel(checkpoint, kernel);
+		});
+	}
+
+	inline void write_animals(CheckpointWriter& checkpoint, Dynamics& dynamics) {
+		// Animals are placed anew at the start of every dispersal round, so apart from their random streams little of their state
+		// carries over between timesteps.
+		Animals& animals = dynamics.animal_dispersal.animals;
+		checkpoint.begin_section("animals");
+		checkpoint.write(animals.no_scheduled_events, (uint64_t)animals.total_animal_population.size());
+		for (auto& [species, species_population] : animals.total_animal_population) {
+			checkpoint.write(species, (uint64_t)species_population.size());
+			for (auto& animal : species_population) {
+				checkpoint.write(
+					animal.position, animal.trajectory, animal.curtime, animal.arrival_time, animal.travel_time, animal.last_tree_visited,
+					animal.iteration, animal.total_no_seeds_consumed, animal.moving
+				);
+				checkpoint.write_random_state(animal.gut_passage_time_distribution.distribution);
+				checkpoint.write_random_state(animal.gut_passage_time_distribution.generator);
+				checkpoint.write_random_state(animal.rest_time_distribution.distribution);
+				checkpoint.write_random_state(animal.rest_time_distribution.generator);
+				checkpoint.write_random_state(animal.rng);
+			}
+		}
+		checkpoint.end_section();
+
+		ResourceGrid& resource_grid = dynamics.resource_grid;
+		checkpoint.begin_section("resource");
+		checkpoint.write(resource_grid.size, resource_grid.iteration, resource_grid.visits_sum);
+		if (resource_grid.size > 0) {
+			checkpoint.write_array(resource_grid.visits.get(), resource_grid.size);
+			checkpoint.write_array(resource_grid.dist_aggregate.get(), resource_grid.size);
+		}
+		checkpoint.end_section();
+	}
+
+	inline void read_animals(CheckpointReader& checkpoint, Dynamics& dynamics) {
+		Animals& animals = dynamics.animal_dispersal.animals;
+		checkpoint.seek("animals");
+		uint64_t no_species;
+		checkpoint.read(animals.no_scheduled_events, no_species);
+		for (uint64_t i = 0; i < no_species; i++) {
+			string species = checkpoint.read<string>();
+			uint64_t popsize = checkpoint.read<uint64_t>();
+			auto species_population = animals.total_animal_population.find(species);
+			if (species_population == animals.total_animal_population.end() || species_population->second.size() != popsize) {
+				throw std::runtime_error("Checkpoint animal population of species " + species + " does not match the animal kernel parameters.");
+			}
+			for (auto& animal : species_population->second) {
+				checkpoint.read(
+					animal.position, animal.trajectory, animal.curtime, animal.arrival_time, animal.travel_time, animal.last_tree_visited,
+					animal.iteration, animal.total_no_seeds_consumed, animal.moving
+				);
+				checkpoint.read_random_state(animal.gut_passage_time_distribution.distribution);
+				checkpoint.read_random_state(animal.gut_passage_time_distribution.generator);
+				checkpoint.read_random_state(animal.rest_time_distribution.distribution);
+				checkpoint.read_random_state(animal.rest_time_distribution.generator);
+				checkpoint.read_random_state(animal.rng);
+			}
+		}
+
+		ResourceGrid& resource_grid = dynamics.resource_grid;
+		checkpoint.seek("resource");
+		int size = checkpoint.read<int>();
+		if (size != resource_grid.size) throw std::runtime_error("Checkpoint resource grid does not match the simulation parameters.");
+		checkpoint.read(resource_grid.iteration, resource_grid.visits_sum);
+		if (size > 0) {
+			checkpoint.read_array(resource_grid.visits.get(), size);
+			checkpoint.read_array(resource_grid.dist_aggregate.get(), size);
+		}
+	}
+};
+
+
+inline void save_checkpoint(Dynamics& dynamics, string path) {
+	// Write the full simulation state to <path>. See the notes at the top of this file on how the random streams are continued.
+	CheckpointWriter writer;
+	checkpoint::write_dynamics(writer, dynamics);
+	checkpoint::write_kernels(writer, dynamics);
+	checkpoint::write_grid(writer, dynamics);
+	checkpoint::write_population(writer, dynamics.state.population);
+	checkpoint::write_animals(writer, dynamics);
+
+	std::mt19937* thread_RNG = help::get_thread_RNG();
+	unsigned int resume_seed = 0;
+	writer.begin_section("rng");
+	writer.write(thread_RNG != nullptr);
+	if (thread_RNG) writer.write_random_state(*thread_RNG);
+	else {
+		resume_seed = help::get_rand();
+		writer.write(resume_seed);
+	}
+	writer.end_section();
+	writer.save(path);
+	if (!thread_RNG) help::reseed_RNG(resume_seed);
+}
+
+inline void load_checkpoint(Dynamics& dynamics, string path, string lookup_table_dir = ".", bool shared_lookup_tables = false) {
+	// Replace the state of <dynamics> with the one stored in <path>. The resource grid distance lookup tables are not part of the
+	// checkpoint; they are loaded from (or computed and cached in) <lookup_table_dir>.
+	CheckpointReader reader(path);
+	dynamics = Dynamics();
+	checkpoint::read_dynamics(reader, dynamics);
+	checkpoint::read_kernels(reader, dynamics);
+	checkpoint::read_grid(reader, dynamics);
+	checkpoint::read_population(reader, dynamics.state.population);
+	checkpoint::read_animals(reader, dynamics);
+	for (string& species : dynamics.resource_grid.species) {
+		dynamics.resource_grid.init_dist_lookup_table(species, lookup_table_dir, shared_lookup_tables);
+	}
+
+	reader.seek("rng");
+	if (reader.read<bool>()) {
+		std::mt19937 saved_RNG;
+		reader.read_random_state(saved_RNG);
+		if (std::mt19937* thread_RNG = help::get_thread_RNG()) *thread_RNG = saved_RNG;
+		else help::reseed_RNG(saved_RNG()); // Saved from a thread with its own generator, but loaded on one that uses rand().
+	}
+	else help::reseed_RNG(reader.read<unsigned int>());
+	printf("Loaded checkpoint %s (time %i, %s trees).\n", path.c_str(), dynamics.time, help::readable_number(dynamics.pop->size()).c_str());
+}
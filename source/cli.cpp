@@ -0,0 +1,291 @@
+#include "sweep.h"
+#include "checkpoint.h"
+#include "raster_series.h"
+#include "tree_log.h"
+
+
+// Headless driver: runs a simulation without the Python front end and writes per-timestep metrics and a run summary.
+//
+// Usage: dbr_cli [config.json] [--data_in DIR] [--out metrics.csv] [--summary summary.json] [--replicates N] [--threads N]
+//                [--sweep sweep.json] [--checkpoint out.ckpt] [--resume in.ckpt] [--raster out.rast] [--tree_log out.tlog]
+//                [--trace trace.json] [--profile phases.csv] [--counters] [--memory memory.csv] [key=value ...]
+//
+// The configuration file uses the parameter names of DBR-sim/config.py; key=value arguments override it. With --replicates,
+// an ensemble of independent runs is simulated in-process and the metrics file holds the per-timestep mean and variance.
+// With --sweep, a parameter sweep or saddle search (see sweep.h for the settings) is run and its results are written to --out.
+// With --resume, a single run continues from a checkpoint written by --checkpoint (see checkpoint.h); max_timesteps refers to
+// the simulated time, so the run continues until that time is reached. With --raster and --tree_log, the grid layers (see
+// raster_series.h) and the tree events and population snapshots (see tree_log.h) of a single run are recorded after every timestep.
+// The run summary includes the number of calls and the total and maximum time of each simulation phase (see profiler.h), and with
+// --counters also their hardware event counts (cycles, instructions, LLC misses and branch misses, Linux only; events on the
+// worker threads of animal_dispersal_threads > 1 are not included). --profile writes the same statistics per timestep. The
+// summary also holds the memory in use per subsystem at the end of the run and the peak resident memory of the process; --memory
+// writes the memory per subsystem after every timestep.
+
+
+void print_usage() {
+	printf(
+		"Usage: dbr_cli [config.json] [--data_in DIR] [--out metrics.csv] [--summary summary.json] [--replicates N] [--threads N]\n"
+		"               [--sweep sweep.json] [--checkpoint out.ckpt] [--resume in.ckpt] [--raster out.rast] [--tree_log out.tlog]\n"
+		"               [--trace trace.json] [--profile phases.csv] [--counters] [--memory memory.csv] [key=value ...]\n"
+		"  config.json        Simulation parameters (same names as in DBR-sim/config.py). Defaults are used for missing keys.\n"
+		"  --data_in DIR      Directory containing the parameter files referenced by the configuration (default: ../data_in).\n"
+		"  --out FILE         Per-timestep metrics, as CSV (default: metrics.csv).\n"
+		"  --summary FILE     Run summary, as JSON (default: summary.json).\n"
+		"  --replicates N     Simulate an ensemble of N independent replicates and write their mean and variance (default: 1).\n"
+		"  --threads N        Number of threads used to simulate replicates or sweep points (default: one per core).\n"
+		"  --sweep FILE       Run the parameter sweep or saddle search described in FILE and write one result row per run to --out.\n"
+		"  --checkpoint FILE  Write a checkpoint of the full simulation state to FILE at the end of a single run.\n"
+		"  --resume FILE      Continue a single run from the checkpoint in FILE instead of initializing it from the parameters.\n"
+		"  --raster FILE      Record the state, cover, LAI and fire layers of a single run after every timestep to FILE.\n"
+		"  --tree_log FILE    Record the tree events and a snapshot of the population of a single run after every timestep to FILE.\n"
+		"  --trace FILE       Write a Chrome trace of the simulation phases of a single run to FILE (see profiler.h).\n"
+		"  --profile FILE     Write the calls, times and hardware event counts of each simulation phase per timestep to FILE, as CSV.\n"
+		"  --counters         Count hardware events (cycles, instructions, LLC misses, branch misses) per simulation phase\n"
+		"                     (on the simulation thread only, so not in the workers of animal_dispersal_threads > 1).\n"
+		"  --memory FILE      Write the memory in use per subsystem (population, grid, resource grid, animals) after every timestep to FILE.\n"
+		"  key=value          Override a single parameter, e.g. max_timesteps=500 or dispersal_mode=wind.\n"
+	);
+}
+
+void write_summary(string path, Dynamics& dynamics, double runtime) {
+	JsonValue summary;
+	RunStatistics& statistics = dynamics.run_statistics;
+	summary.set("termination_cause", statistics.termination_cause);
+	summary.set("no_steps", statistics.no_steps);
+	summary.set("time", dynamics.time);
+	summary.set("tree_cover", (double)statistics.tree_cover);
+	summary.set("slope", (double)statistics.slope);
+	summary.set("largest_absolute_slope", (double)statistics.largest_absolute_slope);
+	summary.set("initial_no_dispersals", statistics.initial_no_dispersals);
+	summary.set("population_size", dynamics.pop->size());
+	summary.set("runtime_seconds", runtime);
+	JsonValue phases;
+	for (Profiler::Phase& phase : dynamics.profiler.phases) {
+		JsonValue entry;
+		entry.set("calls", (double)phase.calls);
+		entry.set("total_ms", phase.total_ns / 1e6);
+		entry.set("max_ms", phase.max_ns / 1e6);
+		for (int i = 0; i < PerfCounters::no_counters; i++) {
+			if (dynamics.profiler.counters.is_supported(i)) entry.set(PerfCounters::names[i], (double)phase.counts[i]);
+		}
+		phases.set(phase.path, entry);
+	}
+	summary.set("phases", phases);
+	JsonValue memory;
+	for (auto& [subsystem, bytes] : dynamics.get_memory_usage()) memory.set(subsystem, (double)bytes);
+	summary.set("memory_bytes", memory);
+	summary.set("peak_memory_bytes", (double)help::get_peak_memory_usage());
+	ofstream file(path);
+	if (!file) throw std::runtime_error("Could not write summary to " + path);
+	file << summary.dump() << "\n";
+}
+
+void write_profile(string path, Profiler& profiler) {
+	FILE* file = fopen(path.c_str(), "w");
+	if (file == nullptr) throw std::runtime_error("Could not write profile to " + path);
+	fprintf(file, "time,phase,calls,total_ms,max_ms");
+	for (int i = 0; i < PerfCounters::no_counters; i++) {
+		if (profiler.counters.is_supported(i)) fprintf(file, ",%s", PerfCounters::names[i]);
+	}
+	fprintf(file, "\n");
+	for (Profiler::StepRecord& step : profiler.steps) {
+		fprintf(file, "%i,%s,%lld,%g,%g", step.time, profiler.phases[step.phase].path.c_str(), (long long)step.calls, step.total_ns / 1e6, step.max_ns / 1e6);
+		for (int i = 0; i < PerfCounters::no_counters; i++) {
+			if (profiler.counters.is_supported(i)) fprintf(file, ",%lld", (long long)step.counts[i]);
+		}
+		fprintf(file, "\n");
+	}
+	fclose(file);
+}
+
+void write_memory_log(string path, Logger& logger) {
+	// Write the memory metrics that the simulation recorded after every timestep (see Dynamics::log_memory_usage) as one row per timestep.
+	const string prefix = "memory/";
+	vector<string> subsystems;
+	map<int, map<string, double>> rows;
+	for (LogMetric& metric : logger.metrics) {
+		if (metric.name.rfind(prefix, 0) != 0) continue;
+		string subsystem = metric.name.substr(prefix.size());
+		if (find(subsystems.begin(), subsystems.end(), subsystem) == subsystems.end()) subsystems.push_back(subsystem);
+		rows[metric.time][subsystem] = metric.value;
+	}
+	FILE* file = fopen(path.c_str(), "w");
+	if (file == nullptr) throw std::runtime_error("Could not write memory usage to " + path);
+	fprintf(file, "time");
+	for (string& subsystem : subsystems) fprintf(file, ",%s", subsystem.c_str());
+	fprintf(file, "\n");
+	for (auto& [time, values] : rows) {
+		fprintf(file, "%i", time);
+		for (string& subsystem : subsystems) fprintf(file, ",%.0f", values[subsystem]);
+		fprintf(file, "\n");
+	}
+	fclose(file);
+}
+
+void write_ensemble_output(string metrics_path, string summary_path, Ensemble& ensemble, double runtime) {
+	FILE* metrics_file = fopen(metrics_path.c_str(), "w");
+	if (metrics_file == nullptr) throw std::runtime_error("Could not write metrics to " + metrics_path);
+	fprintf(metrics_file, "step,no_replicates");
+	for (string& name : ensemble.metric_names) fprintf(metrics_file, ",%s_mean,%s_variance", name.c_str(), name.c_str());
+	fprintf(metrics_file, "\n");
+	for (int step = 0; step < ensemble.statistics.size(); step++) {
+		fprintf(metrics_file, "%i,%i", step + 1, ensemble.statistics[step][0].count);
+		for (auto& metric : ensemble.statistics[step]) fprintf(metrics_file, ",%g,%g", metric.mean, metric.get_variance());
+		fprintf(metrics_file, "\n");
+	}
+	fclose(metrics_file);
+
+	JsonValue summary;
+	JsonValue replicates;
+	replicates.type = JsonValue::Type::array;
+	for (auto& replicate : ensemble.replicates) {
+		JsonValue entry;
+		entry.set("seed", (double)replicate.seed);
+		entry.set("termination_cause", (replicate.error != "") ? "Error: " + replicate.error : replicate.run_statistics.termination_cause);
+		entry.set("no_steps", replicate.run_statistics.no_steps);
+		entry.set("tree_cover", (double)replicate.run_statistics.tree_cover);
+		entry.set("slope", (double)replicate.run_statistics.slope);
+		replicates.array.push_back(entry);
+	}
+	summary.set("no_replicates", ensemble.no_replicates);
+	summary.set("no_threads", ensemble.no_threads);
+	summary.set("base_seed", (double)ensemble.base_seed);
+	summary.set("replicates", replicates);
+	summary.set("runtime_seconds", runtime);
+	ofstream file(summary_path);
+	if (!file) throw std::runtime_error("Could not write summary to " + summary_path);
+	file << summary.dump() << "\n";
+}
+
+int main(int argc, char** argv) {
+	string config_path = "";
+	string data_in_dir = "../data_in";
+	string metrics_path = "metrics.csv";
+	string summary_path = "summary.json";
+	int no_replicates = 1;
+	int no_threads = 0;
+	string sweep_path = "";
+	string checkpoint_path = "";
+	string resume_path = "";
+	string raster_path = "";
+	string tree_log_path = "";
+	string trace_path = "";
+	string profile_path = "";
+	bool count_events = false;
+	string memory_path = "";
+	vector<pair<string, string>> overrides;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "-h" || arg == "--help") {
+			print_usage();
+			return 0;
+		}
+		bool has_value = (i + 1 < argc);
+		if (arg == "--data_in" && has_value) data_in_dir = argv[++i];
+		else if (arg == "--out" && has_value) metrics_path = argv[++i];
+		else if (arg == "--summary" && has_value) summary_path = argv[++i];
+		else if (arg == "--replicates" && has_value) no_replicates = atoi(argv[++i]);
+		else if (arg == "--threads" && has_value) no_threads = atoi(argv[++i]);
+		else if (arg == "--sweep" && has_value) sweep_path = argv[++i];
+		else if (arg == "--checkpoint" && has_value) checkpoint_path = argv[++i];
+		else if (arg == "--resume" && has_value) resume_path = argv[++i];
+		else if (arg == "--raster" && has_value) raster_path = argv[++i];
+		else if (arg == "--tree_log" && has_value) tree_log_path = argv[++i];
+		else if (arg == "--trace" && has_value) trace_path = argv[++i];
+		else if (arg == "--profile" && has_value) profile_path = argv[++i];
+		else if (arg == "--counters") count_events = true;
+		else if (arg == "--memory" && has_value) memory_path = argv[++i];
+		else if (arg.find('=') != string::npos) overrides.push_back({ arg.substr(0, arg.find('=')), arg.substr(arg.find('=') + 1) });
+		else if (config_path == "" && arg.rfind("--", 0) != 0) config_path = arg;
+		else {
+			printf("Unrecognized argument: %s\n", arg.c_str());
+			print_usage();
+			return 2;
+		}
+	}
+
+	try {
+		SimulationConfig config;
+		if (config_path != "") config = SimulationConfig(config_path, data_in_dir);
+		else config.data_in_dir = data_in_dir;
+		for (auto& [key, value] : overrides) config.set(key, value);
+
+		Timer timer; timer.start();
+		if (sweep_path != "") {
+			Sweep sweep(config, JsonValue::load(sweep_path), no_threads, config.get_int("random_seed"));
+			sweep.run();
+			sweep.write_results(metrics_path);
+			return 0;
+		}
+		if (no_replicates > 1) {
+			Ensemble ensemble(config, no_replicates, no_threads, config.get_int("random_seed"));
+			ensemble.run();
+			timer.stop();
+			write_ensemble_output(metrics_path, summary_path, ensemble, timer.elapsedSeconds());
+			printf("Simulated %i replicates using %i threads.\n", no_replicates, ensemble.no_threads);
+			return 0;
+		}
+		Dynamics dynamics;
+		if (resume_path != "") load_checkpoint(dynamics, resume_path, config.get_string("lookup_table_dir"), config.params.at("shared_lookup_tables").as_bool());
+		else {
+			dynamics = config.create_dynamics();
+			config.init_dynamics(dynamics);
+		}
+		StopConditions conditions = config.get_stop_conditions();
+		dynamics.profiler.enabled = true;
+		dynamics.profiler.tracing = (trace_path != "");
+		dynamics.log_memory_usage = (memory_path != "");
+		dynamics.state.logger.record_metrics = dynamics.log_memory_usage;
+		if (count_events && !dynamics.profiler.enable_counters()) {
+			printf("Hardware performance counters are not available; only the times of the simulation phases are recorded.\n");
+		}
+
+		FILE* metrics_file = fopen(metrics_path.c_str(), "w");
+		if (metrics_file == nullptr) throw std::runtime_error("Could not write metrics to " + metrics_path);
+		bool wrote_header = false;
+		unique_ptr<RasterSeriesWriter> raster_writer;
+		if (raster_path != "") raster_writer = make_unique<RasterSeriesWriter>(raster_path, dynamics.grid->width);
+		unique_ptr<TreeLogWriter> tree_log;
+		if (tree_log_path != "") tree_log = make_unique<TreeLogWriter>(tree_log_path, dynamics);
+		OutputQueue output_queue;
+		auto write_metrics = [&](Dynamics& dynamics) {
+			// The metrics are written on the output queue's thread while the next timestep is simulated.
+			shared_ptr<StepSnapshot> snapshot = make_shared<StepSnapshot>(dynamics);
+			output_queue.push([&, snapshot] {
+				vector<pair<string, float>>& metrics = snapshot->metrics;
+				if (!wrote_header) {
+					for (int i = 0; i < metrics.size(); i++) fprintf(metrics_file, i == 0 ? "%s" : ",%s", metrics[i].first.c_str());
+					fprintf(metrics_file, "\n");
+					wrote_header = true;
+				}
+				for (int i = 0; i < metrics.size(); i++) fprintf(metrics_file, i == 0 ? "%g" : ",%g", metrics[i].second);
+				fprintf(metrics_file, "\n");
+				fflush(metrics_file);
+			});
+			if (raster_writer) raster_writer->add_frame(dynamics);
+			if (tree_log) tree_log->record_step();
+			return true;
+		};
+		int max_steps = (conditions.max_timesteps >= 0) ? conditions.max_timesteps : INT_MAX;
+		string termination_cause = dynamics.run(max_steps, conditions, 1, write_metrics);
+		output_queue.close();
+		fclose(metrics_file);
+		if (raster_writer) raster_writer->close();
+		if (tree_log) tree_log->close();
+		if (trace_path != "") dynamics.profiler.write_chrome_trace(trace_path);
+		if (profile_path != "") write_profile(profile_path, dynamics.profiler);
+		if (memory_path != "") write_memory_log(memory_path, dynamics.state.logger);
+		timer.stop();
+		if (checkpoint_path != "") save_checkpoint(dynamics, checkpoint_path);
+
+		write_summary(summary_path, dynamics, timer.elapsedSeconds());
+		printf("Simulation terminated after %i timesteps. %s\n", dynamics.run_statistics.no_steps, termination_cause.c_str());
+		dynamics.free();
+	}
+	catch (std::exception& error) {
+		printf("Error: %s\n", error.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+
+
+class LZCodec {
+public:
+	// Byte-oriented LZ77 compression in the style of LZ4: a sequence of (literal run, back reference) pairs, each introduced
+	// by a token byte holding the literal length (high nibble) and the match length minus the minimum match length (low nibble).
+	// Lengths that do not fit in a nibble continue in extra bytes of 255 each. Back references are 16-bit offsets; a run of repeated
+	// bytes (e.g. the zeros of an unchanged delta frame) becomes a single back reference of about one byte per 255 bytes.
+	static void compress(const char* input, size_t size, std::vector<char>& output) {
+		output.clear();
+		output.reserve(size / 2 + 16);
+		std::vector<int64_t> table(hash_table_size, -1);
+		size_t literal_begin = 0;
+		size_t position = 0;
+		while (size >= min_match && position + min_match <= size) {
+			uint32_t hash = get_hash(input + position);
+			int64_t candidate = table[hash];
+			table[hash] = position;
+			if (candidate < 0 || position - candidate > max_offset || memcmp(input + candidate, input + position, min_match) != 0) {
+				position++;
+				continue;
+			}
+			size_t length = min_match;
+			while (position + length < size && input[candidate + length] == input[position + length]) length++;
+			write_sequence(input + literal_begin, position - literal_begin, position - candidate, length, output);
+			position += length;
+			literal_begin = position;
+		}
+		write_sequence(input + literal_begin, size - literal_begin, 0, 0, output);
+	}
+	static void decompress(const char* input, size_t size, char* output, size_t output_size) {
+		// <output_size> must equal the size of the uncompressed data. Throws if the input is corrupt.
+		size_t in = 0;
+		size_t out = 0;
+		while (in < size) {
+			uint8_t token = input[in++];
+			size_t literal_length = read_length(token >> 4, input, size, in);
+			if (literal_length > size - in || literal_length > output_size - out) throw std::runtime_error("Corrupt compressed data.");
+			memcpy(output + out, input + in, literal_length);
+			in += literal_length;
+			out += literal_length;
+			if (in == size) break; // The last sequence has no back reference.
+			if (size - in < 2) throw std::runtime_error("Corrupt compressed data.");
+			size_t offset = (uint8_t)input[in] | ((size_t)(uint8_t)input[in + 1] << 8);
+			in += 2;
+			size_t match_length = read_length(token & 15, input, size, in) + min_match;
+			if (offset == 0 || offset > out || match_length > output_size - out) throw std::runtime_error("Corrupt compressed data.");
+			for (size_t i = 0; i < match_length; i++, out++) output[out] = output[out - offset]; // Byte by byte, as the ranges may overlap.
+		}
+		if (out != output_size) throw std::runtime_error("Corrupt compressed data.");
+	}
+
+private:
+	static const size_t min_match = 4;
+	static const size_t max_offset = 65535;
+	static const size_t hash_table_size = 1 << 16;
+	static uint32_t get_hash(const char* bytes) {
+		uint32_t value;
+		memcpy(&value, bytes, sizeof(value));
+		return (value * 2654435761u) >> 16;
+	}
+	static void write_length(size_t length, std::vector<char>& output) {
+		for (; length >= 255; length -= 255) output.push_back((char)255);
+		output.push_back((char)length);
+	}
+	static size_t read_length(size_t length, const char* input, size_t size, size_t& in) {
+		if (length < 15) return length;
+		while (true) {
+			if (in >= size) throw std::runtime_error("Corrupt compressed data.");
+			uint8_t extra = input[in++];
+			length += extra;
+			if (extra < 255) return length;
+		}
+	}
+	static void write_sequence(const char* literals, size_t literal_length, size_t offset, size_t match_length, std::vector<char>& output) {
+		size_t match_code = (match_length > 0) ? match_length - min_match : 0;
+		output.push_back((char)((std::min<size_t>(literal_length, 15) << 4) | std::min<size_t>(match_code, 15)));
+		if (literal_length >= 15) write_length(literal_length - 15, output);
+		output.insert(output.end(), literals, literals + literal_length);
+		if (match_length == 0) return;
+		output.push_back((char)(offset & 255));
+		output.push_back((char)(offset >> 8));
+		if (match_code >= 15) write_length(match_code - 15, output);
+	}
+};
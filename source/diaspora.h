@@ -6,13 +6,13 @@
 class Seed {
 public:
 	Seed() = default;
-	Seed(Strategy &_strategy
+	Seed(int _strategy, int _parent_id
 	) :
-		strategy(_strategy)
+		strategy(_strategy), parent_id(_parent_id)
 	{};
-	Seed(Strategy &_strategy, pair<float, float> _deposition_location
+	Seed(int _strategy, int _parent_id, pair<float, float> _deposition_location
 	) :
-		strategy(_strategy), deposition_location(_deposition_location)
+		strategy(_strategy), parent_id(_parent_id), deposition_location(_deposition_location)
 	{};
 	bool germinate_if_location_is_viable(
 		State* state, int& no_seedlings_dead_due_to_shade, int& no_seedling_competitions, int& no_competitions_with_older_trees,
@@ -20,10 +20,11 @@ public:
 	) {
 		Cell* cell = state->grid.get_cell_at_position(deposition_location);
 		no_germination_attempts++;
-		if (cell->is_hospitable(pair<float, int>(strategy.seedling_dbh, strategy.id), no_seedlings_dead_due_to_shade, no_seedling_competitions,
+		float seedling_dbh = state->population.strategies.get(strategy)->seedling_dbh;
+		if (cell->is_hospitable(pair<float, int>(seedling_dbh, parent_id), no_seedlings_dead_due_to_shade, no_seedling_competitions,
 			no_competitions_with_older_trees, no_cases_seedling_competition_and_shading, no_cases_oldstem_competition_and_shading)
 		) {
-			germinate(cell, state);
+			germinate(cell, seedling_dbh, state);
 			return true;
 		}
 		return false;
@@ -31,12 +32,13 @@ public:
 	void set_deposition_location(pair<float, float> _deposition_location) {
 		deposition_location = _deposition_location;
 	}
-	Strategy strategy;
+	int strategy = -1; // Handle in the population's strategy pool.
+	int parent_id = -1;
 	pair<float, float> deposition_location;
 private:
-	void germinate(Cell* cell, State* state) {
-		cell->set_stem(strategy.seedling_dbh, strategy.id);
-		cell->seedling_present = true;
+	void germinate(Cell* cell, float seedling_dbh, State* state) {
+		cell->set_stem(seedling_dbh, parent_id);
+		state->grid.add_seedling(cell);
 	}
 };
 
@@ -44,82 +46,117 @@ private:
 class Fruit {
 public:
 	Fruit() = default;
-	Fruit(Strategy &_strategy, int _id) : strategy(_strategy), id(_id) {};
-	void get_seeds(vector<Seed>& seeds) {
-		for (int i = 0; i < strategy.no_seeds_per_diaspore; i++) {
-			Seed seed(strategy);
+	Fruit(int _strategy, int _id) : strategy(_strategy), id(_id) {};
+	void get_seeds(vector<Seed>& seeds, Strategy& traits) {
+		for (int i = 0; i < traits.no_seeds_per_diaspore; i++) {
+			Seed seed(strategy, id);
 			seeds.push_back(seed);
 		}
 	}
-	Strategy strategy;
+	int strategy = -1; // Handle in the population's strategy pool.
 	int id = -1;
 };
 
 
 class Fruits {
 public:
+	// Fruit stock of a resource cell. Each crop occupies one slot in a compact array of (fruit, remaining count) entries, and a
+	// Fenwick tree over the counts allows abundance-weighted extraction in O(log n). Clearing only resets the counters, so that
+	// the stocks can be refilled every timestep without reallocating.
 	Fruits() = default;
 	void add_fruits(Crop* crop, float abundance) {
-		//printf("Fruit abundance: %d, no diaspora to disperse: %d\n", crop->fruit_abundance, crop->no_diaspora);
-		fruits[crop->id] = pair<Fruit, int>(Fruit(crop->strategy, crop->id), crop->fruit_abundance);
-		//printf("fruits with crop id %d added, fruit id: %i\n", crop->id, fruits[crop->id].first.id);
-		if (!help::is_in(&fruit_types, crop->id)) fruit_types.push_back(crop->id);
-		_no_fruits += crop->fruit_abundance;
+		// A crop is added once per resource cell its tree occupies (see ResourceGrid::assign_trees_and_fruits()); adding it again
+		// only resets its count.
+		int slot = find_slot(crop->id);
+		if (slot == -1) {
+			slot = _size++;
+			if (slot == types.size()) {
+				types.push_back(Fruit());
+				counts.push_back(0);
+				fenwick.push_back(0);
+			}
+			types[slot] = Fruit(crop->strategy, crop->id);
+			counts[slot] = 0;
+			fenwick[slot] = get_prefix_sum(slot) - get_prefix_sum(slot + 1 - lowest_bit(slot + 1)); // Sum of the counts covered by this node, excluding its own.
+			slots[crop->id] = slot;
+		}
+		update(slot, crop->fruit_abundance - counts[slot]);
 	}
 	bool are_available() {
 		return _no_fruits > 0;
 	}
 	void clear() {
-		if (!fruits.empty()) fruits.clear();
-		if (!fruit_types.empty()) fruit_types.clear();
+		if (slots.size() > 2 * _size + 16) slots.clear(); // Stale slot entries are ignored, but prevent them from accumulating.
+		_size = 0;
 		_no_fruits = 0;
 	}
 	bool get(Fruit &fruit, int tree_id = -1) {
 		if (_no_fruits == 0) return false;
 
-		// Select fruit type randomly
-		int fruit_type;
+		// Select the fruit of the given tree, or otherwise a random fruit weighted by abundance.
+		int slot;
 		if (tree_id != -1) {
-			fruit_type = tree_id;
+			slot = find_slot(tree_id);
+			if (slot == -1 || counts[slot] == 0) return false;
 		}
-		else fruit_type = fruit_types[help::get_rand_int(0, fruit_types.size() - 1)];
-		
-		// Extract fruit
-		fruit = fruits[fruit_type].first;
-		if (fruit.id == -1) {
-			//printf("---------------------------------------------- Error: fruit id is -1\n\n\n\n\n\n");
-			return false;
-			for (int i = 0; i < fruit_types.size(); i++) {
-				printf("Fruit type: %d\n", fruit_types[i]);
-			}
+		else {
+			// Uniform over the fruits (get_rand_int() rounds, which halves the odds of the first and last one).
+			int fruit_idx = min((int)(help::get_rand_double(0, 1) * _no_fruits), _no_fruits - 1);
+			slot = find_by_prefix_sum(fruit_idx);
 		}
-		decrement_one(fruit_type);
 
+		// Extract fruit
+		fruit = types[slot];
+		update(slot, -1);
 		return true;
 	}
-	void decrement_one(int fruit_type) {
-		fruits[fruit_type].second--;
-		_no_fruits--;
-		if (fruits[fruit_type].second == 0) {
-			fruits.erase(fruit_type);
-			fruit_types.erase(find(fruit_types.begin(), fruit_types.end(), fruit_type));
-			//printf("\n\n\n\n\n\n Erasing fruit type %i.\n", fruit_type);
-		}
-	}
 	int no_fruits() {
 		return _no_fruits;
 	}
-	/*int size() {
-		int _no_fruits = 0;
-		for (auto [type, fruit] : fruits) {
-			_no_fruits += fruit.second;
-		}
-		return _no_fruits;
-	}*/
-	map<int, pair<Fruit, int>> fruits;
-	vector<int> fruit_types;
+	size_t get_memory_size() const {
+		return help::get_memory_size(types) + help::get_memory_size(counts) + help::get_memory_size(fenwick) + help::get_memory_size(slots);
+	}
 	Population* population;
 private:
-	int _no_fruits;
+	static int lowest_bit(int i) {
+		return i & (-i);
+	}
+	int find_slot(int crop_id) {
+		auto it = slots.find(crop_id);
+		if (it == slots.end()) return -1;
+		int slot = it->second;
+		if (slot >= _size || types[slot].id != crop_id) return -1;
+		return slot;
+	}
+	void update(int slot, int delta) {
+		counts[slot] += delta;
+		_no_fruits += delta;
+		for (int i = slot + 1; i <= _size; i += lowest_bit(i)) fenwick[i - 1] += delta;
+	}
+	int get_prefix_sum(int no_slots) {
+		// Returns the sum of the counts of the first <no_slots> slots.
+		int sum = 0;
+		for (int i = no_slots; i > 0; i -= lowest_bit(i)) sum += fenwick[i - 1];
+		return sum;
+	}
+	int find_by_prefix_sum(int target) {
+		// Returns the slot in which the fruit with (zero-based) rank <target> resides.
+		int pos = 0;
+		int step = 1;
+		while (step * 2 <= _size) step *= 2;
+		for (; step > 0; step /= 2) {
+			if (pos + step <= _size && fenwick[pos + step - 1] <= target) {
+				pos += step;
+				target -= fenwick[pos - 1];
+			}
+		}
+		return pos;
+	}
+	vector<Fruit> types;
+	vector<int> counts;
+	vector<int> fenwick;
+	unordered_map<int, int> slots; // Crop id -> slot. Entries may be stale after clear(), see find_slot().
+	int _size = 0;
+	int _no_fruits = 0;
 };
 
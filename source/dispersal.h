@@ -6,27 +6,12 @@
 class Disperser {
 public:
 	Disperser() = default;
-	virtual float get_dist(Kernel* kernel) {
-		return kernel->get_ld_dist();
-	}
-	virtual void get_direction(Kernel* kernel, pair<float, float> &direction) {
-		return get_random_unit_vector(direction);
-	}
-	void compute_deposition_location(Crop* crop, State* state, pair<float, float> &deposition_location) {
-		Kernel* kernel = state->population.get_kernel(crop->id);
-		pair<float, float> direction;
-		get_direction(kernel, direction);
-		float distance = get_dist(kernel);
-		//pair<float, float> release_location = state->grid.get_random_position_within_crown(state->population.get(crop->id));
-		pair<float, float> release_location = state->population.get(crop->id)->position;
-		deposition_location = release_location + distance * direction;
-	}
 	bool germinate_seed(
 		Crop* crop, State* state, pair<float, float>& deposition_location, int& no_seedlings_dead_due_to_shade, int& no_seedling_competitions,
 		int& no_competitions_with_older_trees, int& no_germination_attempts, int& no_cases_seedling_competition_and_shading, int& no_cases_oldstem_competition_and_shading
 	) {
 		// Create seed and germinate if location has suitable conditions (existing LAI not too high).
-		Seed seed(crop->strategy, deposition_location);
+		Seed seed(crop->strategy, crop->id, deposition_location);
 		return seed.germinate_if_location_is_viable(
 			state, no_seedlings_dead_due_to_shade, no_seedling_competitions, no_competitions_with_older_trees, no_germination_attempts,
 			no_cases_seedling_competition_and_shading, no_cases_oldstem_competition_and_shading
@@ -37,19 +22,51 @@ public:
 		int& no_seedlings_dead_due_to_shade, int& no_seedling_competitions, int& no_competitions_with_older_trees, int& no_germination_attempts,
 		int& no_cases_seedling_competition_and_shading, int& no_cases_oldstem_competition_and_shading
 	) {
-		for (int i = 0; i < crop->strategy.no_seeds_per_diaspore; i++) {
+		int no_seeds_per_diaspore = state->population.get_strategy(crop)->no_seeds_per_diaspore;
+		for (int i = 0; i < no_seeds_per_diaspore; i++) {
 			no_recruits += germinate_seed(
 				crop, state, deposition_location, no_seedlings_dead_due_to_shade, no_seedling_competitions, no_competitions_with_older_trees, no_germination_attempts,
 				no_cases_seedling_competition_and_shading, no_cases_oldstem_competition_and_shading
 			);
 		}
 	}
-	pair<int, int> disperse_diaspore(
-		Crop* crop, State* state, int& no_recruits, int& no_seedlings_dead_due_to_shade, int& no_seedling_competitions, int& no_competitions_with_older_trees,
+};
+
+
+template <DispersalVector dispersal_vector>
+class KernelDispersal : public Disperser {
+	// Kernel-based dispersal. The kernel payload and direction model are resolved at compile time, so each
+	// dispersal vector gets its own instantiation of the per-diaspore loop.
+public:
+	KernelDispersal() : Disperser() {};
+	float get_dist(Kernel* kernel) {
+		if constexpr (dispersal_vector == DispersalVector::wind) return kernel->get_wind_dispersed_dist();
+		else return kernel->get_ld_dist();
+	}
+	void get_direction(Kernel* kernel, pair<float, float> &direction) {
+		if constexpr (dispersal_vector == DispersalVector::wind) {
+			WindKernel& wind_kernel = kernel->wind();
+			if (wind_kernel.wind_direction_stdev < 360) get_normal_distributed_direction(direction, wind_kernel.wind_direction, wind_kernel.wind_direction_stdev);
+			else {
+				get_random_unit_vector(direction);
+			}
+		}
+		else get_random_unit_vector(direction);
+	}
+	void compute_deposition_location(Crop* crop, Kernel* kernel, pair<float, float> &deposition_location) {
+		pair<float, float> direction;
+		get_direction(kernel, direction);
+		float distance = get_dist(kernel);
+		//pair<float, float> release_location = state->grid.get_random_position_within_crown(state->population.get(crop->id));
+		pair<float, float> release_location = crop->origin;
+		deposition_location = release_location + distance * direction;
+	}
+	pair<float, float> disperse_diaspore(
+		Crop* crop, Kernel* kernel, State* state, int& no_recruits, int& no_seedlings_dead_due_to_shade, int& no_seedling_competitions, int& no_competitions_with_older_trees,
 		int& no_germination_attempts, int& no_cases_seedling_competition_and_shading, int& no_cases_oldstem_competition_and_shading
 	) {
 		pair<float, float> deposition_location;
-		compute_deposition_location(crop, state, deposition_location);
+		compute_deposition_location(crop, kernel, deposition_location);
 		germinate_seeds_in_diaspore(
 			crop, state, deposition_location, no_recruits, no_seedlings_dead_due_to_shade, no_seedling_competitions, no_competitions_with_older_trees, no_germination_attempts,
 			no_cases_seedling_competition_and_shading, no_cases_oldstem_competition_and_shading
@@ -60,9 +77,10 @@ public:
 		Crop* crop, State* state, int& no_seedlings_dead_due_to_shade, int& no_seedling_competitions, int& no_competitions_with_older_trees, int& no_germination_attempts,
 		int& no_cases_seedling_competition_and_shading, int& no_cases_oldstem_competition_and_shading, int& enforce_no_recruits, int& no_recruits
 	) {
+		Kernel* kernel = state->population.get_kernel(crop->id);
 		for (int i = 0; i < crop->no_diaspora; i++) {
 			disperse_diaspore(
-				crop, state, no_recruits, no_seedlings_dead_due_to_shade, no_seedling_competitions, no_competitions_with_older_trees, no_germination_attempts,
+				crop, kernel, state, no_recruits, no_seedlings_dead_due_to_shade, no_seedling_competitions, no_competitions_with_older_trees, no_germination_attempts,
 				no_cases_seedling_competition_and_shading, no_cases_oldstem_competition_and_shading
 			);
 		}
@@ -70,20 +88,8 @@ public:
 	}
 };
 
-
-class WindDispersal : public Disperser {
-public:
-	WindDispersal() : Disperser() {};
-	void get_direction(Kernel* kernel, pair<float, float>& direction) {
-		if (kernel->wind_direction_stdev < 360) get_normal_distributed_direction(direction, kernel->wind_direction, kernel->wind_direction_stdev);
-		else {
-			get_random_unit_vector(direction);
-		}
-	}
-	float get_dist(Kernel* kernel) {
-		return kernel->get_wind_dispersed_dist();
-	}
-};
+typedef KernelDispersal<DispersalVector::linear> LinearDispersal;
+typedef KernelDispersal<DispersalVector::wind> WindDispersal;
 
 
 class AnimalDispersal : public Disperser {
@@ -1,5 +1,29 @@
 #pragma once
 #include "dispersal.h"
+#include "tree_events.h"
+#include "profiler.h"
+#include <functional>
+
+
+class StopConditions {
+public:
+	// Native counterparts of the termination criteria in app.py.
+	int max_timesteps = -1; // Stop once this time is reached (-1 = no limit).
+	float max_tree_cover = 0.93f; // Stop once the tree cover exceeds this value (> 1 = disabled).
+	float initial_tree_cover = 0; // Reference cover for the tree cover slope.
+};
+
+
+class RunStatistics {
+public:
+	// Tree cover trajectory statistics, tracked in the same way as in app.py's update loop.
+	float tree_cover = 0;
+	float slope = 0; // Mean change in tree cover per timestep since the start (0 during the first 10 timesteps).
+	float largest_absolute_slope = 0; // Largest absolute single-timestep change in tree cover (after the first 10 timesteps).
+	int initial_no_dispersals = 0;
+	int no_steps = 0; // Number of timesteps simulated by the last call to Dynamics::run().
+	string termination_cause = "";
+};
 
 
 class Dynamics {
@@ -25,15 +49,18 @@ public:
 		animal_group_size(_animal_group_size)
 	{
 		time = 0;
+		state.logger.level = get_log_level(verbosity);
 		help::init_RNG(random_seed);
 		random_generator = default_random_engine(firefreq_random_seed);
 	};
 	void init_state(int gridsize, float dbh_q1, float dbh_q2, float growth_multiplier_stdev, float growth_multiplier_min, float growth_multiplier_max) {
+		Logger logger = state.logger; // Keep the logging settings.
 		state = State(
 			gridsize, cell_width, max_dbh, dbh_q1, dbh_q2, seed_bearing_threshold, saturation_threshold, strategy_distribution_params,
 			mutation_rate, growth_multiplier_stdev, growth_multiplier_min, growth_multiplier_max
 		);
-		linear_disperser = Disperser();
+		state.logger = logger;
+		linear_disperser = LinearDispersal();
 		wind_disperser = WindDispersal();
 		animal_dispersal = AnimalDispersal();
 		neighbor_offsets = state.grid.neighbor_offsets;
@@ -42,6 +69,21 @@ public:
 		fire_free_interval_averages = make_shared<float[]>(grid->no_cells);
 		for (int i = 0; i < grid->no_cells; i++) fire_free_interval_averages[i] = 0;
 	}
+	void fork(Dynamics& branch) {
+		// Make <branch> an independent copy of this simulation, e.g. to simulate alternative scenarios from the current state.
+		// Data that is never modified in place is shared rather than copied: the resource grid distance lookup tables, the
+		// neighbor offsets, and the wind kernel cdfs (a kernel that is rebuilt gets a new cdf, see WindKernel::update()).
+		// The branch continues from copies of all generator states, but draws from the same global random stream as this
+		// simulation (see help::set_thread_RNG() to give each branch its own).
+		branch = Dynamics(*this);
+		branch.state.grid = state.grid.copy();
+		branch.pop = &branch.state.population;
+		branch.grid = &branch.state.grid;
+		branch.fire_free_interval_averages = help::copy_array(fire_free_interval_averages, grid->no_cells);
+		branch.resource_grid = resource_grid.copy(&branch.state);
+		branch.tree_events = TreeEventRecorder(); // Events are only recorded for simulations that have a tree log attached.
+		branch.state.logger.clear(); // The branch keeps the logging settings but starts with an empty log.
+	}
 	bool invalid_tree_ids() {
 		for (auto& [id, tree] : pop->members) {
 			if (id == -1 || tree.id == -1) {
@@ -54,46 +96,126 @@ public:
 	void update() {
 		// Prepare next iteration
 		time++;
-		printf("\nTime: %i\n", time);
-		if (verbosity > 0) printf("Resetting state distr... \n");
+		profiler.begin_step(time);
+		state.logger.time = time;
+		DBR_LOG(state.logger, LogLevel::info, "\nTime: %i\n", time);
+		DBR_LOG(state.logger, LogLevel::debug, "Resetting state distr... \n");
 		grid->reset_state_distr();
 
 		// Do simulation
 		Timer timer; timer.start();
-		if (verbosity > 0) printf("Beginning dispersal... \n");
+		DBR_LOG(state.logger, LogLevel::debug, "Beginning dispersal... \n");
 		if (time > 0) disperse();
 
 		timer.stop();
-		if (verbosity > 0) printf("Dispersal took %f seconds. Beginning burn... \n", timer.elapsedSeconds());
+		DBR_LOG(state.logger, LogLevel::debug, "Dispersal took %f seconds. Beginning burn... \n", timer.elapsedSeconds());
 		timer.start();
 		burn();
 		timer.stop();
 
-		if (verbosity > 0) printf("Burns took %f seconds. Beginning growth... \n", timer.elapsedSeconds());
+		DBR_LOG(state.logger, LogLevel::debug, "Burns took %f seconds. Beginning growth... \n", timer.elapsedSeconds());
 		timer.start();
 		grow();
 		timer.stop();
-		if (verbosity > 0) printf("Growth took %f seconds.\n", timer.elapsedSeconds());
+		DBR_LOG(state.logger, LogLevel::debug, "Growth took %f seconds.\n", timer.elapsedSeconds());
 		induce_background_mortality();
-		if (verbosity > 0) printf("Induced background mortality. Repopulating grid...\n");
+		DBR_LOG(state.logger, LogLevel::debug, "Induced background mortality. Repopulating grid...\n");
 
 		// Do post-simulation cleanup and data reporting
-		state.repopulate_grid(verbosity);
-		if (verbosity > 1) printf("Redoing grid count... \n");
-		grid->redo_count();
+		{
+			ScopedPhase phase(profiler, "repopulate");
+			state.repopulate_grid(verbosity);
+			DBR_LOG(state.logger, LogLevel::trace, "Redoing grid count... \n");
+			grid->redo_count();
+		}
 		report_state();
 
 		update_firefree_interval_averages();
+		profiler.end_step();
+		state.logger.flush();
+	}
+	string run(int max_steps, StopConditions& conditions, int observer_every = 0, function<bool(Dynamics&)> observer = nullptr) {
+		// Simulate up to <max_steps> timesteps, or until one of the stop conditions is met. If given, <observer> is called
+		// every <observer_every> timesteps (and after the last one); it can end the run early by returning false.
+		// Returns the termination cause (empty if <max_steps> was reached without meeting a stop condition).
+		run_statistics.no_steps = 0;
+		run_statistics.termination_cause = "";
+		for (int step = 0; step < max_steps; step++) {
+			update();
+			run_statistics.no_steps++;
+			track_run_statistics(conditions);
+			bool terminate = stop_condition_met(conditions);
+			if (observer && observer_every > 0 && (run_statistics.no_steps % observer_every == 0 || terminate || step == max_steps - 1)) {
+				if (!observer(*this) && !terminate) {
+					run_statistics.termination_cause = "Stopped by observer.";
+					terminate = true;
+				}
+			}
+			if (terminate) break;
+		}
+		return run_statistics.termination_cause;
+	}
+	void track_run_statistics(StopConditions& conditions) {
+		float prev_tree_cover = (time == 1) ? conditions.initial_tree_cover : run_statistics.tree_cover;
+		run_statistics.tree_cover = grid->get_tree_cover();
+		if (time == 1) run_statistics.initial_no_dispersals = initial_no_effective_dispersals;
+		if (time > 10) {
+			run_statistics.slope = (run_statistics.tree_cover - conditions.initial_tree_cover) / (float)time;
+			run_statistics.largest_absolute_slope = max(run_statistics.largest_absolute_slope, abs(run_statistics.tree_cover - prev_tree_cover));
+		}
+		else run_statistics.slope = 0;
+	}
+	bool stop_condition_met(StopConditions& conditions) {
+		char cause[128] = "";
+		if (conditions.max_timesteps >= 0 && time >= conditions.max_timesteps) {
+			snprintf(cause, sizeof(cause), "Maximum number of timesteps (%i) reached.", conditions.max_timesteps);
+		}
+		if (run_statistics.tree_cover > conditions.max_tree_cover) {
+			snprintf(cause, sizeof(cause), "Tree cover exceeds %i%%.", (int)round(conditions.max_tree_cover * 100.0f));
+		}
+		run_statistics.termination_cause = cause;
+		return run_statistics.termination_cause.size() > 0;
+	}
+	vector<pair<string, float>> get_metrics() {
+		// Per-timestep summary statistics, in a fixed order (used by the native drivers for output and aggregation).
+		return {
+			{"time", (float)time}, {"tree_cover", grid->get_tree_cover()}, {"slope", run_statistics.slope},
+			{"population_size", (float)pop->size()}, {"seeds_produced", (float)seeds_produced}, {"no_fires", (float)fires.size()},
+			{"fire_induced_deaths", (float)no_fire_induced_deaths}, {"fire_induced_topkills", (float)no_fire_induced_topkills},
+			{"fire_induced_nonseedling_topkills", (float)no_fire_induced_nonseedling_topkills}, {"recruits", (float)no_recruits},
+			{"germination_attempts", (float)no_germination_attempts}, {"fraction_time_spent_moving", fraction_time_spent_moving}
+		};
+	}
+	vector<pair<string, size_t>> get_memory_usage() {
+		// Approximate heap memory per subsystem, in bytes, in a fixed order. Container sizes are estimated from their element counts
+		// and capacities (see help::get_memory_size()), so allocator overhead is not included. The resource grid lookup tables may be
+		// shared with other simulations in the same process or mapped from a file (see LookupTableCache).
+		size_t diagnostics_size = help::get_memory_size(tree_events.events) + help::get_memory_size(profiler.steps) +
+			help::get_memory_size(profiler.trace) + state.logger.get_memory_size();
+		return {
+			{"population/trees", pop->get_tree_memory_size()}, {"population/crops", pop->get_crop_memory_size()},
+			{"population/kernels", pop->get_kernel_memory_size()}, {"population/strategies", pop->strategies.get_memory_size()},
+			{"grid/cells", grid->get_cell_memory_size()},
+			{"grid/layers", grid->get_layer_memory_size() + (fire_free_interval_averages ? grid->no_cells * sizeof(float) : 0)},
+			{"resource_grid/cells", resource_grid.get_cell_memory_size()}, {"resource_grid/tables", resource_grid.get_table_memory_size()},
+			{"resource_grid/lookup_tables", resource_grid.get_lookup_table_memory_size()},
+			{"animals", animal_dispersal.animals.get_memory_size()}, {"diagnostics", diagnostics_size}
+		};
 	}
 	void report_state() {
-		int grid_memory_size = 0;
-		for (int i = 0; i < grid->no_cells; i++) {
-			int element_size = grid->distribution[i].trees.capacity();
-			grid_memory_size += element_size;
+		ScopedPhase phase(profiler, "report");
+		if (log_memory_usage) {
+			size_t total = 0;
+			for (auto& [subsystem, bytes] : get_memory_usage()) {
+				state.logger.metric("memory/" + subsystem, bytes);
+				total += bytes;
+			}
+			DBR_LOG(state.logger, LogLevel::debug, "-- Memory in use: %.1f MB (peak resident: %.1f MB)\n", total / 1e6, help::get_peak_memory_usage() / 1e6);
+		}
+		DBR_LOG(state.logger, LogLevel::info, "Tree cover: %f, Number of trees: %s \n", grid->get_tree_cover(), help::readable_number(pop->size()).c_str());
+		if (state.logger.is_enabled(LogLevel::trace)) {
+			for (auto& [id, tree] : pop->members) if (id % 500 == 0) DBR_LOG(state.logger, LogLevel::trace, "Radius of tree %i : %f \n", id, tree.radius);
 		}
-
-		printf("Tree cover: %f, Number of trees: %s \n", grid->get_tree_cover(), help::readable_number(pop->size()).c_str());
-		if (verbosity == 2) for (auto& [id, tree] : pop->members) if (id % 500 == 0) printf("Radius of tree %i : %f \n", id, tree.radius);
 	}
 	void free() {
 		pop->free();
@@ -108,38 +230,48 @@ public:
 		}
 	}
 	void grow() {
+		ScopedPhase phase(profiler, "grow");
 		vector<int> tree_deletion_schedule = {};
 		map<float, int> increment_counts;
 		for (auto& [id, tree] : pop->members) {
-			float shade = state.compute_shade_on_individual_tree(&tree);
+			float shade;
+			{
+				ScopedPhase shade_phase(profiler, "shade", false);
+				shade = state.compute_shade_on_individual_tree(&tree);
+			}
 			tree.shade = shade;
 			auto [became_reproductive, dies_due_to_light_limitation] = tree.grow(seed_bearing_threshold, shade);
 			if (dies_due_to_light_limitation) {
+				tree_events.record(time, TreeEventType::light_limitation_death, tree, pop);
 				tree_deletion_schedule.push_back(id);
 			}
 		}
 		for (int id : tree_deletion_schedule) {
 			pop->remove(id);
 		}
-		printf("-- No trees dead due to light limitation: %i \n", tree_deletion_schedule.size());
+		state.logger.metric("light_limitation_deaths", tree_deletion_schedule.size());
+		DBR_LOG(state.logger, LogLevel::info, "-- No trees dead due to light limitation: %i \n", (int)tree_deletion_schedule.size());
 	}
 	void set_global_linear_kernel(float lin_diffuse_q1, float lin_diffuse_q2, float min, float max) {
-		global_kernels["linear"] = Kernel(1, lin_diffuse_q1, lin_diffuse_q2, min, max);
-		pop->add_kernel("linear", global_kernels["linear"]);
-		cout << "Global kernel created (Linear diffusion). " << endl;
+		global_kernels[DispersalVector::linear] = Kernel(1, lin_diffuse_q1, lin_diffuse_q2, min, max);
+		pop->add_kernel(DispersalVector::linear, global_kernels[DispersalVector::linear]);
+		DBR_LOG(state.logger, LogLevel::info, "Global kernel created (Linear diffusion). \n");
+		state.logger.flush();
 	}
 	void set_global_wind_kernel(float wspeed_gmean, float wspeed_stdev, float wind_direction, float wind_direction_stdev) {
-		global_kernels["wind"] = Kernel(1, grid->width_r * 2.0f, wspeed_gmean, wspeed_stdev, wind_direction, wind_direction_stdev);
-		pop->add_kernel("wind", global_kernels["wind"]);
-		cout << "Global kernel created (Wind dispersal). " << endl;
+		global_kernels[DispersalVector::wind] = Kernel(1, grid->width_r * 2.0f, wspeed_gmean, wspeed_stdev, wind_direction, wind_direction_stdev);
+		pop->add_kernel(DispersalVector::wind, global_kernels[DispersalVector::wind]);
+		DBR_LOG(state.logger, LogLevel::info, "Global kernel created (Wind dispersal). \n");
+		state.logger.flush();
 	}
 	void set_global_animal_kernel(map<string, map<string, float>>& animal_kernel_params) {
-		global_kernels["animal"] = Kernel(1, "animal");
+		global_kernels[DispersalVector::animal] = Kernel(1, DispersalVector::animal);
 		init_resource_grid(animal_kernel_params);
 		animal_dispersal.animals = Animals(& state, animal_kernel_params, animal_group_size);
 		animal_dispersal.animals.initialize_population();
-		pop->add_kernel("animal", global_kernels["animal"]);
-		cout << "Global kernel created (Dispersal by animals). \n";
+		pop->add_kernel(DispersalVector::animal, global_kernels[DispersalVector::animal]);
+		DBR_LOG(state.logger, LogLevel::info, "Global kernel created (Dispersal by animals). \n");
+		state.logger.flush();
 	}
 	void set_global_kernels(map<string, map<string, float>> nonanimal_kernel_params, map<string, map<string, float>> animal_kernel_params) {
 		map<string, float> params;
@@ -153,113 +285,138 @@ public:
 		float resource_grid_cell_width = grid->width_r / (float)resource_grid_width;
 		vector<string> species = {};
 		for (auto& [_species, _] : animal_kernel_params) species.push_back(_species);
-		if (resource_grid.selection_probabilities.probabilities != nullptr) printf("not nullptr");
+		if (resource_grid.selection_probabilities.probabilities != nullptr) DBR_LOG(state.logger, LogLevel::debug, "not nullptr");
 		resource_grid = ResourceGrid(&state, resource_grid_width, resource_grid_cell_width, species, animal_kernel_params);
-		printf("resource grid's probmodel obj id: %i \n", resource_grid.selection_probabilities.id);
+		DBR_LOG(state.logger, LogLevel::debug, "resource grid's probmodel obj id: %i \n", resource_grid.selection_probabilities.id);
 	}
-	bool global_kernel_exists(string type) {
+	bool global_kernel_exists(DispersalVector type) {
 		return global_kernels.find(type) != global_kernels.end();
 	}
 	bool ensure_kernel_exists(int id) {
 		if (pop->get_kernel(id)->id == -1) {
-			string tree_dispersal_vector = pop->get_crop(id)->strategy.vector;
+			DispersalVector tree_dispersal_vector = pop->get_strategy(pop->get_crop(id))->vector;
 			if (global_kernel_exists(tree_dispersal_vector))
 				pop->add_kernel(tree_dispersal_vector, global_kernels[tree_dispersal_vector]);
 			else {
-				if (id != -1) printf("No global kernel found for tree dispersal vector '%s'.\n", tree_dispersal_vector.c_str());
+				if (id != -1) DBR_LOG(state.logger, LogLevel::warning, "No global kernel found for tree dispersal vector '%s'.\n", get_vector_name(tree_dispersal_vector).c_str());
 				//exit(1); Let's not exit the program for now
 				return false;
 			}
 		}
 		return true;
 	}
+	template <DispersalVector dispersal_vector>
+	void disperse_crops(KernelDispersal<dispersal_vector>& disperser, vector<pair<Crop*, Tree*>>& bucket, int& seeds_dispersed, int& no_seedlings) {
+		for (auto& [crop, tree] : bucket) {
+			seeds_dispersed += crop->no_seeds;
+			int enforce_no_recruits = -1;
+			if (_enforce_no_recruits >= 0) enforce_no_recruits = (float)crop->no_seeds * _enforce_no_recruits; // Enforce a certain fraction of the number of produced seeds to be recruited.
+			if constexpr (dispersal_vector == DispersalVector::wind) pop->get_kernel(crop->id)->wind().update(tree->height);
+			disperser.disperse_crop(
+				crop, &state, no_seedlings_dead_due_to_shade, no_seedling_competitions, no_competitions_with_older_trees,
+				no_germination_attempts, no_cases_seedling_competition_and_shading, no_cases_oldstem_competition_and_shading,
+				enforce_no_recruits, no_seedlings
+			);
+		}
+	}
 	void disperse_wind_seeds_and_init_fruits(int& no_seed_bearing_trees, int& no_wind_seedlings, int& wind_seeds_dispersed, int& animal_seeds_dispersed, int& wind_trees) {
+		ScopedPhase phase(profiler, "wind");
 		int pre_dispersal_popsize = pop->size();
 		Timer timer; timer.start();
+
+		// Update crops and bucket them by dispersal vector
+		vector<pair<Crop*, Tree*>> linear_crops;
+		vector<pair<Crop*, Tree*>> wind_crops;
+		vector<int> tree_deletion_schedule = {};
 		for (auto& [id, tree] : pop->members) {
 			// Get crop and kernel
 			if (tree.life_phase < 2) continue;
 			no_seed_bearing_trees++;
 			if (id == -1 || tree.id == -1) {
-				pop->remove(id);
+				tree_deletion_schedule.push_back(id);
 				continue;
 			}
 			Crop* crop = pop->get_crop(id);
 			if (crop->id == -1) {
-				pop->remove(id);
+				tree_deletion_schedule.push_back(id);
 				continue;
 			}
 			bool kernel_exists = ensure_kernel_exists(tree.id);
 			if (!kernel_exists) {
-				pop->remove(id);
+				tree_deletion_schedule.push_back(id);
 				continue;
 			}
-			crop->update(tree, STR);
+			crop->update(tree, STR, *pop->get_strategy(crop));
 
-			// Add fruit crop or disperse seeds, depending on dispersal vector type
-			if (pop->get_kernel(id)->type == "animal") {
+			// Add fruit crop or schedule seed dispersal, depending on dispersal vector type
+			DispersalVector type = pop->get_kernel(id)->type;
+			if (type == DispersalVector::animal) {
 				animal_seeds_dispersed += crop->no_seeds;
 				resource_grid.has_fruits = true;
 			}
-			else if (pop->get_kernel(id)->type == "wind") {
-				wind_seeds_dispersed += crop->no_seeds;
-				int enforce_no_recruits = -1;
-				if (_enforce_no_recruits >= 0) enforce_no_recruits = (float)crop->no_seeds * _enforce_no_recruits; // Enforce a certain fraction of the number of produced seeds to be recruited.
-				pop->get_kernel(id)->update(tree.height);
-				wind_disperser.disperse_crop(
-					crop, &state, no_seedlings_dead_due_to_shade, no_seedling_competitions, no_competitions_with_older_trees,
-					no_germination_attempts, no_cases_seedling_competition_and_shading, no_cases_oldstem_competition_and_shading,
-					enforce_no_recruits, no_wind_seedlings
-				);
-				wind_trees++;
-			}
-			else {
-				int enforce_no_recruits = -1;
-				if (_enforce_no_recruits >= 0) enforce_no_recruits = (float)crop->no_seeds * _enforce_no_recruits; // Enforce a certain fraction of the number of produced seeds to be recruited.
-				linear_disperser.disperse_crop(
-					crop, &state, no_seedlings_dead_due_to_shade, no_seedling_competitions, no_competitions_with_older_trees,
-					no_germination_attempts, no_cases_seedling_competition_and_shading, no_cases_oldstem_competition_and_shading,
-					enforce_no_recruits, no_wind_seedlings
-				);
-			}
+			else if (type == DispersalVector::wind) wind_crops.push_back(pair<Crop*, Tree*>(crop, &tree));
+			else linear_crops.push_back(pair<Crop*, Tree*>(crop, &tree));
+		}
+		for (int id : tree_deletion_schedule) {
+			tree_events.record(time, TreeEventType::removal, *pop->get(id), pop);
+			pop->remove(id);
+		}
+
+		// Disperse seeds, one vector at a time
+		int linear_seeds_dispersed = 0;
+		{
+			ScopedPhase phase(profiler, "germination"); // Seed deposition and germination.
+			disperse_crops(wind_disperser, wind_crops, wind_seeds_dispersed, no_wind_seedlings);
+			disperse_crops(linear_disperser, linear_crops, linear_seeds_dispersed, no_wind_seedlings);
 		}
-		timer.stop(); printf(
+		wind_trees += wind_crops.size();
+
+		timer.stop();
+		state.logger.metric("wind_seeds_dispersed", wind_seeds_dispersed);
+		state.logger.metric("fruits", resource_grid.total_no_fruits);
+		DBR_LOG(state.logger, LogLevel::info,
 			"-- Dispersing %s wind-dispersed seeds and initializing %s fruits took %f seconds. \n",
 			help::readable_number(wind_seeds_dispersed).c_str(), help::readable_number(resource_grid.total_no_fruits).c_str(), timer.elapsedSeconds()
 		);
 	}
 	void disperse_animal_seeds(int no_seeds_to_disperse, int& no_recruits) {
+		ScopedPhase phase(profiler, "animal");
 		Timer timer; timer.start();
 		int enforce_no_recruits = -1;
 		if (enforce_no_recruits >= 0) enforce_no_recruits = (float)no_seeds_to_disperse * enforce_no_recruits; // Enforce a certain fraction of the number of produced seeds to be recruited.)
 		if (resource_grid.has_fruits) {
+			animal_dispersal.animals.no_threads = max(1, animal_dispersal_threads);
 			no_recruits = animal_dispersal.disperse(
 				&state, &resource_grid, no_seeds_to_disperse, fraction_time_spent_moving, no_seedlings_dead_due_to_shade, no_seedling_competitions, 
 				no_competitions_with_older_trees, no_germination_attempts, no_cases_seedling_competition_and_shading, no_cases_oldstem_competition_and_shading, 
 				enforce_no_recruits, 1
 			);
 		}
-		timer.stop(); printf("-- Dispersing %s animal seeds took %f seconds. \n", help::readable_number(no_seeds_to_disperse).c_str(), timer.elapsedSeconds());
+		timer.stop();
+		state.logger.metric("animal_seeds_dispersed", no_seeds_to_disperse);
+		DBR_LOG(state.logger, LogLevel::info, "-- Dispersing %s animal seeds took %f seconds. \n", help::readable_number(no_seeds_to_disperse).c_str(), timer.elapsedSeconds());
 	}
 	void recruit() {
+		ScopedPhase phase(profiler, "recruitment");
 		Timer timer; timer.start();
 		int pre_recruitment_popsize = pop->size();
-		for (int i = 0; i < grid->no_cells; i++) {
+		sort(grid->seedling_cells.begin(), grid->seedling_cells.end()); // Recruit in cell order, so that tree ids do not depend on the order of germination.
+		for (int i : grid->seedling_cells) {
 			Cell* cell = &grid->distribution[i];
-			if (cell->seedling_present) {
-				Tree* tree = pop->add(
-					grid->get_real_cell_position(cell),
-					&pop->get_crop(cell->stem.second)->strategy
-				);
-				cell->insert_sapling(tree, grid->cell_area, grid->cell_halfdiagonal_sqrt);
-				grid->state_distribution[i] = -7;
-			}
+			Tree* tree = pop->add(
+				grid->get_real_cell_position(cell),
+				pop->get_crop(cell->stem.second)->strategy
+			);
+			cell->insert_sapling(tree, grid->cell_area, grid->cell_halfdiagonal_sqrt);
+			tree_events.record(time, TreeEventType::recruitment, *tree, pop);
+			grid->set_state_distribution_value(i, -7);
 		}
+		grid->clear_seedlings();
 
 		no_recruits = pop->size() - pre_recruitment_popsize;
 		if (time == 1) initial_no_effective_dispersals = no_recruits; // The number of recruits is really the number of effective dispersals, since some seedlings may be burned right after germinating.
 		timer.stop();
-		printf("-- Recruitment of %s trees took %f seconds. \n", help::readable_number(no_recruits).c_str(), timer.elapsedSeconds());
+		DBR_LOG(state.logger, LogLevel::info, "-- Recruitment of %s trees took %f seconds. \n", help::readable_number(no_recruits).c_str(), timer.elapsedSeconds());
 	}
 	int get_no_recruits(string type) {
 		if (type == "wind") return no_wind_seedlings;
@@ -267,6 +424,7 @@ public:
 		else return (no_recruits);
 	}
 	void disperse() {
+		ScopedPhase phase(profiler, "dispersal");
 		resource_grid.reset();
 		int pre_dispersal_popsize = pop->size();
 		int animal_seeds_dispersed = 0;
@@ -285,25 +443,26 @@ public:
 		disperse_animal_seeds(animal_seeds_dispersed, no_animal_seedlings);
 		recruit();
 
-		if (verbosity > 0) {
-			printf(
-				"-- Fraction of trees that are seed-bearing: %f, #seeds (all): %s\n",
-				(float)no_seed_bearing_trees / (float)pop->size(), help::readable_number(seeds_produced).c_str()
-			);
-		}
-		if (verbosity > 0) printf("-- Proportion wind dispersed trees: %f \n", no_wind_trees / (float)no_seed_bearing_trees);
+		DBR_LOG(state.logger, LogLevel::debug,
+			"-- Fraction of trees that are seed-bearing: %f, #seeds (all): %s\n",
+			(float)no_seed_bearing_trees / (float)pop->size(), help::readable_number(seeds_produced).c_str()
+		);
+		DBR_LOG(state.logger, LogLevel::debug, "-- Proportion wind dispersed trees: %f \n", no_wind_trees / (float)no_seed_bearing_trees);
 	}
 	void induce_background_mortality() {
+		ScopedPhase phase(profiler, "mortality");
 		vector<int> tree_deletion_schedule = {};
 		for (auto& [id, tree] : pop->members) {
 			if (help::get_rand_float(0, 1) < background_mortality) {
+				tree_events.record(time, TreeEventType::background_mortality, tree, pop);
 				tree_deletion_schedule.push_back(id);
 			}
 		}
 		for (int id : tree_deletion_schedule) {
 			pop->remove(id);
 		}
-		printf("-- Number of trees dead due to background mortality: %i \n", tree_deletion_schedule.size());
+		state.logger.metric("background_mortality_deaths", tree_deletion_schedule.size());
+		DBR_LOG(state.logger, LogLevel::info, "-- Number of trees dead due to background mortality: %i \n", (int)tree_deletion_schedule.size());
 	}
 	shared_ptr<int[]> get_resource_grid_colors(string species, string type) {
 		return resource_grid.get_color_distribution(species, type);
@@ -317,7 +476,8 @@ public:
 		return no_fires_distribution(random_generator);
 	}
 	void burn() {
-		if (verbosity == 2) printf("Updated tree flammabilities.\n");
+		ScopedPhase phase(profiler, "burn");
+		DBR_LOG(state.logger, LogLevel::trace, "Updated tree flammabilities.\n");
 		int no_fires = get_no_fires();
 		int no_ash_cells = 0;
 		int popsize_before_burns = pop->size();
@@ -337,17 +497,17 @@ public:
 			fires.push_back((float)_no_ash_cells * grid->cell_area);
 		}
 		no_fire_induced_deaths = popsize_before_burns - pop->size();
-		printf("no fire induced deaths (time = %i): %i \n", time, no_fire_induced_deaths);
-		printf("no fire induced topkills (time = %i): %i \n", time, no_fire_induced_topkills);
-		cout.precision(2);
-		printf(
+		state.logger.metric("ash_cells", no_ash_cells);
+		DBR_LOG(state.logger, LogLevel::info, "no fire induced deaths (time = %i): %i \n", time, no_fire_induced_deaths);
+		DBR_LOG(state.logger, LogLevel::info, "no fire induced topkills (time = %i): %i \n", time, no_fire_induced_topkills);
+		DBR_LOG(state.logger, LogLevel::info,
 			"-- Fires: %i, Topkills: %s, Kills: %s \n",
 			no_fires, help::readable_number(no_fire_induced_topkills).c_str(), help::readable_number(no_fire_induced_deaths).c_str()
 		);
-		cout <<
-			"-- Fraction of domain burned: " << (float)no_ash_cells / (float)grid->no_cells << ", Area burned: " <<
-			scientific << (float)no_ash_cells * grid->cell_area << " / " << grid->area << " m^2 \n";
-		cout << fixed;
+		DBR_LOG(state.logger, LogLevel::info,
+			"-- Fraction of domain burned: %.2f, Area burned: %.2e / %.2e m^2 \n",
+			(float)no_ash_cells / (float)grid->no_cells, (float)no_ash_cells * grid->cell_area, grid->area
+		);
 	}
 	float get_forest_flammability(Cell* cell, bool grass_has_recovered) {
 		float fuel_load = cell->get_fuel_load();
@@ -370,23 +530,26 @@ public:
 		return !tree->survives_fire(fire_resistance_argmin, fire_resistance_argmax, fire_resistance_stretch);
 	}
 	void kill_tree(Tree* tree, float time_last_fire, queue<Cell*>& queue, Cell* cell) {
-		if (verbosity > 1) printf("Burning tree %i ... \n", tree->id);
+		DBR_LOG(state.logger, LogLevel::trace, "Burning tree %i ... \n", tree->id);
 		Cell* stem_cell = grid->burn_tree_domain(tree, queue, time_last_fire, true, true, cell->idx);
 		if (tree->life_phase == 2 || tree->life_phase == 0) {
 			// A tree which has been burned once is allowed to resprout, in line with findings of Hoffmann et al. (2012).
+			tree_events.record(time, TreeEventType::topkill, *tree, pop);
 			tree->resprout(seed_bearing_threshold);
 			stem_cell->resprout_present = true;
 		}
 		else {
 			// Resprouts are not allowed to resprout again, since previous work appears to indicate that forest species are not able to consistently recover from repeated burning (Fensham et al 2003)
+			tree_events.record(time, TreeEventType::fire_death, *tree, pop);
 			bool removed = pop->remove(tree->id);
 			if (!removed) {
-				printf("Tree %i could not be removed from the population. \n", tree->id);
+				DBR_LOG(state.logger, LogLevel::warning, "Tree %i could not be removed from the population. \n", tree->id);
 			}
 		}
 	}
 	void kill_tree(Tree* tree) {
-		if (verbosity == 2) printf("Removing tree %i ... \n", tree->id);
+		DBR_LOG(state.logger, LogLevel::trace, "Removing tree %i ... \n", tree->id);
+		tree_events.record(time, TreeEventType::removal, *tree, pop);
 		grid->kill_tree_domain(tree, false);
 		pop->remove(tree);
 	}
@@ -420,16 +583,17 @@ public:
 	}
 	inline void burn_cell(Cell* cell, float t_start, queue<Cell*>& queue, int& no_trees_topkilled, int& no_fire_induced_nonseedling_topkills) {
 		cell->time_last_fire = t_start;
-		grid->state_distribution[grid->pos_2_idx(cell->pos)] = -5;
+		grid->set_state_distribution_value(cell->idx, -5);
 		induce_tree_mortality(cell, queue, no_trees_topkilled, no_fire_induced_nonseedling_topkills);
 	}
 	pair<int, int> percolate(Cell* cell, float t_start, int& no_trees_topkilled, int& no_fire_induced_nonseedling_topkills) {
+		ScopedPhase phase(profiler, "percolate");
 		std::queue<Cell*> queue;
 		burn_cell(cell, t_start, queue, no_trees_topkilled, no_fire_induced_nonseedling_topkills);
 		queue.push(cell);
 		int no_ash_cells = 1;
 		int no_grassy_ash_cells = 1;
-		if (verbosity == 2) printf("Percolating fire...\n");
+		DBR_LOG(state.logger, LogLevel::trace, "Percolating fire...\n");
 		pop_size = state.population.size();
 		while (!queue.empty()) {
 			Cell* cell = queue.front();
@@ -501,21 +665,29 @@ public:
 	int seeds_produced = 0;
 	int resource_grid_width = 0;
 	int animal_group_size = 0;
+	int animal_dispersal_threads = 1; // Number of threads used for animal dispersal (1 = serial discrete-event simulation).
 	int no_fire_induced_deaths = 0;
 	int no_fire_induced_topkills = 0;
 	int no_fire_induced_nonseedling_topkills = 0;
 	int initial_no_effective_dispersals = 0;
+	RunStatistics run_statistics;
+	TreeEventRecorder tree_events;
+	Profiler profiler;
+	bool log_memory_usage = false; // Record get_memory_usage() in the log's metrics channel (if enabled) after every timestep.
 	State state;
 	Population* pop = 0;
 	Grid* grid = 0;
-	Disperser linear_disperser;
+	LinearDispersal linear_disperser;
 	WindDispersal wind_disperser;
 	AnimalDispersal animal_dispersal;
 	default_random_engine random_generator;
 	ResourceGrid resource_grid;
 	shared_ptr<pair<int, int>[]> neighbor_offsets = 0;
-	map<string, Kernel> global_kernels;
+	map<DispersalVector, Kernel> global_kernels;
 	map<string, map<string, float>> strategy_distribution_params;
 	Animals animals;
+
+private:
+	Dynamics(const Dynamics&) = default; // Shares the grid's cells and the resource grid's arrays; see fork().
 };
 
@@ -0,0 +1,197 @@
+#pragma once
+#include "simulation_config.h"
+
+
+class MetricAccumulator {
+public:
+	// Running mean and variance (Welford's algorithm).
+	void add(double value) {
+		count++;
+		double delta = value - mean;
+		mean += delta / (double)count;
+		m2 += delta * (value - mean);
+	}
+	double get_variance() const {
+		return (count > 1) ? m2 / (double)(count - 1) : 0;
+	}
+	int count = 0;
+	double mean = 0;
+	double m2 = 0;
+};
+
+
+class LookupTableCache {
+public:
+	// Resource grid distance lookup tables shared by the simulations of one process. A table is built (or loaded) by the first
+	// simulation that needs it and referenced read-only by all later simulations with the same table key.
+	void init(ResourceGrid& resource_grid, string species, string cache_dir, bool shared_memory) {
+		std::lock_guard<std::mutex> lock(mutex);
+		uint64_t key = resource_grid.get_lookup_table_key(species);
+		auto cached = tables.find(key);
+		if (cached == tables.end()) {
+			resource_grid.init_dist_lookup_table(species, cache_dir, shared_memory);
+			tables[key] = pair<const float*, shared_ptr<void>>(
+				resource_grid.dist_lookup_table.at(species), resource_grid.dist_lookup_table_storage.at(species)
+			);
+		}
+		else resource_grid.reference_dist_lookup_table(species, cached->second.first, cached->second.second);
+	}
+	void init(Dynamics& dynamics, vector<string>& animal_species, SimulationConfig& config) {
+		for (string& species : animal_species) {
+			init(dynamics.resource_grid, species, config.get_string("lookup_table_dir"), config.params.at("shared_lookup_tables").as_bool());
+		}
+	}
+private:
+	std::mutex mutex;
+	map<uint64_t, pair<const float*, shared_ptr<void>>> tables;
+};
+
+
+inline RunStatistics simulate(SimulationConfig config, unsigned int seed, LookupTableCache& lookup_tables, function<bool(Dynamics&)> observer = nullptr) {
+	// Run a single simulation on the calling thread, drawing all random numbers from a stream seeded with <seed>.
+	// <observer> is called after every timestep (see Dynamics::run()).
+	std::mt19937 rng(seed);
+	help::set_thread_RNG(&rng);
+	try {
+		config.params.set("random_seed", (int)(seed % 1000000));
+		config.params.set("firefreq_random_seed", (int)(rng() % 1000000));
+		if (config.get_string("log_level") == "auto") config.params.set("log_level", JsonValue(string("warning"))); // Batch runs only report problems.
+		Dynamics dynamics = config.create_dynamics();
+		vector<string> animal_species = config.init_dynamics(dynamics, false);
+		lookup_tables.init(dynamics, animal_species, config);
+
+		StopConditions conditions = config.get_stop_conditions();
+		int max_steps = (conditions.max_timesteps >= 0) ? conditions.max_timesteps : INT_MAX;
+		dynamics.run(max_steps, conditions, observer ? 1 : 0, observer);
+		dynamics.free();
+		help::set_thread_RNG(nullptr);
+		return dynamics.run_statistics;
+	}
+	catch (...) {
+		help::set_thread_RNG(nullptr);
+		throw;
+	}
+}
+
+
+class Replicate {
+public:
+	// Output of a single ensemble member.
+	unsigned int seed = 0;
+	vector<vector<float>> metrics; // Per timestep, in the order of Ensemble::metric_names.
+	RunStatistics run_statistics;
+	string error = ""; // Non-empty if the replicate failed.
+};
+
+
+class Ensemble {
+public:
+	// Runs <no_replicates> independent simulations with the same parameters in a pool of <no_threads> threads, and aggregates
+	// their per-timestep metrics (see Dynamics::get_metrics()) into means and variances.
+	// Each replicate draws from its own random stream, seeded from <base_seed> and its index, so results do not depend on the
+	// number of threads. Resource grid distance lookup tables are built (or loaded) once and shared read-only by all replicates.
+	Ensemble() = default;
+	Ensemble(SimulationConfig _config, int _no_replicates, int _no_threads, int _base_seed = -999) :
+		config(_config), no_replicates(_no_replicates), no_threads(_no_threads)
+	{
+		base_seed = (_base_seed == -999) ? std::random_device()() : _base_seed;
+		if (no_threads < 1) no_threads = max(1, (int)std::thread::hardware_concurrency());
+		no_threads = min(no_threads, no_replicates);
+	}
+	void run() {
+		replicates = vector<Replicate>(no_replicates);
+		metric_names.clear();
+		next_replicate = 0;
+		vector<std::thread> threads;
+		for (int i = 0; i < no_threads; i++) threads.push_back(std::thread(&Ensemble::work, this));
+		for (auto& thread : threads) thread.join();
+		aggregate();
+	}
+	unsigned int get_replicate_seed(int replicate) {
+		std::seed_seq sequence = { base_seed, (unsigned int)replicate };
+		unsigned int seed;
+		sequence.generate(&seed, &seed + 1);
+		return seed;
+	}
+	int get_metric_index(string metric) {
+		for (int i = 0; i < metric_names.size(); i++) {
+			if (metric_names[i] == metric) return i;
+		}
+		throw std::runtime_error("Unknown metric: " + metric);
+	}
+	vector<float> get_mean(string metric) {
+		int idx = get_metric_index(metric);
+		vector<float> means;
+		for (auto& step : statistics) means.push_back(step[idx].mean);
+		return means;
+	}
+	vector<float> get_variance(string metric) {
+		int idx = get_metric_index(metric);
+		vector<float> variances;
+		for (auto& step : statistics) variances.push_back(step[idx].get_variance());
+		return variances;
+	}
+	vector<int> get_no_replicates_per_step() {
+		// Replicates that terminate early contribute only to the timesteps they reached.
+		vector<int> counts;
+		for (auto& step : statistics) counts.push_back(step.size() > 0 ? step[0].count : 0);
+		return counts;
+	}
+	vector<float> get_replicate_series(int replicate, string metric) {
+		int idx = get_metric_index(metric);
+		vector<float> series;
+		for (auto& step : replicates.at(replicate).metrics) series.push_back(step[idx]);
+		return series;
+	}
+	SimulationConfig config;
+	int no_replicates = 0;
+	int no_threads = 1;
+	unsigned int base_seed = 0;
+	vector<string> metric_names;
+	vector<Replicate> replicates;
+	vector<vector<MetricAccumulator>> statistics; // Per timestep and metric.
+
+private:
+	void work() {
+		while (true) {
+			int replicate = next_replicate++;
+			if (replicate >= no_replicates) return;
+			run_replicate(replicate);
+		}
+	}
+	void run_replicate(int replicate) {
+		Replicate& result = replicates[replicate];
+		result.seed = get_replicate_seed(replicate);
+		try {
+			result.run_statistics = simulate(config, result.seed, lookup_tables, [this, &result](Dynamics& dynamics) {
+				vector<pair<string, float>> metrics = dynamics.get_metrics();
+				vector<float> values;
+				for (auto& [name, value] : metrics) values.push_back(value);
+				result.metrics.push_back(values);
+				if (result.metrics.size() == 1) set_metric_names(metrics);
+				return true;
+			});
+		}
+		catch (std::exception& error) {
+			result.error = error.what();
+		}
+	}
+	void set_metric_names(vector<pair<string, float>>& metrics) {
+		std::lock_guard<std::mutex> lock(metric_names_mutex);
+		if (metric_names.size() > 0) return;
+		for (auto& [name, value] : metrics) metric_names.push_back(name);
+	}
+	void aggregate() {
+		statistics.clear();
+		for (auto& replicate : replicates) {
+			if (replicate.error != "") printf("Replicate failed: %s\n", replicate.error.c_str());
+			for (int step = 0; step < replicate.metrics.size(); step++) {
+				if (step == statistics.size()) statistics.push_back(vector<MetricAccumulator>(metric_names.size()));
+				for (int i = 0; i < metric_names.size(); i++) statistics[step][i].add(replicate.metrics[step][i]);
+			}
+		}
+	}
+	std::atomic<int> next_replicate = 0;
+	std::mutex metric_names_mutex;
+	LookupTableCache lookup_tables;
+};
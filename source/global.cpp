@@ -2,6 +2,11 @@
 #include <pybind11/numpy.h>
 #include <pybind11/stl.h>
 #include "tests.h"
+#include "sweep.h"
+#include "checkpoint.h"
+#include "raster_series.h"
+#include "tree_log.h"
+#include "profiler.h"
 
 
 using namespace std;
@@ -26,37 +31,11 @@ void convert_from_numpy_array(py::array_t<float>& img, shared_ptr<float[]>& cove
 }
 
 py::array_t<int> as_2d_numpy_array(int* distribution, int width) {
-    constexpr size_t element_size = sizeof(int);
-    size_t shape[2]{ width, width };
-    size_t strides[2]{ width * element_size, element_size };
-    auto numpy_array = py::array_t<int>(shape, strides);
-    auto setter = numpy_array.mutable_unchecked<2>();
-
-    for (size_t i = 0; i < numpy_array.shape(0); i++)
-    {
-        for (size_t j = 0; j < numpy_array.shape(1); j++)
-        {
-            setter(i, j) = distribution[i * width + j];
-        }
-    }
-    return numpy_array;
+    return py::array_t<int>({ width, width }, distribution); // Copies the buffer in a single pass.
 }
 
 py::array_t<int> as_2d_numpy_array(shared_ptr<int[]> distribution, int width) {
-    constexpr size_t element_size = sizeof(int);
-    size_t shape[2]{ width, width };
-    size_t strides[2]{ width * element_size, element_size };
-    auto numpy_array = py::array_t<int>(shape, strides);
-    auto setter = numpy_array.mutable_unchecked<2>();
-
-    for (size_t i = 0; i < numpy_array.shape(0); i++)
-    {
-        for (size_t j = 0; j < numpy_array.shape(1); j++)
-        {
-            setter(i, j) = distribution[i * width + j];
-        }
-    }
-    return numpy_array;
+    return as_2d_numpy_array(distribution.get(), width);
 }
 
 py::array_t<float> as_2d_pairwise_numpy_array(float* distribution1, float* distribution2, int size) {
@@ -74,97 +53,39 @@ py::array_t<float> as_2d_pairwise_numpy_array(float* distribution1, float* distr
     return numpy_array;
 }
 
-py::array_t<float> as_state_report_numpy_array(float* distribution, int rows) {
-    constexpr size_t element_size = sizeof(float);
-    const int cols = 4;
-    size_t shape[2]{ rows, cols };
-    size_t strides[2]{ cols * element_size, element_size };
-    auto numpy_array = py::array_t<float>(shape, strides);
-    auto setter = numpy_array.mutable_unchecked<2>();
-
-    for (size_t i = 0; i < numpy_array.shape(0); i++)
-    {
-        for (int j = 0; j < cols; j++) {
-            setter(i, j) = distribution[i * cols + j];
-        }
-    }
-    return numpy_array;
-}
-
 py::array_t<float> as_2d_numpy_array(float* distribution, int width) {
-    constexpr size_t element_size = sizeof(float);
-    size_t shape[2]{ width, width };
-    size_t strides[2]{ width * element_size, element_size };
-    auto numpy_array = py::array_t<float>(shape, strides);
-    auto setter = numpy_array.mutable_unchecked<2>();
-
-    for (size_t i = 0; i < numpy_array.shape(0); i++)
-    {
-        for (size_t j = 0; j < numpy_array.shape(1); j++)
-        {
-            setter(i, j) = distribution[i * width + j];
-        }
-    }
-    return numpy_array;
+    return py::array_t<float>({ width, width }, distribution);
 }
 
 py::array_t<float> as_2d_numpy_array(shared_ptr<float[]> distribution, int width) {
-    constexpr size_t element_size = sizeof(float);
-    size_t shape[2]{ width, width };
-    size_t strides[2]{ width * element_size, element_size };
-    auto numpy_array = py::array_t<float>(shape, strides);
-    auto setter = numpy_array.mutable_unchecked<2>();
-
-    for (size_t i = 0; i < numpy_array.shape(0); i++)
-    {
-        for (size_t j = 0; j < numpy_array.shape(1); j++)
-        {
-            setter(i, j) = distribution[i * width + j];
-        }
-    }
-    return numpy_array;
+    return as_2d_numpy_array(distribution.get(), width);
 }
 
 py::array_t<float> as_1d_numpy_array(float* distribution, int size) {
-    constexpr size_t element_size = sizeof(float);
-    size_t shape[1]{ size };
-    size_t strides[1]{ element_size };
-    auto numpy_array = py::array_t<float>(shape, strides);
-    auto setter = numpy_array.mutable_unchecked<1>();
-
-    for (size_t i = 0; i < numpy_array.shape(0); i++)
-    {
-        setter(i) = distribution[i];
-    }
-    return numpy_array;
+    return py::array_t<float>(size, distribution);
 }
 
 py::array_t<float> as_1d_numpy_array(shared_ptr<float[]> distribution, int size) {
-    constexpr size_t element_size = sizeof(float);
-    size_t shape[1]{ size };
-    size_t strides[1]{ element_size };
-    auto numpy_array = py::array_t<float>(shape, strides);
-    auto setter = numpy_array.mutable_unchecked<1>();
-
-    for (size_t i = 0; i < numpy_array.shape(0); i++)
-    {
-        setter(i) = distribution[i];
-    }
-    return numpy_array;
+    return as_1d_numpy_array(distribution.get(), size);
 }
 
 py::array_t<float> as_1d_numpy_array(vector<float> distribution) {
-    constexpr size_t element_size = sizeof(float);
-    size_t shape[1]{ distribution.size() };
-    size_t strides[1]{ element_size };
-    auto numpy_array = py::array_t<float>(shape, strides);
-    auto setter = numpy_array.mutable_unchecked<1>();
+    return py::array_t<float>(distribution.size(), distribution.data());
+}
 
-    for (size_t i = 0; i < numpy_array.shape(0); i++)
-    {
-        setter(i) = distribution[i];
-    }
-    return numpy_array;
+// Zero-copy views (returned by the getters when copy=False). A view references a buffer owned by C++ instead of copying it.
+// Lifetime rules:
+//  - The view holds a reference to <owner>, so its memory stays valid even after the simulation object is destroyed or
+//    replaces the buffer.
+//  - While the buffer is in use by the simulation, the view reflects its current contents (e.g. the next call to
+//    get_distribution or the next timestep may change it). Copy the view (np.array(view)) to keep a snapshot.
+//  - Views are read-only.
+template <typename T, typename Owner>
+py::array_t<T> as_numpy_view(const T* data, vector<py::ssize_t> shape, Owner owner) {
+    py::capsule base(new Owner(owner), [](void* ptr) { delete (Owner*)ptr; });
+    py::array_t<T> view(shape, data, base);
+    view.attr("setflags")(py::arg("write") = false);
+    return view;
 }
 
 Dynamics create_dynamics(py::dict dict) {
@@ -203,6 +124,7 @@ PYBIND11_MODULE(dbr_cpp, module) {
 
     module.def("check_communication", &check_communication);
     module.def("init_RNG", &help::init_RNG);
+    module.def("get_peak_memory_usage", &help::get_peak_memory_usage, "Peak resident memory of the process, in bytes");
     module.def("create_dynamics", &create_dynamics, "Create a Dynamics object from a Python dictionary");
 
     py::class_<State>(module, "State")
@@ -220,19 +142,16 @@ PYBIND11_MODULE(dbr_cpp, module) {
             else state.set_cover_from_image(cover_image, width, height);
         })
         .def("get_state_table", [](State& state) {
+            // Filled in place, so that the table is not copied.
             int number_of_values_per_tree = 4;
-            float* state_table = new float[state.population.size() * number_of_values_per_tree];
-            state.get_state_table(state_table);
-            py::array_t<float> np_arr = as_state_report_numpy_array(state_table, state.population.size());
-            delete[] state_table;
-            return np_arr;
+            py::array_t<float> state_table({ (int)state.population.size(), number_of_values_per_tree });
+            state.get_state_table(state_table.mutable_data());
+            return state_table;
 		})
         .def("get_tree_sizes", [](State& state) {
-            float* tree_sizes = new float[state.population.size()];
-            state.get_tree_sizes(tree_sizes);
-            py::array_t<float> np_arr = as_1d_numpy_array(tree_sizes, state.population.size());
-            delete[] tree_sizes;
-            return np_arr;
+            py::array_t<float> tree_sizes((int)state.population.size());
+            state.get_tree_sizes(tree_sizes.mutable_data());
+            return tree_sizes;
 		})
         .def_readwrite("grid", &State::grid)
         .def_readwrite("population", &State::population)
@@ -245,10 +164,11 @@ PYBIND11_MODULE(dbr_cpp, module) {
         .def_readwrite("width", &Grid::width)
         .def_readwrite("width_r", &Grid::width_r)
         .def_readwrite("tree_cover", &Grid::tree_cover)
-        .def("get_distribution", [](Grid &grid, int &collect_states) {
+        .def("get_distribution", [](Grid &grid, int &collect_states, bool copy) {
             shared_ptr<int[]> state_distribution = grid.get_state_distribution(collect_states);
-            return as_2d_numpy_array(state_distribution, grid.width);
-        });
+            if (copy) return as_2d_numpy_array(state_distribution, grid.width);
+            return as_numpy_view<int>(state_distribution.get(), { grid.width, grid.width }, state_distribution);
+        }, py::arg("collect_states"), py::arg("copy") = true);
 
     py::class_<Dynamics>(module, "Dynamics")
         .def(py::init<>())
@@ -262,18 +182,40 @@ PYBIND11_MODULE(dbr_cpp, module) {
         .def_readwrite("timestep", &Dynamics::timestep)
         .def_readwrite("seeds_produced", &Dynamics::seeds_produced)
         .def_readwrite("max_dbh", &Dynamics::max_dbh)
+        .def_readwrite("animal_dispersal_threads", &Dynamics::animal_dispersal_threads)
         .def("init_state", &Dynamics::init_state)
         .def("get_fires", [](Dynamics& dynamics) {
             py::array_t<float> np_arr = as_1d_numpy_array(dynamics.fires);
             return np_arr;
         })
         .def("update", &Dynamics::update)
+        .def("run", [](Dynamics& dynamics, int max_steps, StopConditions& stop_conditions, int observer_every, py::object observer) {
+            // The simulation runs with the GIL released; it is reacquired only to call the observer.
+            function<bool(Dynamics&)> callback = nullptr;
+            if (!observer.is_none()) callback = [&observer](Dynamics& dynamics) {
+                py::gil_scoped_acquire acquire;
+                py::object keep_running = observer(py::cast(&dynamics, py::return_value_policy::reference));
+                return keep_running.is_none() || keep_running.cast<bool>();
+            };
+            py::gil_scoped_release release;
+            return dynamics.run(max_steps, stop_conditions, observer_every, callback);
+        }, py::arg("max_steps"), py::arg("stop_conditions"), py::arg("observer_every") = 0, py::arg("observer") = py::none())
+        .def_readonly("run_statistics", &Dynamics::run_statistics)
+        .def_property_readonly("profiler", [](Dynamics& dynamics) -> Profiler& { return dynamics.profiler; }, py::return_value_policy::reference_internal)
+        .def_property_readonly("logger", [](Dynamics& dynamics) -> Logger& { return dynamics.state.logger; }, py::return_value_policy::reference_internal)
+        .def("get_memory_usage", [](Dynamics& dynamics) {
+            // Approximate bytes per subsystem (see Dynamics::get_memory_usage()).
+            py::dict usage;
+            for (auto& [subsystem, bytes] : dynamics.get_memory_usage()) usage[py::str(subsystem)] = bytes;
+            return usage;
+        })
+        .def_readwrite("log_memory_usage", &Dynamics::log_memory_usage)
         .def("simulate_fires", &Dynamics::burn)
-        .def("get_firefree_intervals", [](Dynamics& dynamics, string& type) {
+        .def("get_firefree_intervals", [](Dynamics& dynamics, string& type, bool copy) {
             shared_ptr<float[]> intervals = dynamics.get_firefree_intervals(type);
-            py::array_t<float> np_arr = as_1d_numpy_array(intervals, dynamics.grid->no_cells);
-            return np_arr;
-        })
+            if (copy) return as_1d_numpy_array(intervals, dynamics.grid->no_cells);
+            return as_numpy_view<float>(intervals.get(), { dynamics.grid->no_cells }, intervals);
+        }, py::arg("type") = "current_iteration", py::arg("copy") = true)
         .def("get_no_recruits", [](Dynamics& dynamics, string& type) {
 			float no_recruits = dynamics.get_no_recruits(type);
 			return no_recruits;
@@ -290,19 +232,21 @@ PYBIND11_MODULE(dbr_cpp, module) {
             std::map<string, std::map<string, float>> animal_kernel_params = py::cast<std::map<string, std::map<string, float>>>(_animal_kernel_params);
             dynamics.set_global_kernels(nonanimal_kernel_params, animal_kernel_params);
         })
-        .def("get_resource_grid_colors", [](Dynamics& dynamics, string& species, string& type, int& verbosity) {
+        .def("get_resource_grid_colors", [](Dynamics& dynamics, string& species, string& type, int& verbosity, bool copy) {
             shared_ptr<int[]> color_distribution = dynamics.resource_grid.get_color_distribution(species, type, verbosity);
-            return as_2d_numpy_array(color_distribution, dynamics.resource_grid.width);
-        })
-        .def("get_resource_grid_lookup_table", [](Dynamics& dynamics, string& species) {
-            shared_ptr<float[]> lookup_table = dynamics.resource_grid.get_lookup_table(species);
-            return as_2d_numpy_array(lookup_table, dynamics.resource_grid.width * dynamics.resource_grid.width);
-        })
-        .def("set_resource_grid_lookup_table", [](Dynamics& dynamics, py::array_t<float>& lookup_table, string& species) {
-            shared_ptr<float[]> float_array;
-            int width, height;
-			convert_from_numpy_array(lookup_table, float_array, width, height);
-			dynamics.resource_grid.set_dist_lookup_table(float_array, species);
+            int width = dynamics.resource_grid.width;
+            if (copy) return as_2d_numpy_array(color_distribution, width);
+            return as_numpy_view<int>(color_distribution.get(), { width, width }, color_distribution);
+        }, py::arg("species"), py::arg("type"), py::arg("verbosity"), py::arg("copy") = true)
+        .def("get_resource_grid_lookup_table", [](Dynamics& dynamics, string& species, bool copy) {
+            const float* lookup_table = dynamics.resource_grid.get_lookup_table(species);
+            int size = dynamics.resource_grid.size;
+            if (copy) return as_2d_numpy_array((float*)lookup_table, size);
+            return as_numpy_view<float>(lookup_table, { size, size }, dynamics.resource_grid.dist_lookup_table_storage.at(species));
+        }, py::arg("species"), py::arg("copy") = true)
+        .def("set_resource_grid_lookup_table", [](Dynamics& dynamics, py::array_t<float, py::array::c_style | py::array::forcecast>& lookup_table, string& species) {
+            if (lookup_table.size() != dynamics.resource_grid.lookup_table_size) throw std::runtime_error("Lookup table has the wrong size.");
+            dynamics.resource_grid.set_dist_lookup_table(lookup_table.data(), species); // Copied in a single pass from the numpy buffer.
 		})
         .def("get_fraction_time_spent_moving", [](Dynamics& dynamics) {
 			return dynamics.fraction_time_spent_moving;
@@ -339,7 +283,248 @@ PYBIND11_MODULE(dbr_cpp, module) {
         })
         .def("precompute_resourcegrid_lookup_table", [](Dynamics& dynamics, string& species) {
             dynamics.resource_grid.precompute_dist_lookup_table(species);
-		});
+		})
+        .def("init_resourcegrid_lookup_table", [](Dynamics& dynamics, string& species, string& cache_dir, bool shared_memory) {
+            dynamics.resource_grid.init_dist_lookup_table(species, cache_dir, shared_memory);
+        })
+        .def("remove_shared_resourcegrid_lookup_table", [](Dynamics& dynamics, string& species) {
+            dynamics.resource_grid.remove_shared_dist_lookup_table(species);
+        })
+        .def("remove_shared_resourcegrid_lookup_tables", [](Dynamics& dynamics) {
+            for (string& species : dynamics.resource_grid.species) dynamics.resource_grid.remove_shared_dist_lookup_table(species);
+        })
+        .def("fork", [](Dynamics& dynamics) {
+            unique_ptr<Dynamics> branch = make_unique<Dynamics>();
+            dynamics.fork(*branch);
+            return branch;
+        })
+        .def("save_checkpoint", &save_checkpoint, py::arg("path"))
+        .def("load_checkpoint", &load_checkpoint, py::arg("path"), py::arg("lookup_table_dir") = ".", py::arg("shared_lookup_tables") = false);
+
+    module.def("load_checkpoint", [](string path, string lookup_table_dir, bool shared_lookup_tables) {
+        // Loaded in place, as the state holds pointers into the Dynamics object.
+        unique_ptr<Dynamics> dynamics = make_unique<Dynamics>();
+        load_checkpoint(*dynamics, path, lookup_table_dir, shared_lookup_tables);
+        return dynamics;
+    }, py::arg("path"), py::arg("lookup_table_dir") = ".", py::arg("shared_lookup_tables") = false);
+
+    py::class_<Ensemble>(module, "Ensemble")
+        .def(py::init([](py::dict params, string data_in_dir, int no_replicates, int no_threads, int base_seed) {
+            // <params> uses the same keys as the Python configuration (see config.py).
+            string text = py::module_::import("json").attr("dumps")(params, py::arg("default") = py::module_::import("builtins").attr("str")).cast<string>();
+            return new Ensemble(SimulationConfig(JsonValue::parse(text), data_in_dir), no_replicates, no_threads, base_seed);
+        }), py::arg("params"), py::arg("data_in_dir"), py::arg("no_replicates"), py::arg("no_threads") = 0, py::arg("base_seed") = -999)
+        .def("run", &Ensemble::run, py::call_guard<py::gil_scoped_release>())
+        .def_readonly("no_replicates", &Ensemble::no_replicates)
+        .def_readonly("no_threads", &Ensemble::no_threads)
+        .def_readonly("base_seed", &Ensemble::base_seed)
+        .def_readonly("metric_names", &Ensemble::metric_names)
+        .def("get_mean", [](Ensemble& ensemble, string metric) {
+            return as_1d_numpy_array(ensemble.get_mean(metric));
+        })
+        .def("get_variance", [](Ensemble& ensemble, string metric) {
+            return as_1d_numpy_array(ensemble.get_variance(metric));
+        })
+        .def("get_no_replicates_per_step", &Ensemble::get_no_replicates_per_step)
+        .def("get_replicate_series", [](Ensemble& ensemble, int replicate, string metric) {
+            return as_1d_numpy_array(ensemble.get_replicate_series(replicate, metric));
+        })
+        .def("get_run_statistics", [](Ensemble& ensemble, int replicate) {
+            Replicate& result = ensemble.replicates.at(replicate);
+            if (result.error != "") throw std::runtime_error("Replicate " + to_string(replicate) + " failed: " + result.error);
+            return result.run_statistics;
+        });
+
+    py::class_<Sweep>(module, "Sweep")
+        .def(py::init([](py::dict params, py::dict settings, string data_in_dir, int no_threads, int base_seed) {
+            // <params> uses the keys of config.py; <settings> those documented in sweep.h (the batch.py arguments).
+            py::object dumps = py::module_::import("json").attr("dumps");
+            py::object str = py::module_::import("builtins").attr("str");
+            SimulationConfig config(JsonValue::parse(dumps(params, py::arg("default") = str).cast<string>()), data_in_dir);
+            return new Sweep(config, JsonValue::parse(dumps(settings).cast<string>()), no_threads, base_seed);
+        }), py::arg("params"), py::arg("settings"), py::arg("data_in_dir"), py::arg("no_threads") = 0, py::arg("base_seed") = -999)
+        .def("run", &Sweep::run, py::call_guard<py::gil_scoped_release>())
+        .def("write_results", &Sweep::write_results)
+        .def("get_results", [](Sweep& sweep) {
+            return py::module_::import("json").attr("loads")(sweep.get_results().dump());
+        })
+        .def_readonly("no_threads", &Sweep::no_threads)
+        .def_readonly("base_seed", &Sweep::base_seed);
+
+    py::class_<RasterSeriesWriter>(module, "RasterSeriesWriter")
+        .def(py::init<string, int, vector<string>, int, int>(), py::arg("path"), py::arg("width"),
+            py::arg("layers") = vector<string>{ "state", "cover", "LAI", "fire" }, py::arg("keyframe_interval") = 16, py::arg("max_pending_frames") = 4)
+        .def("add_frame", &RasterSeriesWriter::add_frame, py::call_guard<py::gil_scoped_release>())
+        .def("close", &RasterSeriesWriter::close, py::call_guard<py::gil_scoped_release>())
+        .def("get_no_frames", &RasterSeriesWriter::get_no_frames)
+        .def_readonly("path", &RasterSeriesWriter::path);
+
+    py::class_<RasterSeriesReader>(module, "RasterSeriesReader")
+        .def(py::init<string>(), py::arg("path"))
+        .def("get_no_frames", &RasterSeriesReader::get_no_frames)
+        .def("get_times", &RasterSeriesReader::get_times)
+        .def("get_layer_names", &RasterSeriesReader::get_layer_names)
+        .def("get_width", &RasterSeriesReader::get_width)
+        .def("get_frame", [](RasterSeriesReader& reader, int frame, string layer) -> py::array {
+            // Returns a (height, width) array of the layer's value type (int32, uint8 or float32).
+            int layer_idx = reader.get_layer_index(layer);
+            const vector<char>& data = reader.get_layer(frame, layer_idx);
+            vector<py::ssize_t> shape = { reader.get_height(), reader.get_width() };
+            switch (reader.layers[layer_idx].type) {
+            case RasterLayer::int32: return py::array_t<int32_t>(shape, (const int32_t*)data.data());
+            case RasterLayer::float32: return py::array_t<float>(shape, (const float*)data.data());
+            default: return py::array_t<uint8_t>(shape, (const uint8_t*)data.data());
+            }
+        }, py::arg("frame"), py::arg("layer"))
+        .def_readonly("path", &RasterSeriesReader::path);
+
+    py::class_<TreeLogWriter>(module, "TreeLogWriter")
+        .def(py::init<string, Dynamics&, int, float, int>(), py::arg("path"), py::arg("dynamics"), py::arg("snapshot_every") = 1,
+            py::arg("position_resolution") = 0.001f, py::arg("max_pending_steps") = 4, py::keep_alive<1, 3>())
+        .def("record_step", &TreeLogWriter::record_step)
+        .def("close", &TreeLogWriter::close, py::call_guard<py::gil_scoped_release>())
+        .def_readonly("path", &TreeLogWriter::path);
+
+    auto as_column_dict = [](TreeLogTable& table, bool events) {
+        // Columns as numpy arrays, keyed by name; event types are given by name (see TreeEventType).
+        py::dict columns;
+        columns["time"] = py::array_t<int>(table.size(), table.time.data());
+        columns["id"] = py::array_t<int>(table.size(), table.id.data());
+        columns["x"] = py::array_t<float>(table.size(), table.x.data());
+        columns["y"] = py::array_t<float>(table.size(), table.y.data());
+        columns["dbh"] = py::array_t<float>(table.size(), table.dbh.data());
+        columns["strategy"] = py::array_t<int>(table.size(), table.strategy.data());
+        if (events) {
+            columns["type"] = py::array_t<uint8_t>(table.size(), table.type.data());
+        }
+        else {
+            columns["life_phase"] = py::array_t<uint8_t>(table.size(), table.life_phase.data());
+            columns["age"] = py::array_t<int>(table.size(), table.age.data());
+        }
+        return columns;
+    };
+    py::class_<TreeLogReader>(module, "TreeLogReader")
+        .def(py::init<string>(), py::arg("path"))
+        .def("get_events", [as_column_dict](TreeLogReader& reader, int begin_time, int end_time, vector<int> ids) {
+            TreeLogTable table = reader.get_events(begin_time, end_time, ids);
+            return as_column_dict(table, true);
+        }, py::arg("begin_time") = INT_MIN, py::arg("end_time") = INT_MAX, py::arg("ids") = vector<int>())
+        .def("get_snapshots", [as_column_dict](TreeLogReader& reader, int begin_time, int end_time, vector<int> ids) {
+            TreeLogTable table = reader.get_snapshots(begin_time, end_time, ids);
+            return as_column_dict(table, false);
+        }, py::arg("begin_time") = INT_MIN, py::arg("end_time") = INT_MAX, py::arg("ids") = vector<int>())
+        .def("get_snapshot_times", &TreeLogReader::get_snapshot_times)
+        .def("get_event_types", [](TreeLogReader& reader) {
+            vector<string> names;
+            for (int type = 0; type <= (int)TreeEventType::removal; type++) names.push_back(get_tree_event_name((TreeEventType)type));
+            return names;
+        })
+        .def("get_strategies", [](TreeLogReader& reader) {
+            py::list strategies;
+            for (Strategy& strategy : reader.strategies) {
+                py::dict traits;
+                traits["vector"] = get_vector_name(strategy.vector);
+                traits["seed_mass"] = strategy.seed_mass;
+                traits["diaspore_mass"] = strategy.diaspore_mass;
+                traits["no_seeds_per_diaspore"] = strategy.no_seeds_per_diaspore;
+                traits["seed_tspeed"] = strategy.seed_tspeed;
+                traits["pulp_to_seed_ratio"] = strategy.pulp_to_seed_ratio;
+                traits["recruitment_probability"] = strategy.recruitment_probability;
+                traits["relative_growth_rate"] = strategy.relative_growth_rate;
+                traits["seed_reserve_mass"] = strategy.seed_reserve_mass;
+                traits["seedling_dbh"] = strategy.seedling_dbh;
+                strategies.append(traits);
+            }
+            return strategies;
+        })
+        .def_readonly("path", &TreeLogReader::path);
+
+    py::class_<Profiler>(module, "Profiler")
+        .def_readwrite("enabled", &Profiler::enabled)
+        .def_readwrite("tracing", &Profiler::tracing)
+        .def_readwrite("max_trace_events", &Profiler::max_trace_events)
+        .def("get_table", [](Profiler& profiler, bool per_step) {
+            // Phase statistics as columns (e.g. for pandas.DataFrame): one row per phase and timestep, or per phase over the whole run.
+            vector<int> time, depth;
+            vector<string> phase;
+            vector<int64_t> calls;
+            vector<double> total_ms, max_ms;
+            vector<int64_t> counts[PerfCounters::no_counters];
+            auto add_row = [&](int _time, int idx, int64_t _calls, int64_t total_ns, int64_t max_ns, const int64_t* _counts) {
+                time.push_back(_time);
+                phase.push_back(profiler.phases[idx].path);
+                depth.push_back(profiler.phases[idx].depth);
+                calls.push_back(_calls);
+                total_ms.push_back(total_ns / 1e6);
+                max_ms.push_back(max_ns / 1e6);
+                for (int i = 0; i < PerfCounters::no_counters; i++) counts[i].push_back(_counts[i]);
+            };
+            if (per_step) for (auto& step : profiler.steps) add_row(step.time, step.phase, step.calls, step.total_ns, step.max_ns, step.counts);
+            else for (int i = 0; i < profiler.phases.size(); i++) {
+                Profiler::Phase& p = profiler.phases[i];
+                add_row(-1, i, p.calls, p.total_ns, p.max_ns, p.counts);
+            }
+            py::dict table;
+            if (per_step) table["time"] = py::array_t<int>(time.size(), time.data());
+            table["phase"] = phase;
+            table["depth"] = py::array_t<int>(depth.size(), depth.data());
+            table["calls"] = py::array_t<int64_t>(calls.size(), calls.data());
+            table["total_ms"] = py::array_t<double>(total_ms.size(), total_ms.data());
+            table["max_ms"] = py::array_t<double>(max_ms.size(), max_ms.data());
+            for (int i = 0; i < PerfCounters::no_counters; i++) {
+                // Hardware event counts are only included if the counters are enabled and supported by the CPU.
+                if (profiler.counters.is_supported(i)) table[PerfCounters::names[i]] = py::array_t<int64_t>(counts[i].size(), counts[i].data());
+            }
+            return table;
+        }, py::arg("per_step") = true)
+        .def("write_chrome_trace", &Profiler::write_chrome_trace, py::arg("path"))
+        .def("enable_counters", &Profiler::enable_counters)
+        .def("disable_counters", &Profiler::disable_counters)
+        .def_property_readonly("counters_enabled", [](Profiler& profiler) { return profiler.counters.is_open(); })
+        .def("reset", &Profiler::reset);
+
+    py::class_<Logger>(module, "Logger")
+        .def_property("level",
+            [](Logger& logger) { return get_log_level_name(logger.level); },
+            [](Logger& logger, string level) { logger.level = get_log_level(level); }
+        )
+        .def_readwrite("echo", &Logger::echo)
+        .def_readwrite("buffered", &Logger::buffered)
+        .def_readwrite("ring_size", &Logger::ring_size)
+        .def_readwrite("record_metrics", &Logger::record_metrics)
+        .def("get_recent_messages", &Logger::get_recent_messages)
+        .def("get_metrics", [](Logger& logger) {
+            // The metrics channel as columns (time, name, value), e.g. for pandas.DataFrame.
+            vector<int> time;
+            vector<string> name;
+            vector<double> value;
+            for (LogMetric& metric : logger.metrics) {
+                time.push_back(metric.time);
+                name.push_back(metric.name);
+                value.push_back(metric.value);
+            }
+            py::dict table;
+            table["time"] = py::array_t<int>(time.size(), time.data());
+            table["name"] = name;
+            table["value"] = py::array_t<double>(value.size(), value.data());
+            return table;
+        })
+        .def("flush", &Logger::flush)
+        .def("clear", &Logger::clear);
+
+    py::class_<StopConditions>(module, "StopConditions")
+        .def(py::init<>())
+        .def_readwrite("max_timesteps", &StopConditions::max_timesteps)
+        .def_readwrite("max_tree_cover", &StopConditions::max_tree_cover)
+        .def_readwrite("initial_tree_cover", &StopConditions::initial_tree_cover);
+
+    py::class_<RunStatistics>(module, "RunStatistics")
+        .def_readonly("tree_cover", &RunStatistics::tree_cover)
+        .def_readonly("slope", &RunStatistics::slope)
+        .def_readonly("largest_absolute_slope", &RunStatistics::largest_absolute_slope)
+        .def_readonly("initial_no_dispersals", &RunStatistics::initial_no_dispersals)
+        .def_readonly("no_steps", &RunStatistics::no_steps)
+        .def_readonly("termination_cause", &RunStatistics::termination_cause);
 
     py::class_<DiscreteProbabilityModel>(module, "DiscreteProbabilityModel")
         .def(py::init<>())
@@ -74,6 +74,11 @@ public:
 	float query_grass_LAI() {
 		return grass_LAI;
 	}
+	void restore_LAI(float _LAI, float _grass_LAI) {
+		// Used when loading a checkpoint; the LAI is otherwise only changed by adding and removing trees.
+		LAI = _LAI;
+		grass_LAI = _grass_LAI;
+	}
 	bool tree_is_present(Tree* tree) {
 		return find(trees.begin(), trees.end(), tree->id) != trees.end();
 	}
@@ -291,6 +296,13 @@ public:
 		cell_halfdiagonal_sqrt = help::get_dist(pair<float, float>(0, 0), pair<float, float>(0.5f * cell_width, 0.5f * cell_width));
 		cell_area_half = cell_area * 0.5f;
 	}
+	Grid copy() const {
+		// Copying a grid by value shares its cells; the copy returned here has its own.
+		Grid grid = *this;
+		grid.distribution = help::copy_array(distribution, no_cells);
+		grid.state_distribution = help::copy_array(state_distribution, no_cells);
+		return grid;
+	}
 	void init_grid_cells() {
 		distribution = make_shared<Cell[]>(no_cells);
 		for (int i = 0; i < no_cells; i++) {
@@ -377,13 +389,39 @@ public:
 		for (int i = 0; i < no_cells; i++) {
 			distribution[i].reset();
 		}
+		seedling_cells.clear();
 		no_forest_cells = 0;
 		no_savanna_cells = no_cells;
 	}
 	void reset_state_distr() {
-		for (int i = 0; i < no_cells; i++) {
-			state_distribution[i] = 0;
+		// Only the entries written since the last reset need clearing, unless the whole distribution was overwritten.
+		if (state_distribution_dirty) {
+			for (int i = 0; i < no_cells; i++) {
+				state_distribution[i] = 0;
+			}
+			state_distribution_dirty = false;
 		}
+		else {
+			for (int idx : touched_state_cells) {
+				state_distribution[idx] = 0;
+			}
+		}
+		touched_state_cells.clear();
+	}
+	void set_state_distribution_value(int idx, int value) {
+		state_distribution[idx] = value;
+		touched_state_cells.push_back(idx);
+	}
+	void add_seedling(Cell* cell) {
+		// Register a germinated seedling. Each cell is listed once per timestep, regardless of how many seeds germinate in it.
+		if (!cell->seedling_present) seedling_cells.push_back(cell->idx);
+		cell->seedling_present = true;
+	}
+	void clear_seedlings() {
+		for (int idx : seedling_cells) {
+			distribution[idx].seedling_present = false;
+		}
+		seedling_cells.clear();
 	}
 	void redo_count() {
 		no_savanna_cells = 0;
@@ -467,10 +505,10 @@ public:
 				if (cell->get_LAI() < 1.0f) { 
 					if (cell->idx != ignition_cell_idx) queue.push(cell); // The ignition cell (responsible for setting the tree on fire) is already in the queue.
 					set_to_savanna(cell->idx, time_last_fire);
-					if (store_tree_death_in_color_distribution) state_distribution[cell->idx] = -6;
+					if (store_tree_death_in_color_distribution) set_state_distribution_value(cell->idx, -6);
 					continue;
 				}
-				if (store_burn_events) state_distribution[cell->idx] = -5;
+				if (store_burn_events) set_state_distribution_value(cell->idx, -5);
 			}
 		}
 		int center_idx = get_capped_center_idx(it.tree_center_gb);
@@ -529,6 +567,7 @@ public:
 	}
 	shared_ptr<int[]> get_state_distribution(int collect = 0) {
 		if (collect > 0) {
+			state_distribution_dirty = true;
 			for (int i = 0; i < no_cells; i++) {
 				if (collect == 1) {
 					if (distribution[i].state == 1) state_distribution[i] = max(99.0f - (distribution[i].get_LAI() * 19.0f), 1);
@@ -541,6 +580,7 @@ public:
 		return state_distribution;
 	}
 	void set_state_distribution(int* distr) {
+		state_distribution_dirty = true;
 		for (int i = 0; i < no_cells; i++) {
 			if (distr[i] >= 0 && distr[i] < 10)
 				state_distribution[i] = distr[i];
@@ -620,6 +660,14 @@ public:
 		pair<int, int> position = idx_2_pos(idx);
 		return pair<float, float>((float)position.first * cell_width, (float)position.second * cell_width);
 	}
+	size_t get_cell_memory_size() const {
+		size_t bytes = (size_t)no_cells * sizeof(Cell);
+		for (int i = 0; i < no_cells; i++) bytes += help::get_memory_size(distribution[i].trees);
+		return bytes;
+	}
+	size_t get_layer_memory_size() const {
+		return (size_t)no_cells * sizeof(int) + help::get_memory_size(touched_state_cells) + help::get_memory_size(seedling_cells);
+	}
 	int width = 0;
 	int no_cells = 0;
 	float width_r = 0;
@@ -629,6 +677,9 @@ public:
 	float cell_half_width = 0;
 	shared_ptr<Cell[]> distribution = 0;
 	shared_ptr<int[]> state_distribution = 0;
+	vector<int> touched_state_cells;	// Indices of state_distribution entries written since the last reset.
+	vector<int> seedling_cells;			// Indices of cells in which a seedling germinated during the current timestep.
+	bool state_distribution_dirty = true;
 	int no_savanna_cells = 0;
 	int no_forest_cells = 0;
 	float area = 0;
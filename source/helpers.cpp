@@ -6,6 +6,11 @@
 #include <filesystem.>
 #include <time.h>
 #include <string.h>
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
 
 
 using namespace std;
@@ -13,7 +18,12 @@ using namespace std;
 #define RAND_DOUBLE_PRECISION 0.0001
 #define INV_RAND_DOUBLE_PRECISION_PLUSONE 1.0 / (1.0 + RAND_DOUBLE_PRECISION)
 
+// Thread-local random engine which, when set, replaces the global rand() stream for the calling thread.
+thread_local std::mt19937* thread_RNG = nullptr;
+
 void help::init_RNG(int seed) {
+    // A thread with its own generator (see set_thread_RNG()) does not draw from rand(), so it leaves the shared stream alone.
+    if (thread_RNG != nullptr) return;
     if (seed == -999) {
         // Seed the random number generator with the current time
 		srand(time(NULL));
@@ -26,12 +36,30 @@ void help::init_RNG(int seed) {
     int z = x * 3;
 }
 
+void help::set_thread_RNG(std::mt19937* rng) {
+    thread_RNG = rng;
+}
+
+std::mt19937* help::get_thread_RNG() {
+    return thread_RNG;
+}
+
+void help::reseed_RNG(unsigned int seed) {
+    if (thread_RNG != nullptr) thread_RNG->seed(seed);
+    else srand(seed);
+}
+
+int help::get_rand() {
+    if (thread_RNG != nullptr) return (*thread_RNG)() % ((unsigned int)RAND_MAX + 1u);
+    return rand();
+}
+
 float help::get_rand_float(float min, float max) {
-    return min + (float)rand() * INV_RAND_MAX * (max - min);
+    return min + (float)help::get_rand() * INV_RAND_MAX * (max - min);
 }
 
 double help::_get_rand_double(double min, double max) {
-    return min + ((double)rand() * INV_RAND_MAX) * (max - min);
+    return min + ((double)help::get_rand() * INV_RAND_MAX) * (max - min);
 }
 
 double help::get_rand_double(double min, double max) {
@@ -491,6 +519,22 @@ vector<float> help::get_free_memory() {
     return { RAM_gigabytes, VM_gigabytes, Pagefile_gigabytes, (float)percent_memory };
 }
 
+size_t help::get_peak_memory_usage() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss; // Bytes on macOS, kilobytes elsewhere.
+#else
+    return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
 double help::get_mean(vector<double>* distribution) {
     double sum = 0;
     for (double& sample : *distribution) {
@@ -11,6 +11,12 @@
 #include <random>
 #include <chrono>
 #include <numeric>
+#include <variant>
+#include <mutex>
+#include <thread>
+#include <barrier>
+#include <atomic>
+#include <cstring>
 
 #define _USE_MATH_DEFINES
 #include <cmath>
@@ -93,6 +99,18 @@ namespace help {
 
 	void init_RNG(int seed);
 
+	// Make the get_rand_* functions draw from <rng> on the calling thread (pass nullptr to restore the global rand() stream)
+	void set_thread_RNG(std::mt19937* rng);
+
+	// The generator set with set_thread_RNG() on the calling thread, or nullptr if it draws from rand()
+	std::mt19937* get_thread_RNG();
+
+	// Reseed the calling thread's random stream (the thread's generator if one is set, otherwise the global rand() stream)
+	void reseed_RNG(unsigned int seed);
+
+	// Draw an integer in [0, RAND_MAX] from the calling thread's random stream
+	int get_rand();
+
 	void sort(std::map<int, double>& _map, PairSet& _set);
 
 	int get_key(std::map<int, int>* _map, int value);
@@ -168,6 +186,15 @@ namespace help {
 	template <typename T, typename U>
 	pair<T, U> pop(map<T, U>* map, int idx);
 
+	// Copy the first <size> elements of <array> into a new array (copying the shared_ptr itself would share the elements)
+	template <typename T>
+	shared_ptr<T[]> copy_array(const shared_ptr<T[]>& array, size_t size) {
+		if (array == nullptr) return nullptr;
+		shared_ptr<T[]> copy = make_shared<T[]>(size);
+		std::copy(array.get(), array.get() + size, copy.get());
+		return copy;
+	}
+
 	float get_dist(pair<float, float> p1, pair<float, float> p2);
 
 	float get_manhattan_dist(pair<float, float> p1, pair<float, float> p2);
@@ -210,6 +237,25 @@ namespace help {
 	// Get free RAM memory
 	vector<float> get_free_memory();
 
+	// Get the peak resident set size (working set on Windows) of the process, in bytes
+	size_t get_peak_memory_usage();
+
+	// Approximate heap memory held by a container (excluding memory owned by its elements), in bytes
+	template <typename T>
+	size_t get_memory_size(const vector<T>& vec) {
+		return vec.capacity() * sizeof(T);
+	}
+	template <typename K, typename V, typename H, typename E>
+	size_t get_memory_size(const unordered_map<K, V, H, E>& map) {
+		// One node (next pointer, element and cached hash) per element, plus the bucket array.
+		return map.size() * (sizeof(void*) + sizeof(pair<const K, V>) + sizeof(size_t)) + map.bucket_count() * sizeof(void*);
+	}
+	template <typename K, typename V>
+	size_t get_memory_size(const map<K, V>& map) {
+		// One red-black tree node (color and three pointers, plus the element) per element.
+		return map.size() * (4 * sizeof(void*) + sizeof(pair<const K, V>));
+	}
+
 	// Get stdev
 	double get_stdev(vector<double>* distribution, double mean = -999999);
 
@@ -304,7 +350,7 @@ namespace help {
 		NormalProbModel() = default;
 		NormalProbModel(float mean, float stdev) {
 			distribution = normal_distribution<float>(mean, stdev);
-			generator = default_random_engine(rand());
+			generator = default_random_engine(help::get_rand());
 		};
 		virtual float get_normal_distr_sample() {
 			return distribution(generator);
@@ -345,7 +391,7 @@ namespace help {
 			size = _size;
 			probabilities = std::make_shared<double[]>(_size);
 			cdf = std::make_shared<double[]>(_size);
-			id = rand();
+			id = help::get_rand();
 			printf("Initializing %i through non-default constructor\n", id);
 		};
 		/*~DiscreteProbabilityModel() {
@@ -402,6 +448,13 @@ namespace help {
 				probabilities[i] *= recipr;
 			}
 		}
+		DiscreteProbabilityModel copy() const {
+			// Copying by value shares the probability arrays; the copy returned here has its own.
+			DiscreteProbabilityModel model = *this;
+			model.probabilities = copy_array(probabilities, size);
+			model.cdf = copy_array(cdf, size);
+			return model;
+		}
 		shared_ptr<double[]> probabilities = 0;
 		shared_ptr<double[]> cdf = 0;
 		int size = 0;
@@ -437,7 +490,7 @@ namespace help {
 	public:
 		GammaProbModel() = default;
 		GammaProbModel(float shape, float scale) {
-			generator = default_random_engine(rand());
+			generator = default_random_engine(help::get_rand());
 			distribution = std::gamma_distribution<float>(shape, scale);
 		};
 		virtual float get_gamma_sample() {
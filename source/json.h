@@ -0,0 +1,213 @@
+#pragma once
+#include "helpers.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+
+class JsonValue {
+public:
+	// Minimal JSON document model, sufficient for the parameter files in data_in. Objects keep their keys in file order.
+	enum class Type { null = 0, boolean = 1, number = 2, string = 3, array = 4, object = 5 };
+	JsonValue() = default;
+	JsonValue(double _number) : type(Type::number), number(_number) {}
+	JsonValue(int _number) : type(Type::number), number(_number) {}
+	JsonValue(const char* _str) : type(Type::string), str(_str) {}
+	JsonValue(bool _boolean) : type(Type::boolean), boolean(_boolean) {}
+	JsonValue(string _str) : type(Type::string), str(_str) {}
+	static JsonValue parse(const string& text) {
+		size_t pos = 0;
+		JsonValue value = parse_value(text, pos);
+		skip_whitespace(text, pos);
+		if (pos != text.size()) throw std::runtime_error("Unexpected trailing characters in JSON at position " + to_string(pos));
+		return value;
+	}
+	static JsonValue load(const string& path) {
+		ifstream file(path);
+		if (!file) throw std::runtime_error("Could not open JSON file " + path);
+		stringstream buffer;
+		buffer << file.rdbuf();
+		return parse(buffer.str());
+	}
+	bool has(const string& key) const {
+		return find(key) != nullptr;
+	}
+	const JsonValue& at(const string& key) const {
+		const JsonValue* value = find(key);
+		if (value == nullptr) throw std::runtime_error("Missing key: " + key);
+		return *value;
+	}
+	JsonValue& at(const string& key) {
+		return const_cast<JsonValue&>(((const JsonValue*)this)->at(key));
+	}
+	void set(const string& key, JsonValue value) {
+		type = Type::object;
+		for (auto& [_key, _value] : object) {
+			if (_key == key) {
+				_value = value;
+				return;
+			}
+		}
+		object.push_back(pair<string, JsonValue>(key, value));
+	}
+	float as_float() const {
+		if (type == Type::boolean) return boolean;
+		if (type != Type::number) throw std::runtime_error("JSON value is not a number");
+		return number;
+	}
+	int as_int() const {
+		return round(as_float());
+	}
+	bool as_bool() const {
+		if (type == Type::string) return str == "True" || str == "true";
+		return as_float() != 0;
+	}
+	string as_string() const {
+		if (type == Type::number) return dump();
+		if (type != Type::string) throw std::runtime_error("JSON value is not a string");
+		return str;
+	}
+	map<string, float> as_float_map() const {
+		map<string, float> values;
+		for (auto& [key, value] : object) values[key] = value.as_float();
+		return values;
+	}
+	map<string, map<string, float>> as_nested_float_map() const {
+		map<string, map<string, float>> values;
+		for (auto& [key, value] : object) values[key] = value.as_float_map();
+		return values;
+	}
+	vector<float> as_float_vector() const {
+		vector<float> values;
+		for (auto& value : array) values.push_back(value.as_float());
+		return values;
+	}
+	string dump() const {
+		// Serialize without whitespace.
+		if (type == Type::null) return "null";
+		if (type == Type::boolean) return boolean ? "true" : "false";
+		if (type == Type::number) {
+			char buffer[32];
+			if (number == floor(number) && abs(number) < 1e15) snprintf(buffer, sizeof(buffer), "%.0f", number); // Exact integers
+			else snprintf(buffer, sizeof(buffer), "%.9g", number);
+			return buffer;
+		}
+		if (type == Type::string) return quote(str);
+		string text = (type == Type::array) ? "[" : "{";
+		for (int i = 0; i < (type == Type::array ? array.size() : object.size()); i++) {
+			if (i > 0) text += ",";
+			if (type == Type::array) text += array[i].dump();
+			else text += quote(object[i].first) + ":" + object[i].second.dump();
+		}
+		return text + ((type == Type::array) ? "]" : "}");
+	}
+	static string quote(const string& text) {
+		string quoted = "\"";
+		for (char c : text) {
+			if (c == '"' || c == '\\') quoted += '\\';
+			if (c == '\n') quoted += "\\n";
+			else quoted += c;
+		}
+		return quoted + "\"";
+	}
+	Type type = Type::null;
+	bool boolean = false;
+	double number = 0;
+	string str;
+	vector<JsonValue> array;
+	vector<pair<string, JsonValue>> object;
+
+private:
+	const JsonValue* find(const string& key) const {
+		for (auto& [_key, value] : object) {
+			if (_key == key) return &value;
+		}
+		return nullptr;
+	}
+	static void skip_whitespace(const string& text, size_t& pos) {
+		while (pos < text.size() && isspace((unsigned char)text[pos])) pos++;
+	}
+	static void expect(const string& text, size_t& pos, char c) {
+		skip_whitespace(text, pos);
+		if (pos >= text.size() || text[pos] != c) {
+			throw std::runtime_error(string("Expected '") + c + "' in JSON at position " + to_string(pos));
+		}
+		pos++;
+	}
+	static JsonValue parse_value(const string& text, size_t& pos) {
+		skip_whitespace(text, pos);
+		if (pos >= text.size()) throw std::runtime_error("Unexpected end of JSON");
+		char c = text[pos];
+		if (c == '{') return parse_object(text, pos);
+		if (c == '[') return parse_array(text, pos);
+		if (c == '"') return JsonValue(parse_string(text, pos));
+		if (text.compare(pos, 4, "true") == 0) { pos += 4; return JsonValue(true); }
+		if (text.compare(pos, 5, "false") == 0) { pos += 5; return JsonValue(false); }
+		if (text.compare(pos, 4, "null") == 0) { pos += 4; return JsonValue(); }
+		char* end = nullptr;
+		double number = strtod(text.c_str() + pos, &end);
+		if (end == text.c_str() + pos) throw std::runtime_error("Invalid JSON value at position " + to_string(pos));
+		pos = end - text.c_str();
+		return JsonValue(number);
+	}
+	static JsonValue parse_object(const string& text, size_t& pos) {
+		JsonValue value;
+		value.type = Type::object;
+		expect(text, pos, '{');
+		skip_whitespace(text, pos);
+		if (pos < text.size() && text[pos] == '}') {
+			pos++;
+			return value;
+		}
+		while (true) {
+			skip_whitespace(text, pos);
+			string key = parse_string(text, pos);
+			expect(text, pos, ':');
+			value.object.push_back(pair<string, JsonValue>(key, parse_value(text, pos)));
+			skip_whitespace(text, pos);
+			if (pos < text.size() && text[pos] == ',') {
+				pos++;
+				continue;
+			}
+			expect(text, pos, '}');
+			return value;
+		}
+	}
+	static JsonValue parse_array(const string& text, size_t& pos) {
+		JsonValue value;
+		value.type = Type::array;
+		expect(text, pos, '[');
+		skip_whitespace(text, pos);
+		if (pos < text.size() && text[pos] == ']') {
+			pos++;
+			return value;
+		}
+		while (true) {
+			value.array.push_back(parse_value(text, pos));
+			skip_whitespace(text, pos);
+			if (pos < text.size() && text[pos] == ',') {
+				pos++;
+				continue;
+			}
+			expect(text, pos, ']');
+			return value;
+		}
+	}
+	static string parse_string(const string& text, size_t& pos) {
+		expect(text, pos, '"');
+		string result;
+		while (pos < text.size() && text[pos] != '"') {
+			char c = text[pos++];
+			if (c == '\\' && pos < text.size()) {
+				char escaped = text[pos++];
+				if (escaped == 'n') result += '\n';
+				else if (escaped == 't') result += '\t';
+				else if (escaped == 'u') pos += 4; // Unicode escapes are not used in the parameter files.
+				else result += escaped;
+			}
+			else result += c;
+		}
+		expect(text, pos, '"');
+		return result;
+	}
+};
@@ -5,6 +5,16 @@
 using namespace help;
 
 
+// Dispersal vectors, in the order in which they are encoded in the 'vector' trait distribution.
+enum class DispersalVector { linear = 0, wind = 1, animal = 2 };
+
+inline string get_vector_name(DispersalVector vector) {
+	if (vector == DispersalVector::wind) return "wind";
+	else if (vector == DispersalVector::animal) return "animal";
+	return "linear";
+}
+
+
 class LinearDiffusionKernel : public LinearProbabilityModel {
 public:
 	LinearDiffusionKernel() = default;
@@ -60,34 +70,45 @@ public:
 };
 
 
-class Kernel : public LinearDiffusionKernel, public WindKernel {
+class Kernel {
+	// Tagged kernel: only the payload belonging to the kernel's dispersal vector is stored.
 public:
 	Kernel() = default;
 	Kernel(int _tree_id, float _q1, float _q2, float _min, float _max) :
-		LinearDiffusionKernel(_q1, _q2, _min, _max)
+		payload(LinearDiffusionKernel(_q1, _q2, _min, _max)), type(DispersalVector::linear)
 	{
 		id = _tree_id;
-		type = "linear";
 	}
 	Kernel(int _tree_id, float _dist_max, float _wspeed_gmean, float _wspeed_stdev, float _wind_direction, float _wind_direction_stdev, float _seed_tspeed = 0, float _abs_height = 0) :
-		WindKernel(_dist_max, _wspeed_gmean, _wspeed_stdev, _wind_direction, _wind_direction_stdev, _seed_tspeed, _abs_height)
+		payload(WindKernel(_dist_max, _wspeed_gmean, _wspeed_stdev, _wind_direction, _wind_direction_stdev, _seed_tspeed, _abs_height)),
+		type(DispersalVector::wind)
 	{
 		id = _tree_id;
-		type = "wind";
 	}
-	Kernel(int _tree_id, string _type) : type(_type), id(_tree_id) {
+	Kernel(int _tree_id, DispersalVector _type) : payload(monostate()), type(_type), id(_tree_id) {
 		// Arbitrary kernel without built-in functionality, currently only used for animal dispersal
 	}
+	LinearDiffusionKernel& linear() {
+		return std::get<LinearDiffusionKernel>(payload);
+	}
+	WindKernel& wind() {
+		return std::get<WindKernel>(payload);
+	}
 	float get_ld_dist() {
-		return LinearDiffusionKernel::get_ld_dist();
+		return linear().get_ld_dist();
 	}
 	float get_wind_dispersed_dist() {
-		return WindKernel::get_wind_dispersed_dist();
+		return wind().get_wind_dispersed_dist();
 	}
 	float get_dist() {
-		if (type == "linear") return get_ld_dist();
-		else if (type == "wind") return get_wind_dispersed_dist();
+		if (type == DispersalVector::linear) return get_ld_dist();
+		else if (type == DispersalVector::wind) return get_wind_dispersed_dist();
+		return 0;
+	}
+	void build() {
+		if (type == DispersalVector::wind) wind().build();
 	}
+	variant<monostate, LinearDiffusionKernel, WindKernel> payload = LinearDiffusionKernel(); // Matches the default type.
+	DispersalVector type = DispersalVector::linear;
 	int id = -1;
-	string type = "none";
-};
+};
\ No newline at end of file
@@ -0,0 +1,138 @@
+#pragma once
+#include <cstdio>
+#include <cstdarg>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+
+
+enum class LogLevel : int {
+	silent = 0,
+	error = 1,
+	warning = 2,
+	info = 3,	// Per-timestep summaries (the default).
+	debug = 4,	// Progress within a timestep (verbosity 1).
+	trace = 5	// Per-tree messages (verbosity 2).
+};
+
+// Messages above this level are compiled out (e.g. build with -DDBR_MAX_LOG_LEVEL=2 to keep only errors and warnings).
+#ifndef DBR_MAX_LOG_LEVEL
+#define DBR_MAX_LOG_LEVEL 5
+#endif
+
+// Log a printf-style message to <logger> at <level>. The arguments are only evaluated if the message is compiled in and the
+// logger's level includes it, so that disabled messages cost a single comparison.
+#define DBR_LOG(logger, level, ...) \
+	do { \
+		if constexpr ((int)(level) <= DBR_MAX_LOG_LEVEL) { \
+			if ((logger).is_enabled(level)) (logger).write(level, __VA_ARGS__); \
+		} \
+	} while (0)
+
+inline LogLevel get_log_level(std::string name) {
+	if (name == "silent") return LogLevel::silent;
+	if (name == "error") return LogLevel::error;
+	if (name == "warning") return LogLevel::warning;
+	if (name == "info") return LogLevel::info;
+	if (name == "debug") return LogLevel::debug;
+	if (name == "trace") return LogLevel::trace;
+	throw std::runtime_error("Unknown log level '" + name + "' (use silent, error, warning, info, debug or trace).");
+}
+
+inline std::string get_log_level_name(LogLevel level) {
+	const char* names[] = { "silent", "error", "warning", "info", "debug", "trace" };
+	return names[(int)level];
+}
+
+inline LogLevel get_log_level(int verbosity) {
+	// Log level corresponding to the verbosity parameter of the simulation.
+	if (verbosity >= 2) return LogLevel::trace;
+	if (verbosity == 1) return LogLevel::debug;
+	return LogLevel::info;
+}
+
+
+class LogMetric {
+public:
+	int time = 0;
+	std::string name;
+	double value = 0;
+};
+
+
+class Logger {
+public:
+	// Log of a single simulation run. Messages are collected in a buffer that is written to stdout in one piece by flush(), which the
+	// simulation calls after every timestep, so that many simulations running in parallel do not contend for the console line by line.
+	// Errors and warnings are written immediately. The last <ring_size> messages are kept in memory regardless of <echo>, for
+	// inspection after a failure. Values that are only of interest as numbers (counts of dead trees, animal moves, ...) go to the
+	// metrics channel instead, which stores them without formatting once <record_metrics> is set.
+	// A logger is used by a single thread at a time, like the simulation that owns it.
+	bool is_enabled(LogLevel _level) const {
+		return _level <= level;
+	}
+	void write(LogLevel _level, const char* format, ...) {
+		char message[1024];
+		va_list args;
+		va_start(args, format);
+		int length = vsnprintf(message, sizeof(message), format, args);
+		va_end(args);
+		if (length < 0) return;
+		length = (std::min)(length, (int)sizeof(message) - 1);
+		if (ring_size > 0) {
+			if (ring.size() < ring_size) ring.emplace_back(message, length);
+			else {
+				ring[ring_begin].assign(message, length);
+				ring_begin = (ring_begin + 1) % ring.size();
+			}
+		}
+		if (!echo) return;
+		pending.append(message, length);
+		if (!buffered || _level <= LogLevel::warning || pending.size() > max_pending_size) flush();
+	}
+	void flush() {
+		if (pending.empty()) return;
+		fwrite(pending.data(), 1, pending.size(), stdout);
+		fflush(stdout);
+		pending.clear();
+	}
+	void metric(const std::string& name, double value) {
+		// Record <value> under <name> for the current timestep.
+		if (record_metrics) metrics.push_back({ time, name, value });
+	}
+	void metric(const char* name, double value) {
+		// As above, but without constructing the name unless it is recorded.
+		if (record_metrics) metrics.push_back({ time, name, value });
+	}
+	std::vector<std::string> get_recent_messages() const {
+		// The messages kept in the ring buffer, oldest first.
+		std::vector<std::string> messages;
+		for (size_t i = 0; i < ring.size(); i++) messages.push_back(ring[(ring_begin + i) % ring.size()]);
+		return messages;
+	}
+	size_t get_memory_size() const {
+		size_t bytes = pending.capacity() + metrics.capacity() * sizeof(LogMetric);
+		for (const std::string& message : ring) bytes += sizeof(std::string) + message.capacity();
+		return bytes;
+	}
+	void clear() {
+		pending.clear();
+		ring.clear();
+		ring_begin = 0;
+		metrics.clear();
+	}
+	LogLevel level = LogLevel::info;
+	bool echo = true;					// Write messages to stdout (otherwise they are only kept in the ring buffer).
+	bool buffered = true;				// Collect messages until flush() instead of writing each one.
+	size_t ring_size = 256;
+	size_t max_pending_size = 1 << 16;	// Buffered output is written early when it exceeds this number of bytes.
+	bool record_metrics = false;		// Off by default, as every run would otherwise store a named entry per metric per timestep.
+	int time = 0;						// Timestep attached to recorded metrics (set by the simulation).
+	std::vector<LogMetric> metrics;
+
+private:
+	std::string pending;
+	std::vector<std::string> ring;
+	size_t ring_begin = 0;
+};
@@ -0,0 +1,185 @@
+#pragma once
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <signal.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+class MappedFile {
+public:
+	// Read-only memory mapping of a file or named shared memory segment. The mapped pages are shared by all processes that map
+	// the same file or segment.
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() {
+		close();
+	}
+	bool open(const std::string& path) {
+		close();
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+			close();
+			return false;
+		}
+		_size = file_size.QuadPart;
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL) {
+			close();
+			return false;
+		}
+		_data = (char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd == -1) return false;
+		struct stat file_stats;
+		if (fstat(fd, &file_stats) == -1 || file_stats.st_size == 0) {
+			::close(fd);
+			return false;
+		}
+		_size = file_stats.st_size;
+		void* address = mmap(NULL, _size, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd); // The mapping remains valid after the descriptor is closed.
+		_data = (address == MAP_FAILED) ? nullptr : (char*)address;
+#endif
+		if (_data == nullptr) {
+			close();
+			return false;
+		}
+		return true;
+	}
+	bool open_shared_memory(const std::string& name, size_t size, bool& created) {
+		// Map a named shared memory segment of <size> bytes, creating it if it does not exist yet. Only the creating process
+		// maps the segment writable (see mutable_data()); other processes map it read-only.
+		close();
+		created = false;
+#ifdef _WIN32
+		mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)(size & 0xFFFFFFFF), name.c_str());
+		if (mapping == NULL) return false;
+		created = (GetLastError() != ERROR_ALREADY_EXISTS);
+		_data = (char*)MapViewOfFile(mapping, created ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, size);
+#else
+		int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+		if (fd != -1) {
+			created = true;
+			if (ftruncate(fd, size) == -1) {
+				::close(fd);
+				shm_unlink(name.c_str());
+				return false;
+			}
+		}
+		else {
+			fd = shm_open(name.c_str(), O_RDONLY, 0);
+			if (fd == -1) return false;
+
+			// Wait for the creating process to size the segment.
+			struct stat segment_stats;
+			for (int i = 0; fstat(fd, &segment_stats) == 0 && (size_t)segment_stats.st_size < size; i++) {
+				if (i == 100) {
+					::close(fd);
+					return false;
+				}
+				usleep(10000);
+			}
+		}
+		void* address = mmap(NULL, size, created ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		_data = (address == MAP_FAILED) ? nullptr : (char*)address;
+#endif
+		_size = size;
+		writable = created;
+		if (_data == nullptr) {
+			close();
+			return false;
+		}
+		return true;
+	}
+	static void remove_shared_memory(const std::string& name) {
+		// Named segments persist until removed on POSIX systems. On Windows they are released with the last handle.
+#ifndef _WIN32
+		shm_unlink(name.c_str());
+#endif
+	}
+	void close() {
+#ifdef _WIN32
+		if (_data != nullptr) UnmapViewOfFile(_data);
+		if (mapping != NULL) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (_data != nullptr) munmap((void*)_data, _size);
+#endif
+		_data = nullptr;
+		_size = 0;
+		writable = false;
+	}
+	static bool write(const std::string& path, const void* header, size_t header_size, const void* payload, size_t payload_size) {
+		// Write to a temporary file first and then move it into place, so that concurrent readers never map a partially written file.
+		std::string tmp_path = path + ".tmp" + std::to_string(get_process_id());
+		FILE* file = fopen(tmp_path.c_str(), "wb");
+		if (file == nullptr) return false;
+		bool success = (fwrite(header, 1, header_size, file) == header_size);
+		success = success && (fwrite(payload, 1, payload_size, file) == payload_size);
+		success = (fclose(file) == 0) && success;
+		std::error_code error;
+		if (success) std::filesystem::rename(tmp_path, path, error);
+		if (!success || error) {
+			std::filesystem::remove(tmp_path, error);
+			return false;
+		}
+		return true;
+	}
+	const char* data() const {
+		return _data;
+	}
+	char* mutable_data() {
+		return writable ? _data : nullptr;
+	}
+	size_t size() const {
+		return _size;
+	}
+	bool is_open() const {
+		return _data != nullptr;
+	}
+	static unsigned long get_process_id() {
+#ifdef _WIN32
+		return GetCurrentProcessId();
+#else
+		return getpid();
+#endif
+	}
+	static bool is_process_alive(unsigned long pid) {
+#ifdef _WIN32
+		HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)pid);
+		if (process == NULL) return false;
+		bool alive = (WaitForSingleObject(process, 0) == WAIT_TIMEOUT);
+		CloseHandle(process);
+		return alive;
+#else
+		return kill((pid_t)pid, 0) == 0 || errno == EPERM;
+#endif
+	}
+private:
+	char* _data = nullptr;
+	size_t _size = 0;
+	bool writable = false;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#endif
+};
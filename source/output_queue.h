@@ -0,0 +1,122 @@
+#pragma once
+#include <condition_variable>
+#include "dynamics.h"
+
+
+class OutputQueue {
+public:
+	// Runs output jobs (file writes, compression, ...) in submission order on a background thread, so that the simulation can
+	// continue with the next timestep while the output of the previous one is written. Jobs should only use data they own, such
+	// as a StepSnapshot, never the live simulation state. At most <max_pending_jobs> jobs are queued; push() blocks while the
+	// queue is full. If a job throws, the remaining jobs are discarded and the error is rethrown by the next push(), flush() or close().
+	OutputQueue(int _max_pending_jobs = 4) {
+		max_pending_jobs = max(_max_pending_jobs, 1);
+		worker = thread(&OutputQueue::run_jobs, this);
+	}
+	OutputQueue(const OutputQueue&) = delete;
+	OutputQueue& operator=(const OutputQueue&) = delete;
+	~OutputQueue() {
+		// Pending output is still written when the queue goes out of scope.
+		try {
+			close();
+		}
+		catch (std::exception& error) {
+			printf("Error while writing output: %s\n", error.what());
+		}
+	}
+	void push(function<void()> job) {
+		unique_lock<mutex> lock(queue_mutex);
+		space_available.wait(lock, [this] { return jobs.size() < max_pending_jobs || error != ""; });
+		if (error != "") throw std::runtime_error(error);
+		if (closed) throw std::runtime_error("Output queue is closed.");
+		jobs.push(std::move(job));
+		job_available.notify_one();
+	}
+	void flush() {
+		// Wait until all queued jobs have finished.
+		unique_lock<mutex> lock(queue_mutex);
+		space_available.wait(lock, [this] { return (jobs.empty() && !busy) || error != ""; });
+		if (error != "") throw std::runtime_error(error);
+	}
+	void close() {
+		// Finish all queued jobs and stop the background thread.
+		{
+			lock_guard<mutex> lock(queue_mutex);
+			if (closed) return;
+			closed = true;
+		}
+		job_available.notify_one();
+		worker.join();
+		if (error != "") throw std::runtime_error(error);
+	}
+	int get_no_pending_jobs() {
+		lock_guard<mutex> lock(queue_mutex);
+		return jobs.size() + busy;
+	}
+	int max_pending_jobs = 0;
+
+private:
+	void run_jobs() {
+		while (true) {
+			function<void()> job;
+			{
+				unique_lock<mutex> lock(queue_mutex);
+				job_available.wait(lock, [this] { return !jobs.empty() || closed; });
+				if (jobs.empty()) return;
+				job = std::move(jobs.front());
+				jobs.pop();
+				busy = true;
+			}
+			string job_error = "";
+			try {
+				job();
+			}
+			catch (std::exception& exception) {
+				job_error = exception.what();
+			}
+			lock_guard<mutex> lock(queue_mutex);
+			busy = false;
+			if (job_error != "") {
+				error = job_error;
+				jobs = {};
+			}
+			space_available.notify_all();
+		}
+	}
+	queue<function<void()>> jobs;
+	mutex queue_mutex;
+	condition_variable job_available;
+	condition_variable space_available;
+	bool busy = false;
+	bool closed = false;
+	string error = "";
+	thread worker;
+};
+
+
+class StepSnapshot {
+public:
+	// Immutable copy of the simulation output of a single timestep, to be handed to an OutputQueue job.
+	StepSnapshot() = default;
+	StepSnapshot(Dynamics& dynamics, bool include_tree_table = false, bool include_state_distribution = false) {
+		time = dynamics.time;
+		metrics = dynamics.get_metrics();
+		if (include_tree_table) {
+			no_trees = dynamics.pop->size();
+			shared_ptr<float[]> table = make_shared<float[]>(no_trees * no_values_per_tree);
+			dynamics.state.get_state_table(table.get());
+			tree_table = table;
+		}
+		if (include_state_distribution) {
+			grid_width = dynamics.grid->width;
+			state_distribution = help::copy_array(dynamics.grid->state_distribution, dynamics.grid->no_cells);
+		}
+	}
+	int time = 0;
+	vector<pair<string, float>> metrics;
+	int no_trees = 0;
+	static const int no_values_per_tree = 4; // id, x, y, dbh (see State::get_state_table()).
+	shared_ptr<const float[]> tree_table = 0;
+	int grid_width = 0;
+	shared_ptr<const int[]> state_distribution = 0;
+};
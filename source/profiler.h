@@ -0,0 +1,282 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+class PerfCounters {
+public:
+	// Hardware event counters of the calling thread, read with perf_event_open(2). The counters are opened as one group, so that
+	// they all cover the same instructions. open() returns false if no counter can be used (on other platforms than Linux, in virtual
+	// machines without a PMU, or when /proc/sys/kernel/perf_event_paranoid forbids it); a counter that the CPU does not support
+	// reads as -1. Only events in user space are counted. Threads started by the calling thread are not counted, so neither are the
+	// workers of threaded animal dispersal (animal_dispersal_threads > 1) or of the lookup table computation.
+	static const int no_counters = 4;
+	static constexpr const char* names[no_counters] = { "cycles", "instructions", "llc_misses", "branch_misses" };
+	PerfCounters() = default;
+	PerfCounters(const PerfCounters&) {} // Copies (e.g. of a Dynamics object) start closed; the counters belong to the original.
+	PerfCounters& operator=(const PerfCounters& other) {
+		if (this != &other) close();
+		return *this;
+	}
+	~PerfCounters() {
+		close();
+	}
+	bool open() {
+		close();
+#ifdef __linux__
+		const uint64_t events[no_counters] = {
+			PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+		};
+		for (int i = 0; i < no_counters; i++) {
+			perf_event_attr attributes;
+			memset(&attributes, 0, sizeof(attributes));
+			attributes.size = sizeof(attributes);
+			attributes.type = PERF_TYPE_HARDWARE;
+			attributes.config = events[i];
+			attributes.disabled = (leader == -1);
+			attributes.exclude_kernel = 1;
+			attributes.exclude_hv = 1;
+			attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+			int fd = syscall(SYS_perf_event_open, &attributes, 0, -1, leader, 0);
+			if (fd == -1) continue;
+			if (leader == -1) leader = fd;
+			fds[i] = fd;
+			group_index[i] = no_open++;
+		}
+		if (leader == -1) return false;
+		ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+		return true;
+#else
+		return false;
+#endif
+	}
+	void close() {
+#ifdef __linux__
+		for (int i = 0; i < no_counters; i++) {
+			if (fds[i] != -1) ::close(fds[i]);
+			fds[i] = -1;
+			group_index[i] = -1;
+		}
+#endif
+		leader = -1;
+		no_open = 0;
+	}
+	bool read(int64_t* values) {
+		// Write the current value of each counter to <values> (an array of no_counters elements). If the group had to share the PMU
+		// with other events, the values are scaled up to the time it was enabled.
+		for (int i = 0; i < no_counters; i++) values[i] = -1;
+		if (leader == -1) return false;
+#ifdef __linux__
+		uint64_t buffer[3 + no_counters];
+		if (::read(leader, buffer, sizeof(buffer)) < (ssize_t)((3 + no_open) * sizeof(uint64_t))) return false;
+		double scale = (buffer[2] > 0 && buffer[2] < buffer[1]) ? (double)buffer[1] / buffer[2] : 1.0;
+		for (int i = 0; i < no_counters; i++) {
+			if (group_index[i] != -1) values[i] = buffer[3 + group_index[i]] * scale;
+		}
+		return true;
+#else
+		return false;
+#endif
+	}
+	bool is_open() {
+		return leader != -1;
+	}
+	bool is_supported(int counter) {
+		return fds[counter] != -1;
+	}
+
+private:
+	int fds[no_counters] = { -1, -1, -1, -1 };
+	int group_index[no_counters] = { -1, -1, -1, -1 }; // Position of each counter in the values read from the group.
+	int leader = -1;
+	int no_open = 0;
+};
+
+
+class Profiler {
+public:
+	// Hierarchical phase timer. Phases are marked with ScopedPhase objects; a phase that starts while another one is running becomes
+	// its child, so that the same name can occur in different places of the hierarchy (its path, e.g. "dispersal/wind/germination",
+	// is unique). For every phase, the number of calls and the total and maximum duration are kept per timestep (between begin_step()
+	// and end_step()) and over the whole run. Optionally, every call is also recorded as a trace event that can be written in the
+	// Chrome trace format (chrome://tracing or https://ui.perfetto.dev). After enable_counters(), the hardware counters of
+	// PerfCounters are summed over the calls of each phase in the same way; these cover the owning thread only (see PerfCounters).
+	// A profiler is used by a single thread, that of the simulation that owns it. It is disabled by default, since some phases (e.g.
+	// "grow/shade") are entered once per tree; a disabled ScopedPhase costs a single comparison.
+	struct Phase {
+		const char* name = nullptr;
+		std::string path;
+		int parent = -1;
+		int depth = 0;
+		std::vector<int> children;
+		int64_t calls = 0;
+		int64_t total_ns = 0;
+		int64_t max_ns = 0;
+		int64_t step_calls = 0;
+		int64_t step_total_ns = 0;
+		int64_t step_max_ns = 0;
+		int64_t counts[PerfCounters::no_counters] = {};
+		int64_t step_counts[PerfCounters::no_counters] = {};
+	};
+	struct StepRecord {
+		int time = 0;
+		int phase = 0;
+		int64_t calls = 0;
+		int64_t total_ns = 0;
+		int64_t max_ns = 0;
+		int64_t counts[PerfCounters::no_counters] = {};
+	};
+	struct TraceEvent {
+		int phase = 0;
+		int time = 0;
+		int64_t begin_ns = 0;
+		int64_t duration_ns = 0;
+	};
+	bool enabled = false;
+	bool tracing = false;
+	size_t max_trace_events = 1000000; // Trace events beyond this number are dropped.
+
+	int begin(const char* name) {
+		// Enter the phase <name> as a child of the current phase, and return its index.
+		int parent = current;
+		std::vector<int>& siblings = (parent == -1) ? roots : phases[parent].children;
+		int idx = -1;
+		for (int sibling : siblings) {
+			if (phases[sibling].name == name || strcmp(phases[sibling].name, name) == 0) {
+				idx = sibling;
+				break;
+			}
+		}
+		if (idx == -1) {
+			idx = phases.size();
+			Phase phase;
+			phase.name = name;
+			phase.parent = parent;
+			phase.depth = (parent == -1) ? 0 : phases[parent].depth + 1;
+			phase.path = (parent == -1) ? std::string(name) : phases[parent].path + "/" + name;
+			phases.push_back(phase);
+			((parent == -1) ? roots : phases[parent].children).push_back(idx);
+		}
+		current = idx;
+		return idx;
+	}
+	void end(int idx, int64_t begin_ns, int64_t end_ns, bool traced = true, const int64_t* counts = nullptr) {
+		Phase& phase = phases[idx];
+		int64_t duration = end_ns - begin_ns;
+		phase.step_calls++;
+		phase.step_total_ns += duration;
+		phase.step_max_ns = (std::max)(phase.step_max_ns, duration);
+		if (counts != nullptr) for (int i = 0; i < PerfCounters::no_counters; i++) phase.step_counts[i] += counts[i];
+		current = phase.parent;
+		if (tracing && traced && trace.size() < max_trace_events) trace.push_back({ idx, time, begin_ns, duration });
+	}
+	void begin_step(int _time) {
+		time = _time;
+	}
+	void end_step() {
+		// Store the statistics of the timestep that just ended and start those of the next one.
+		for (int i = 0; i < phases.size(); i++) {
+			Phase& phase = phases[i];
+			if (phase.step_calls == 0) continue;
+			StepRecord step = { time, i, phase.step_calls, phase.step_total_ns, phase.step_max_ns };
+			for (int j = 0; j < PerfCounters::no_counters; j++) {
+				step.counts[j] = phase.step_counts[j];
+				phase.counts[j] += phase.step_counts[j];
+				phase.step_counts[j] = 0;
+			}
+			steps.push_back(step);
+			phase.calls += phase.step_calls;
+			phase.total_ns += phase.step_total_ns;
+			phase.max_ns = (std::max)(phase.max_ns, phase.step_max_ns);
+			phase.step_calls = phase.step_total_ns = phase.step_max_ns = 0;
+		}
+	}
+	bool enable_counters() {
+		// Start counting hardware events of the calling thread, which should be the one that runs the simulation. Returns false if
+		// the counters are not available, in which case only times are recorded.
+		return counters.open();
+	}
+	void disable_counters() {
+		counters.close();
+	}
+	void reset() {
+		phases.clear();
+		roots.clear();
+		steps.clear();
+		trace.clear();
+		current = -1;
+	}
+	void write_chrome_trace(std::string path) {
+		// Write the trace events as complete ("X") events. Timestamps are in microseconds since the program started.
+		FILE* file = fopen(path.c_str(), "w");
+		if (file == nullptr) throw std::runtime_error("Could not write trace to " + path);
+		fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+		for (size_t i = 0; i < trace.size(); i++) {
+			TraceEvent& event = trace[i];
+			fprintf(file, "%s{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 0, \"tid\": 0, \"args\": {\"time\": %i}}",
+				(i == 0) ? "" : ",\n", phases[event.phase].name, phases[event.phase].path.c_str(), event.begin_ns / 1000.0, event.duration_ns / 1000.0, event.time
+			);
+		}
+		fprintf(file, "\n]}\n");
+		if (fclose(file) != 0) throw std::runtime_error("Could not write trace to " + path);
+	}
+	static int64_t now() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+	}
+	std::vector<Phase> phases;
+	std::vector<int> roots;
+	std::vector<StepRecord> steps;
+	std::vector<TraceEvent> trace;
+	PerfCounters counters;
+
+private:
+	inline static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	int current = -1;
+	int time = 0;
+};
+
+
+class ScopedPhase {
+public:
+	// Times the enclosing scope as phase <name> of <profiler>. <name> must outlive the profiler (use string literals). Phases that
+	// are entered very often (e.g. once per tree) can be excluded from the trace and the hardware counters with <detailed> = false;
+	// their calls and times are still recorded.
+	ScopedPhase(Profiler& _profiler, const char* name, bool _detailed = true) : profiler(_profiler), detailed(_detailed) {
+		if (!profiler.enabled) return;
+		idx = profiler.begin(name);
+		counting = detailed && profiler.counters.read(begin_counts);
+		begin_ns = Profiler::now();
+	}
+	ScopedPhase(const ScopedPhase&) = delete;
+	ScopedPhase& operator=(const ScopedPhase&) = delete;
+	~ScopedPhase() {
+		if (idx == -1) return;
+		int64_t end_ns = Profiler::now();
+		int64_t counts[PerfCounters::no_counters];
+		if (counting && profiler.counters.read(counts)) {
+			for (int i = 0; i < PerfCounters::no_counters; i++) counts[i] = (counts[i] == -1) ? 0 : counts[i] - begin_counts[i];
+			profiler.end(idx, begin_ns, end_ns, detailed, counts);
+		}
+		else profiler.end(idx, begin_ns, end_ns, detailed);
+	}
+
+private:
+	Profiler& profiler;
+	bool detailed = true;
+	bool counting = false;
+	int idx = -1;
+	int64_t begin_ns = 0;
+	int64_t begin_counts[PerfCounters::no_counters];
+};
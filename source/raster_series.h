@@ -0,0 +1,357 @@
+#pragma once
+#include "output_queue.h"
+#include "mapped_file.h"
+#include "compression.h"
+
+
+// Compressed time series of grid rasters, written while a simulation runs.
+//
+// A raster series file consists of a RasterSeriesHeader, one RasterLayer descriptor per layer and a sequence of frames. Each frame
+// holds a RasterFrameHeader followed by, for every layer, the 64-bit size of its compressed data and the data itself. Every
+// <keyframe_interval>'th frame is a keyframe that stores the layers as they are; the frames in between store the bytewise XOR with
+// the previous frame, which is mostly zeros as only a small part of the grid changes per timestep. Both are compressed with LZCodec.
+// When the writer is closed, an index with the offset and time of each frame is appended, followed by a RasterSeriesFooter. The
+// reader uses the index for random access; if the footer is missing (e.g. because the run was interrupted), it scans the frames.
+//
+// Available layers:
+//   "state"  int32    The grid's state distribution, including fire (-5) and tree death (-6) markers (see Grid::get_state_distribution()).
+//   "cover"  uint8    Cell state (0 = savanna, 1 = forest).
+//   "LAI"    float32  Leaf area index of the cell.
+//   "fire"   uint8    1 if the cell burned during the last timestep, 0 otherwise.
+
+
+class RasterSeriesHeader {
+public:
+	char magic[8] = { 'D', 'B', 'R', 'R', 'A', 'S', 'T', '0' };
+	uint32_t version = 1;
+	uint32_t byte_order = 0x01020304;
+	int32_t width = 0;
+	int32_t height = 0;
+	uint32_t no_layers = 0;
+	uint32_t keyframe_interval = 0;
+};
+
+
+class RasterLayer {
+public:
+	enum Type : uint32_t { int32 = 0, uint8 = 1, float32 = 2 };
+	char name[16] = {};
+	Type type = uint8;
+	size_t get_value_size() const {
+		return (type == uint8) ? 1 : 4;
+	}
+};
+
+
+class RasterFrameHeader {
+public:
+	int32_t time = 0;
+	uint32_t is_keyframe = 0;
+};
+
+
+class RasterSeriesFooter {
+public:
+	uint64_t index_offset = 0;
+	uint64_t no_frames = 0;
+	char magic[8] = { 'D', 'B', 'R', 'R', 'I', 'D', 'X', '0' };
+};
+
+
+class RasterSeriesWriter {
+public:
+	// Frames are snapshotted on the calling thread and compressed and written to disk by an OutputQueue. At most
+	// <max_pending_frames> snapshots are held in memory; add_frame() blocks while that many are waiting to be written.
+	RasterSeriesWriter(string _path, int _width, vector<string> layer_names = { "state", "cover", "LAI", "fire" }, int _keyframe_interval = 16,
+		int max_pending_frames = 4
+	) : output_queue(max_pending_frames) {
+		path = _path;
+		width = _width;
+		keyframe_interval = max(_keyframe_interval, 1);
+		for (string& name : layer_names) layers.push_back(create_layer(name));
+		previous.resize(layers.size());
+		file = fopen(path.c_str(), "wb");
+		if (file == nullptr) throw std::runtime_error("Could not write raster series to " + path);
+		RasterSeriesHeader header;
+		header.width = width;
+		header.height = width;
+		header.no_layers = layers.size();
+		header.keyframe_interval = keyframe_interval;
+		write(&header, sizeof(header));
+		write(layers.data(), sizeof(RasterLayer) * layers.size());
+	}
+	RasterSeriesWriter(const RasterSeriesWriter&) = delete;
+	RasterSeriesWriter& operator=(const RasterSeriesWriter&) = delete;
+	~RasterSeriesWriter() {
+		try {
+			close();
+		}
+		catch (std::exception& error) {
+			printf("Error while closing raster series %s: %s\n", path.c_str(), error.what());
+		}
+	}
+	void add_frame(Dynamics& dynamics) {
+		if (file == nullptr) throw std::runtime_error("Raster series " + path + " is closed.");
+		if (dynamics.grid->width != width) throw std::runtime_error("Grid width does not match that of the raster series.");
+		shared_ptr<Frame> frame = make_shared<Frame>();
+		frame->time = dynamics.time;
+		for (auto& layer : layers) frame->layers.push_back(snapshot(layer, dynamics));
+		output_queue.push([this, frame] { write_frame(*frame); });
+		no_frames++;
+	}
+	void close() {
+		// Write all pending frames and the index, and close the file.
+		if (file == nullptr) return;
+		try {
+			output_queue.close();
+			write_index();
+		}
+		catch (...) {
+			fclose(file);
+			file = nullptr;
+			throw;
+		}
+		bool success = (fclose(file) == 0);
+		file = nullptr;
+		if (!success) throw std::runtime_error("Could not write raster series to " + path);
+	}
+	int get_no_frames() {
+		return no_frames;
+	}
+	string path;
+	int width = 0;
+	int keyframe_interval = 0;
+	vector<RasterLayer> layers;
+
+private:
+	struct Frame {
+		int time = 0;
+		vector<vector<char>> layers;
+	};
+	static RasterLayer create_layer(string name) {
+		RasterLayer layer;
+		if (name == "state") layer.type = RasterLayer::int32;
+		else if (name == "cover" || name == "fire") layer.type = RasterLayer::uint8;
+		else if (name == "LAI") layer.type = RasterLayer::float32;
+		else throw std::runtime_error("Unknown raster layer: " + name);
+		memcpy(layer.name, name.c_str(), name.size());
+		return layer;
+	}
+	vector<char> snapshot(RasterLayer& layer, Dynamics& dynamics) {
+		Grid* grid = dynamics.grid;
+		string name = layer.name;
+		vector<char> data(grid->no_cells * layer.get_value_size());
+		if (name == "state") {
+			memcpy(data.data(), grid->state_distribution.get(), data.size());
+			return data;
+		}
+		for (int i = 0; i < grid->no_cells; i++) {
+			Cell& cell = grid->distribution[i];
+			if (name == "cover") data[i] = cell.state;
+			else if (name == "fire") data[i] = (cell.time_last_fire == dynamics.time);
+			else {
+				float LAI = cell.get_LAI();
+				memcpy(data.data() + i * sizeof(float), &LAI, sizeof(float));
+			}
+		}
+		return data;
+	}
+	void write_frame(Frame& frame) {
+		// Runs on the output queue's thread; frames are written in the order in which they were added.
+		RasterFrameHeader header;
+		header.time = frame.time;
+		header.is_keyframe = (index.size() % keyframe_interval == 0);
+		uint64_t frame_offset = offset;
+		write(&header, sizeof(header));
+		for (int i = 0; i < layers.size(); i++) {
+			vector<char>& data = frame.layers[i];
+			if (header.is_keyframe) LZCodec::compress(data.data(), data.size(), compressed);
+			else {
+				delta.resize(data.size());
+				for (size_t j = 0; j < data.size(); j++) delta[j] = data[j] ^ previous[i][j];
+				LZCodec::compress(delta.data(), delta.size(), compressed);
+			}
+			uint64_t size = compressed.size();
+			write(&size, sizeof(size));
+			write(compressed.data(), compressed.size());
+			previous[i].swap(data);
+		}
+		index.push_back({ frame_offset, frame.time });
+	}
+	void write(const void* bytes, size_t no_bytes) {
+		if (fwrite(bytes, 1, no_bytes, file) != no_bytes) throw std::runtime_error("Could not write raster series to " + path);
+		offset += no_bytes;
+	}
+	void write_index() {
+		RasterSeriesFooter footer;
+		footer.index_offset = offset;
+		footer.no_frames = index.size();
+		for (auto& [frame_offset, time] : index) {
+			write(&frame_offset, sizeof(frame_offset));
+			int64_t time_64 = time;
+			write(&time_64, sizeof(time_64));
+		}
+		write(&footer, sizeof(footer));
+	}
+	FILE* file = nullptr;
+	uint64_t offset = 0;
+	int no_frames = 0;
+	vector<pair<uint64_t, int>> index;
+	vector<vector<char>> previous;
+	vector<char> delta;
+	vector<char> compressed;
+	OutputQueue output_queue; // Declared last, so that its thread is stopped before the members it uses are destroyed.
+};
+
+
+class RasterSeriesReader {
+public:
+	RasterSeriesReader(string _path) {
+		path = _path;
+		if (!file.open(path)) throw std::runtime_error("Could not open raster series " + path);
+		if (file.size() < sizeof(RasterSeriesHeader)) throw std::runtime_error(path + " is not a raster series.");
+		memcpy(&header, file.data(), sizeof(header));
+		RasterSeriesHeader expected;
+		if (memcmp(header.magic, expected.magic, sizeof(expected.magic)) != 0) throw std::runtime_error(path + " is not a raster series.");
+		if (header.byte_order != expected.byte_order) throw std::runtime_error(path + " was written on a machine with a different byte order.");
+		if (header.version != expected.version) throw std::runtime_error("Unsupported raster series version in " + path);
+		size_t offset = sizeof(header);
+		if (file.size() < offset + sizeof(RasterLayer) * header.no_layers) throw std::runtime_error("Truncated raster series " + path);
+		layers.resize(header.no_layers);
+		memcpy(layers.data(), file.data() + offset, sizeof(RasterLayer) * header.no_layers);
+		offset += sizeof(RasterLayer) * header.no_layers;
+		if (!read_index()) scan_frames(offset);
+		cache.resize(layers.size());
+	}
+	int get_no_frames() {
+		return frames.size();
+	}
+	int get_no_layers() {
+		return layers.size();
+	}
+	int get_width() {
+		return header.width;
+	}
+	int get_height() {
+		return header.height;
+	}
+	vector<int> get_times() {
+		vector<int> times;
+		for (auto& frame : frames) times.push_back(frame.time);
+		return times;
+	}
+	vector<string> get_layer_names() {
+		vector<string> names;
+		for (auto& layer : layers) names.push_back(get_layer_name(layer));
+		return names;
+	}
+	int get_layer_index(string name) {
+		for (int i = 0; i < layers.size(); i++) {
+			if (get_layer_name(layers[i]) == name) return i;
+		}
+		throw std::runtime_error("Raster series " + path + " has no layer " + name);
+	}
+	const vector<char>& get_layer(int frame_idx, int layer_idx) {
+		// Decode the given layer of the given frame. Decoding starts at the nearest preceding keyframe, or continues from the last
+		// decoded frame if that is closer, so that reading the frames in order decodes each frame only once.
+		if (frame_idx < 0 || frame_idx >= frames.size()) throw std::runtime_error("Frame index out of range.");
+		if (layer_idx < 0 || layer_idx >= layers.size()) throw std::runtime_error("Layer index out of range.");
+		LayerCache& layer_cache = cache[layer_idx];
+		int first = frame_idx;
+		while (!frames[first].is_keyframe && first > 0) first--;
+		if (layer_cache.frame_idx >= first && layer_cache.frame_idx <= frame_idx) first = layer_cache.frame_idx + 1;
+		size_t size = (size_t)header.width * header.height * layers[layer_idx].get_value_size();
+		layer_cache.data.resize(size);
+		vector<char> delta(size);
+		for (int i = first; i <= frame_idx; i++) {
+			auto [compressed, compressed_size] = get_layer_data(i, layer_idx);
+			if (frames[i].is_keyframe) LZCodec::decompress(compressed, compressed_size, layer_cache.data.data(), size);
+			else {
+				LZCodec::decompress(compressed, compressed_size, delta.data(), size);
+				for (size_t j = 0; j < size; j++) layer_cache.data[j] ^= delta[j];
+			}
+			layer_cache.frame_idx = i;
+		}
+		return layer_cache.data;
+	}
+	template<typename T> vector<T> get_layer_values(int frame_idx, string name) {
+		int layer_idx = get_layer_index(name);
+		if (sizeof(T) != layers[layer_idx].get_value_size()) throw std::runtime_error("Value type does not match layer " + name);
+		const vector<char>& data = get_layer(frame_idx, layer_idx);
+		vector<T> values(data.size() / sizeof(T));
+		memcpy(values.data(), data.data(), data.size());
+		return values;
+	}
+	static string get_layer_name(const RasterLayer& layer) {
+		return string(layer.name, strnlen(layer.name, sizeof(layer.name)));
+	}
+	string path;
+	RasterSeriesHeader header;
+	vector<RasterLayer> layers;
+
+private:
+	struct FrameEntry {
+		uint64_t offset = 0;
+		int time = 0;
+		bool is_keyframe = false;
+	};
+	struct LayerCache {
+		int frame_idx = -1;
+		vector<char> data;
+	};
+	bool read_index() {
+		if (file.size() < sizeof(RasterSeriesFooter)) return false;
+		RasterSeriesFooter footer;
+		memcpy(&footer, file.data() + file.size() - sizeof(footer), sizeof(footer));
+		RasterSeriesFooter expected;
+		if (memcmp(footer.magic, expected.magic, sizeof(expected.magic)) != 0) return false;
+		uint64_t index_size = footer.no_frames * 2 * sizeof(int64_t);
+		if (footer.index_offset + index_size + sizeof(footer) != file.size()) return false;
+		const char* entry = file.data() + footer.index_offset;
+		for (uint64_t i = 0; i < footer.no_frames; i++, entry += 2 * sizeof(int64_t)) {
+			FrameEntry frame;
+			int64_t time;
+			memcpy(&frame.offset, entry, sizeof(frame.offset));
+			memcpy(&time, entry + sizeof(int64_t), sizeof(time));
+			frame.time = time;
+			if (frame.offset + sizeof(RasterFrameHeader) > footer.index_offset) throw std::runtime_error("Corrupt index in raster series " + path);
+			frame.is_keyframe = ((RasterFrameHeader*)(file.data() + frame.offset))->is_keyframe;
+			frames.push_back(frame);
+		}
+		return true;
+	}
+	void scan_frames(size_t offset) {
+		// Without an index, frames are located by walking the file; an incomplete last frame is ignored.
+		while (offset + sizeof(RasterFrameHeader) <= file.size()) {
+			RasterFrameHeader frame_header;
+			memcpy(&frame_header, file.data() + offset, sizeof(frame_header));
+			size_t end = offset + sizeof(frame_header);
+			for (int i = 0; i < layers.size() && end != 0; i++) {
+				uint64_t size;
+				if (end + sizeof(size) > file.size()) end = 0;
+				else {
+					memcpy(&size, file.data() + end, sizeof(size));
+					end = (size <= file.size() - end - sizeof(size)) ? end + sizeof(size) + size : 0;
+				}
+			}
+			if (end == 0) break;
+			frames.push_back({ offset, frame_header.time, (bool)frame_header.is_keyframe });
+			offset = end;
+		}
+	}
+	pair<const char*, size_t> get_layer_data(int frame_idx, int layer_idx) {
+		size_t offset = frames[frame_idx].offset + sizeof(RasterFrameHeader);
+		for (int i = 0; ; i++) {
+			uint64_t size;
+			if (offset + sizeof(size) > file.size()) throw std::runtime_error("Truncated raster series " + path);
+			memcpy(&size, file.data() + offset, sizeof(size));
+			offset += sizeof(size);
+			if (size > file.size() - offset) throw std::runtime_error("Truncated raster series " + path);
+			if (i == layer_idx) return { file.data() + offset, size };
+			offset += size;
+		}
+	}
+	MappedFile file;
+	vector<FrameEntry> frames;
+	vector<LayerCache> cache;
+};
@@ -0,0 +1,275 @@
+#pragma once
+#include "benchmark.h"
+
+
+class PowerLawFit {
+public:
+	// Least-squares fit of y = coefficient * x^exponent on a log-log scale. The exponent is the empirical complexity: 1 for work that
+	// grows linearly with x, 2 for quadratic work, and so on. Points with x <= 0 or y <= 0 are left out.
+	static PowerLawFit fit(const vector<double>& x, const vector<double>& y) {
+		PowerLawFit result;
+		vector<pair<double, double>> points;
+		for (size_t i = 0; i < x.size(); i++) {
+			if (x[i] > 0 && y[i] > 0) points.push_back({ log(x[i]), log(y[i]) });
+		}
+		result.no_points = points.size();
+		if (points.size() < 2) return result;
+		double mean_x = 0, mean_y = 0;
+		for (auto& [_x, _y] : points) {
+			mean_x += _x / points.size();
+			mean_y += _y / points.size();
+		}
+		double sxx = 0, sxy = 0, syy = 0;
+		for (auto& [_x, _y] : points) {
+			sxx += (_x - mean_x) * (_x - mean_x);
+			sxy += (_x - mean_x) * (_y - mean_y);
+			syy += (_y - mean_y) * (_y - mean_y);
+		}
+		if (sxx == 0) return result;
+		result.exponent = sxy / sxx;
+		result.coefficient = exp(mean_y - result.exponent * mean_x);
+		result.r_squared = (syy > 0) ? (sxy * sxy) / (sxx * syy) : 1;
+		result.valid = true;
+		return result;
+	}
+	double predict(double x) const {
+		return coefficient * pow(x, exponent);
+	}
+	JsonValue to_json() const {
+		JsonValue result;
+		result.set("exponent", exponent);
+		result.set("coefficient", coefficient);
+		result.set("r_squared", r_squared);
+		result.set("points", no_points);
+		return result;
+	}
+	double coefficient = 0;
+	double exponent = 0;
+	double r_squared = 0;
+	int no_points = 0;
+	bool valid = false;
+};
+
+
+class ScalingDimension {
+public:
+	// A swept parameter: "grid_width", "treecover" or "animal_density" (population.density of the animal dispersers, per km^2).
+	// Each dimension is fitted against a size measure that the work is expected to depend on: the number of grid cells, the
+	// population size after initialization and the number of animals, respectively.
+	string name;
+	vector<float> values;
+	string get_size_measure() const {
+		if (name == "grid_width") return "grid_cells";
+		if (name == "treecover") return "initial_population_size";
+		if (name == "animal_density") return "animals";
+		throw std::runtime_error("Unknown scaling dimension '" + name + "' (use grid_width, treecover or animal_density).");
+	}
+};
+
+
+class ScalingPoint {
+public:
+	// Measurements of one simulation in a scaling sweep. Times are means over the timed timesteps; memory is the largest amount in
+	// use after any timestep. <peak_resident_memory> is the peak of the whole process so far, which tracks the largest simulation
+	// because the points of a dimension are run in ascending order. That only holds for the first dimension of a study (a later
+	// dimension starts from the peak left by the ones before it), so it is only recorded there, and is 0 otherwise.
+	string dimension;
+	float value = 0;
+	map<string, double> measures;		// grid_cells, resource_cells, (initial_)population_size, animals, animal_moves (per timestep)
+	map<string, double> times_ms;		// "init", "step", "animal_move" (per move) and every profiler phase (per timestep)
+	map<string, double> memory_bytes;	// "total" and every subsystem of Dynamics::get_memory_usage()
+	double peak_resident_memory = 0;
+
+	JsonValue to_json() const {
+		JsonValue point;
+		point.set("value", (double)value);
+		JsonValue _measures, _times, _memory;
+		for (auto& [name, measure] : measures) _measures.set(name, measure);
+		for (auto& [name, time] : times_ms) _times.set(name, time);
+		for (auto& [name, bytes] : memory_bytes) _memory.set(name, bytes);
+		point.set("measures", _measures);
+		point.set("times_ms", _times);
+		point.set("memory_bytes", _memory);
+		if (peak_resident_memory > 0) point.set("peak_resident_memory_bytes", peak_resident_memory);
+		return point;
+	}
+};
+
+
+class ScalingStudy {
+public:
+	// Sweeps each dimension separately, the other parameters keeping the values of <base>, and fits a power law to every phase time
+	// and memory subsystem as a function of the dimension's size measure. With the grid width, the resource grid is scaled along
+	// (resource cells of 10 grid cells wide), so that the distance lookup tables, with one entry per pair of resource cells, grow with
+	// the square of the number of grid cells, and the cell selection of animals (compute_k, once per move) grows linearly with it.
+	// The init time includes building the lookup tables, unless they are read from <lookup_table_dir>.
+	ScalingStudy(SimulationConfig _base, vector<ScalingDimension> _dimensions, int _no_steps, int _no_warmup_steps) :
+		base(_base), dimensions(_dimensions), no_steps(_no_steps), no_warmup_steps(_no_warmup_steps)
+	{}
+	void run() {
+		for (ScalingDimension& dimension : dimensions) {
+			dimension.get_size_measure(); // Validates the name.
+			sort(dimension.values.begin(), dimension.values.end());
+			for (float value : dimension.values) {
+				ScalingPoint point = run_point(dimension.name, value);
+				printf("%-16s %8.2f  %10.0f %-16s  step %10.3f ms  init %10.1f ms  memory %8.1f MB\n",
+					dimension.name.c_str(), value, point.measures[dimension.get_size_measure()], dimension.get_size_measure().c_str(),
+					point.times_ms["step"], point.times_ms["init"], point.memory_bytes["total"] / 1e6
+				);
+				points[dimension.name].push_back(point);
+			}
+			print_fits(dimension);
+		}
+	}
+	map<string, PowerLawFit> get_fits(const ScalingDimension& dimension) {
+		// Fits of every time and memory quantity of <dimension>, keyed as "time/<name>" and "memory/<name>".
+		map<string, PowerLawFit> fits;
+		vector<ScalingPoint>& _points = points[dimension.name];
+		string measure = dimension.get_size_measure();
+		auto fit_quantity = [&](string key, auto get_value) {
+			vector<double> x, y;
+			for (ScalingPoint& point : _points) {
+				x.push_back(point.measures[measure]);
+				y.push_back(get_value(point));
+			}
+			PowerLawFit fit = PowerLawFit::fit(x, y);
+			if (fit.valid) fits[key] = fit;
+		};
+		set<string> times, memory;
+		for (ScalingPoint& point : _points) {
+			for (auto& [name, _] : point.times_ms) times.insert(name);
+			for (auto& [name, _] : point.memory_bytes) memory.insert(name);
+		}
+		for (const string& name : times) fit_quantity("time/" + name, [&](ScalingPoint& point) { return point.times_ms[name]; });
+		for (const string& name : memory) fit_quantity("memory/" + name, [&](ScalingPoint& point) { return point.memory_bytes[name]; });
+		if (dimension.name == dimensions.front().name) {
+			fit_quantity("memory/peak_resident", [&](ScalingPoint& point) { return point.peak_resident_memory; });
+		}
+		return fits;
+	}
+	JsonValue get_predictions(vector<int> grid_widths) {
+		// Extrapolate the step time, init time and memory to the given grid widths from the fits of the grid_width dimension. The step
+		// time and memory are predicted as the sums of the fits of the top-level phases and of the memory subsystems, so that the
+		// fastest growing term dominates at large widths, as it would in the simulation.
+		JsonValue predictions;
+		predictions.type = JsonValue::Type::array;
+		for (ScalingDimension& dimension : dimensions) {
+			if (dimension.name != "grid_width") continue;
+			map<string, PowerLawFit> fits = get_fits(dimension);
+			for (int width : grid_widths) {
+				double no_cells = (double)width * width;
+				double step_ms = 0, init_ms = 0, memory = 0;
+				for (auto& [key, fit] : fits) {
+					string name = key.substr(key.find('/') + 1);
+					if (key == "time/init") init_ms = fit.predict(no_cells);
+					else if (key.rfind("time/", 0) == 0 && name != "step" && name != "animal_move" && name.find('/') == string::npos) {
+						step_ms += fit.predict(no_cells);
+					}
+					else if (key.rfind("memory/", 0) == 0 && name != "total" && name != "peak_resident") memory += fit.predict(no_cells);
+				}
+				JsonValue prediction;
+				prediction.set("grid_width", width);
+				prediction.set("grid_cells", no_cells);
+				prediction.set("step_ms", step_ms);
+				prediction.set("init_ms", init_ms);
+				prediction.set("memory_bytes", memory);
+				predictions.array.push_back(prediction);
+				printf("Predicted at grid width %6i: step %12.1f ms, init %12.1f ms, memory %10.1f MB\n", width, step_ms, init_ms, memory / 1e6);
+			}
+		}
+		return predictions;
+	}
+	void write(string path, vector<int> predicted_grid_widths = {}) {
+		JsonValue output;
+		output.set("suite", "dbr_bench/scaling");
+		output.set("random_seed", base.get_int("random_seed"));
+		output.set("steps", no_steps);
+		output.set("warmup_steps", no_warmup_steps);
+		JsonValue _dimensions;
+		for (ScalingDimension& dimension : dimensions) {
+			JsonValue entry;
+			entry.set("size_measure", dimension.get_size_measure());
+			JsonValue _points;
+			_points.type = JsonValue::Type::array;
+			for (ScalingPoint& point : points[dimension.name]) _points.array.push_back(point.to_json());
+			entry.set("points", _points);
+			JsonValue fits;
+			for (auto& [key, fit] : get_fits(dimension)) fits.set(key, fit.to_json());
+			entry.set("fits", fits);
+			_dimensions.set(dimension.name, entry);
+		}
+		output.set("dimensions", _dimensions);
+		if (!predicted_grid_widths.empty()) output.set("predictions", get_predictions(predicted_grid_widths));
+		ofstream file(path);
+		if (!file) throw std::runtime_error("Could not write scaling results to " + path);
+		file << output.dump() << "\n";
+	}
+	map<string, vector<ScalingPoint>> points;
+
+private:
+	SimulationConfig get_config(string dimension, float value) {
+		SimulationConfig config = base;
+		if (dimension == "grid_width") {
+			config.set("grid_width", to_string((int)value));
+			config.set("resource_grid_width", to_string(max(4, (int)value / 10)));
+		}
+		else if (dimension == "treecover") config.set("treecover", to_string(value));
+		else if (dimension == "animal_density") {
+			JsonValue multi_disperser_params = config.get_object("multi_disperser_params");
+			multi_disperser_params.at("animal").at("population").set("density", (double)value);
+			config.params.set("multi_disperser_params", multi_disperser_params);
+		}
+		return config;
+	}
+	ScalingPoint run_point(string dimension, float value) {
+		ScalingPoint point;
+		point.dimension = dimension;
+		point.value = value;
+		help::init_RNG(base.get_int("random_seed"));
+		Dynamics dynamics;
+		Timer timer; timer.start();
+		init_benchmark_dynamics(dynamics, get_config(dimension, value));
+		timer.stop();
+		point.times_ms["init"] = timer.elapsedMilliseconds();
+		point.measures["initial_population_size"] = dynamics.pop->size();
+		for (int i = 0; i < no_warmup_steps; i++) dynamics.update();
+
+		dynamics.log_memory_usage = true;
+		dynamics.state.logger.record_metrics = true;
+		dynamics.state.logger.metrics.clear();
+		BenchmarkResult steps = time_updates(dynamics, no_steps, dimension, JsonValue());
+		point.times_ms["step"] = steps.get_mean();
+		for (auto& [path, time] : steps.details.at("phases_ms").object) point.times_ms[path] = time.as_float();
+
+		double no_moves = 0;
+		map<int, double> memory_per_step;
+		for (LogMetric& metric : dynamics.state.logger.metrics) {
+			if (metric.name == "animal_moves") no_moves += metric.value;
+			else if (metric.name.rfind("memory/", 0) == 0) {
+				string subsystem = metric.name.substr(7);
+				point.memory_bytes[subsystem] = max(point.memory_bytes[subsystem], metric.value);
+				memory_per_step[metric.time] += metric.value;
+			}
+		}
+		for (auto& [time, bytes] : memory_per_step) point.memory_bytes["total"] = max(point.memory_bytes["total"], bytes);
+		if (no_moves > 0 && point.times_ms.count("dispersal/animal")) {
+			point.times_ms["animal_move"] = point.times_ms["dispersal/animal"] * no_steps / no_moves;
+		}
+		point.measures["grid_cells"] = (double)dynamics.grid->no_cells;
+		point.measures["resource_cells"] = (double)dynamics.resource_grid.size;
+		point.measures["population_size"] = dynamics.pop->size();
+		point.measures["animals"] = dynamics.animal_dispersal.animals.total_no_animals;
+		point.measures["animal_moves"] = no_moves / no_steps;
+		if (dimension == dimensions.front().name) point.peak_resident_memory = (double)help::get_peak_memory_usage();
+		dynamics.free();
+		return point;
+	}
+	void print_fits(const ScalingDimension& dimension) {
+		printf("Fitted exponents for %s (as a function of %s):\n", dimension.name.c_str(), dimension.get_size_measure().c_str());
+		for (auto& [key, fit] : get_fits(dimension)) printf("  %-40s %6.2f  (r^2 %.3f)\n", key.c_str(), fit.exponent, fit.r_squared);
+	}
+	SimulationConfig base;
+	vector<ScalingDimension> dimensions;
+	int no_steps = 5;
+	int no_warmup_steps = 1;
+};
@@ -0,0 +1,198 @@
+#pragma once
+#include "dynamics.h"
+#include "json.h"
+
+
+class SimulationConfig {
+public:
+	// Simulation parameters, read from a JSON file with the same keys as the Python front end (see DBR-sim/config.py).
+	// Parameter values that name a .json file (strategy_distribution_params, multi_disperser_params) are read from <data_in_dir>.
+	SimulationConfig() {
+		params = JsonValue::parse(defaults);
+	}
+	SimulationConfig(string path, string _data_in_dir) : SimulationConfig(JsonValue::load(path), _data_in_dir) {}
+	SimulationConfig(JsonValue user_params, string _data_in_dir) : SimulationConfig() {
+		data_in_dir = _data_in_dir;
+		for (auto& [key, value] : user_params.object) params.set(key, value);
+	}
+	void set(string key, string value) {
+		// Override a parameter from a string (e.g. given on the command line). Values which are not valid JSON are taken as strings.
+		try {
+			params.set(key, JsonValue::parse(value));
+		}
+		catch (std::runtime_error&) {
+			params.set(key, JsonValue(value));
+		}
+	}
+	void set_batch_parameter(string variable, float value) {
+		// Set a swept parameter, using the control variable syntax of DBR-sim/app.py:
+		//  - 'strategies-><vector>-><param>' sets an entry of the strategy distribution parameters.
+		//  - '<key>-><idx><i>' sets element <i> of a list parameter (e.g. 'growth_rate_multiplier_params-><idx>0').
+		vector<string> keys;
+		for (size_t begin = 0, end = 0; end != string::npos; begin = end + 2) {
+			end = variable.find("->", begin);
+			keys.push_back(variable.substr(begin, end - begin));
+		}
+		if (keys.size() == 3 && keys[0] == "strategies") {
+			JsonValue strategy_params = get_object("strategy_distribution_params");
+			strategy_params.at(keys[1]).set(keys[2], JsonValue((double)value));
+			params.set("strategy_distribution_params", strategy_params);
+		}
+		else if (keys.size() == 2 && keys[1].find("<idx>") == 0) {
+			int idx = stoi(keys[1].substr(5));
+			JsonValue& list = params.at(keys[0]);
+			if (list.type != JsonValue::Type::array || idx < 0 || idx >= list.array.size()) {
+				throw std::runtime_error("Invalid list index in control variable " + variable);
+			}
+			list.array[idx] = JsonValue((double)value);
+		}
+		else if (keys.size() == 1) params.set(variable, JsonValue((double)value));
+		else throw std::runtime_error("Unsupported control variable " + variable);
+	}
+	float get_float(string key) const {
+		return params.at(key).as_float();
+	}
+	int get_int(string key) const {
+		return params.at(key).as_int();
+	}
+	string get_string(string key) const {
+		return params.at(key).as_string();
+	}
+	JsonValue get_object(string key) const {
+		// Objects may be given inline, as a JSON string (as on the Python command line), or as the name of a file in data_in.
+		const JsonValue& value = params.at(key);
+		if (value.type == JsonValue::Type::object) return value;
+		string text = value.as_string();
+		if (text.size() > 0 && text[0] == '{') return JsonValue::parse(text);
+		return JsonValue::load((std::filesystem::path(data_in_dir) / text).string());
+	}
+	Dynamics create_dynamics() const {
+		// Native counterpart of create_dynamics() in global.cpp.
+		int random_seed = get_int("random_seed");
+		int firefreq_random_seed = get_int("firefreq_random_seed");
+		if (firefreq_random_seed == -999) firefreq_random_seed = std::random_device()() % 1000000;
+		Dynamics dynamics(
+			get_int("timestep"), get_float("cell_width"), get_float("self_ignition_factor"), get_float("rainfall"),
+			get_float("seed_bearing_threshold"), get_float("growth_rate_multiplier"), get_float("unsuppressed_flammability"),
+			get_float("max_dbh"), get_float("saturation_threshold"), get_object("fire_resistance_params").as_float_map(),
+			get_float("background_mortality"), get_object("strategy_distribution_params").as_nested_float_map(),
+			get_int("resource_grid_width"), get_float("mutation_rate"), get_float("STR"), get_int("verbosity"), random_seed,
+			firefreq_random_seed, get_float("enforce_no_recruits"), get_int("animal_group_size")
+		);
+		string log_level = get_string("log_level"); // "auto" derives the level from the verbosity.
+		if (log_level != "auto") dynamics.state.logger.level = get_log_level(log_level);
+		return dynamics;
+	}
+	vector<string> init_dynamics(Dynamics& dynamics, bool init_lookup_tables = true) const {
+		// Native counterpart of init() in app.py: initialize the state, dispersal kernels, tree cover and (optionally) lookup tables.
+		// Returns the names of the animal species.
+		vector<float> growth_params = params.at("growth_rate_multiplier_params").as_float_vector();
+		dynamics.init_state(
+			get_int("grid_width"), get_float("dbh_q1"), get_float("dbh_q2"), growth_params[0], growth_params[1], growth_params[2]
+		);
+		dynamics.animal_dispersal_threads = get_int("animal_dispersal_threads");
+		vector<string> animal_species = set_dispersal_kernel(dynamics);
+
+		string pattern = get_string("initial_pattern_image");
+		if (pattern == "none") dynamics.state.set_tree_cover(get_float("treecover"));
+		else set_cover_from_image(dynamics, pattern);
+		dynamics.state.repopulate_grid(0);
+
+		for (string& species : animal_species) {
+			if (!init_lookup_tables) break;
+			dynamics.resource_grid.init_dist_lookup_table(species, get_string("lookup_table_dir"), params.at("shared_lookup_tables").as_bool());
+		}
+		return animal_species;
+	}
+	StopConditions get_stop_conditions() const {
+		StopConditions conditions;
+		conditions.max_timesteps = get_int("max_timesteps");
+		conditions.max_tree_cover = (get_string("termination_conditions") == "all") ? 0.93f : 2.0f;
+		conditions.initial_tree_cover = get_float("treecover");
+		return conditions;
+	}
+	JsonValue params;
+	string data_in_dir = "../data_in";
+
+private:
+	vector<string> set_dispersal_kernel(Dynamics& dynamics) const {
+		string mode = get_string("dispersal_mode");
+		JsonValue multi_disperser_params = get_object("multi_disperser_params");
+		vector<string> animal_species;
+		if (mode == "animal" || mode == "all") {
+			for (auto& [species, _] : multi_disperser_params.at("animal").object) {
+				if (species != "population") animal_species.push_back(species);
+			}
+		}
+		if (mode == "linear_diffusion") {
+			map<string, float> linear = multi_disperser_params.at("linear").as_float_map();
+			dynamics.set_global_linear_kernel(linear["q1"], linear["q2"], linear["min"], linear["max"]);
+		}
+		else if (mode == "wind") {
+			map<string, float> wind = multi_disperser_params.at("wind").as_float_map();
+			dynamics.set_global_wind_kernel(wind["wspeed_gmean"], wind["wspeed_stdev"], wind["wind_direction"], wind["wind_direction_stdev"]);
+		}
+		else if (mode == "animal") {
+			map<string, map<string, float>> animal_params = multi_disperser_params.at("animal").as_nested_float_map();
+			dynamics.set_global_animal_kernel(animal_params);
+		}
+		else if (mode == "all") {
+			map<string, map<string, float>> nonanimal_params;
+			for (auto& [vector, vector_params] : multi_disperser_params.object) {
+				if (vector != "animal") nonanimal_params[vector] = vector_params.as_float_map();
+			}
+			dynamics.set_global_kernels(nonanimal_params, multi_disperser_params.at("animal").as_nested_float_map());
+		}
+		else throw std::runtime_error("Unknown dispersal mode: " + mode);
+		return animal_species;
+	}
+	void set_cover_from_image(Dynamics& dynamics, string path) const {
+		// Load a greyscale PGM image (the generated 'ctrl' and 'perlin_noise' patterns require the Python front end) and
+		// resample it bilinearly to the grid, as app.py does with cv2.resize.
+		ifstream file(path, ios::binary);
+		string magic;
+		int img_width = 0, img_height = 0, max_value = 0;
+		file >> magic >> img_width >> img_height >> max_value;
+		if (!file || magic != "P5" || max_value > 255 || img_width <= 0 || img_height <= 0) {
+			throw std::runtime_error("Cover image " + path + " is not a binary 8-bit PGM (P5) file.");
+		}
+		file.get();
+		vector<unsigned char> pixels(img_width * img_height);
+		file.read((char*)pixels.data(), pixels.size());
+
+		int width = dynamics.state.grid.width;
+		shared_ptr<float[]> image = make_shared<float[]>(width * width);
+		float x_scale = (float)img_width / (float)width;
+		float y_scale = (float)img_height / (float)width;
+		for (int y = 0; y < width; y++) {
+			float src_y = std::clamp((y + 0.5f) * y_scale - 0.5f, 0.0f, (float)(img_height - 1));
+			int y0 = src_y;
+			int y1 = min(y0 + 1, img_height - 1);
+			for (int x = 0; x < width; x++) {
+				float src_x = std::clamp((x + 0.5f) * x_scale - 0.5f, 0.0f, (float)(img_width - 1));
+				int x0 = src_x;
+				int x1 = min(x0 + 1, img_width - 1);
+				float fx = src_x - x0;
+				float fy = src_y - y0;
+				float top = pixels[y0 * img_width + x0] * (1 - fx) + pixels[y0 * img_width + x1] * fx;
+				float bottom = pixels[y1 * img_width + x0] * (1 - fx) + pixels[y1 * img_width + x1] * fx;
+				image[y * width + x] = (top * (1 - fy) + bottom * fy) / 255.0f;
+			}
+		}
+		float override_cover = get_float("override_image_treecover");
+		if (override_cover >= 0) dynamics.state.set_cover_from_image(image, width, width, override_cover);
+		else dynamics.state.set_cover_from_image(image, width, width);
+	}
+	inline static const string defaults = R"({
+		"grid_width": 960, "treecover": 0.5, "cell_width": 1, "max_dbh": 44.3, "timestep": 1, "enforce_no_recruits": -1,
+		"self_ignition_factor": 3, "unsuppressed_flammability": 0.5, "rainfall": 0.1, "random_seed": -999, "firefreq_random_seed": 0,
+		"termination_conditions": "all", "STR": 10000, "dbh_q1": 1, "dbh_q2": 0, "verbosity": 0,
+		"growth_rate_multiplier_params": [0.5, 0.5, 2.13], "seed_bearing_threshold": 0.25, "dispersal_mode": "all",
+		"multi_disperser_params": "multi_disperser_params.json", "growth_rate_multiplier": 0.4, "saturation_threshold": 3,
+		"fire_resistance_params": {"argmin": 8.5, "argmax": 50, "stretch": 2.857}, "background_mortality": 0.01,
+		"max_timesteps": 100, "strategy_distribution_params": "windkernel.json", "resource_grid_width": 48,
+		"initial_pattern_image": "none", "override_image_treecover": -999, "mutation_rate": 0, "animal_group_size": 10,
+		"animal_dispersal_threads": 1, "lookup_table_dir": ".", "shared_lookup_tables": false,
+		"log_level": "auto"
+	})";
+};
@@ -2,6 +2,7 @@
 #include <iostream>
 #include "agents.h"
 #include "grid.h"
+#include "logging.h"
 
 
 class State {
@@ -36,7 +37,7 @@ public:
 		return presence;
 	}
 	void repopulate_grid(int verbosity) {
-		if (verbosity == 2) cout << "Repopulating grid..." << endl;
+		if (verbosity == 2) DBR_LOG(logger, LogLevel::trace, "Repopulating grid...\n");
 		grid.reset();
 		int i = 0;
 		bool success;
@@ -44,14 +45,14 @@ public:
 			//if (verbosity == 1) printf("Tree id (beginning): %i \n", tree.id);
 			//if (i % (population.size()/1000) == 0) printf("i: %i / %i \n", i, population.size());
 			if (id == -1 || tree.id == -1) {
-				printf("Removing tree with wrong id %i\n", tree.id);
+				DBR_LOG(logger, LogLevel::warning, "Removing tree with wrong id %i\n", tree.id);
 				population.remove(id); // HOTFIX: Sometimes trees are not initialized properly and need to be removed.
 				continue;
 			}
 			success = grid.populate_tree_domain(&tree);
 			if (!success) {
 				population.remove(tree.id);
-				printf("\n------------- Restarting grid repopulation because tree %i failed to have its domain populated. --------\n", tree.id);
+				DBR_LOG(logger, LogLevel::warning, "\n------------- Restarting grid repopulation because tree %i failed to have its domain populated. --------\n", tree.id);
 				repopulate_grid(verbosity);
 			}
 			/*if (verbosity > 0 && !check_grid_for_tree_presence(tree.id)) {
@@ -61,7 +62,7 @@ public:
 			i++;
 		}
 		grid.update_grass_LAIs();
-		if (verbosity == 2) cout << "Repopulated grid." << endl;
+		if (verbosity == 2) DBR_LOG(logger, LogLevel::trace, "Repopulated grid.\n");
 	}
 	float compute_shade_on_individual_tree(Tree* tree) {
 		float LAI_shade = 0;
@@ -72,7 +73,7 @@ public:
 				Cell* cell = grid.get_cell_at_position(it.gb_cell_position);
 				float _LAI_shade = cell->get_shading_on_tree(tree, &population);
 				LAI_shade += _LAI_shade;
-				if (_LAI_shade < tree->LAI) printf(" -- Shade is less than tree LAI. Shade: %f, tree LAI: %f\n", _LAI_shade, tree->LAI);
+				if (_LAI_shade < tree->LAI) DBR_LOG(logger, LogLevel::trace, " -- Shade is less than tree LAI. Shade: %f, tree LAI: %f\n", _LAI_shade, tree->LAI);
 				no_cells += 1;
 			}
 		}
@@ -170,10 +171,10 @@ public:
 		probmodel.build_cdf();
 		if (target_cover < 0) {
 			target_cover = integral_image_cover / (float)(img_width * img_height);
-			printf("Image cover: %f\n", target_cover);
+			DBR_LOG(logger, LogLevel::info, "Image cover: %f\n", target_cover);
 		}
 		else {
-			printf("Using user-provided tree cover: %f\n", target_cover);
+			DBR_LOG(logger, LogLevel::info, "Using user-provided tree cover: %f\n", target_cover);
 		}
 
 		// Set tree cover
@@ -202,12 +203,13 @@ public:
 
 			if (population.size() % 10000 == 0) {
 				repopulate_grid(0);
-				printf("Current tree cover: %f, current population size: %i\n", grid.get_tree_cover(), population.size());
+				DBR_LOG(logger, LogLevel::info, "Current tree cover: %f, current population size: %i\n", grid.get_tree_cover(), population.size());
 			}
 		}
-		printf("Final tree cover: %f\n", grid.tree_cover);
+		DBR_LOG(logger, LogLevel::info, "Final tree cover: %f\n", grid.tree_cover);
 		repopulate_grid(0);
-		printf("Finished setting tree cover from image.\n");
+		DBR_LOG(logger, LogLevel::info, "Finished setting tree cover from image.\n");
+		logger.flush();
 	}
 	void set_tree_cover(float _tree_cover) {
 		grid.reset();
@@ -227,10 +229,11 @@ public:
 			}
 			if (tree->id == -1) population.remove(population.no_created_trees - 1); // HOTFIX: Sometimes trees are not initialized properly and need to be removed.
 			grid.populate_tree_domain(tree);
-			if (population.get_crop(tree->id)->strategy.vector == "wind") {
+			DispersalVector vector = population.get_strategy(population.get_crop(tree->id))->vector;
+			if (vector == DispersalVector::wind) {
 				wind_trees++;
 			}
-			else if (population.get_crop(tree->id)->strategy.vector == "animal") {
+			else if (vector == DispersalVector::animal) {
 				animal_trees++;
 			}
 
@@ -241,23 +244,29 @@ public:
 			}*/
 
 			if (population.size() % 1000 == 0) {
-				printf("Current tree cover: %f, current population size: %i\n", grid.get_tree_cover(), population.size());
+				DBR_LOG(logger, LogLevel::info, "Current tree cover: %f, current population size: %i\n", grid.get_tree_cover(), population.size());
 			}
 			continue;
 		}
-		printf("Final tree cover: %f\n", grid.tree_cover);
-		printf("Wind trees: %i, Animal trees: %i\n", wind_trees, animal_trees);
-		printf("First tree's strategy: \n");
-		population.get_crop(10)->strategy.print();
+		DBR_LOG(logger, LogLevel::info, "Final tree cover: %f\n", grid.tree_cover);
+		DBR_LOG(logger, LogLevel::info, "Wind trees: %i, Animal trees: %i\n", wind_trees, animal_trees);
+		if (logger.is_enabled(LogLevel::info) && population.get_crop(10)->strategy != -1) {
+			DBR_LOG(logger, LogLevel::info, "First tree's strategy: \n");
+			logger.flush();
+			population.get_strategy(population.get_crop(10))->print();
+		}
+		DBR_LOG(logger, LogLevel::info, "Number of distinct strategies: %i\n", population.strategies.size());
 
 		// Count no small trees
-		int no_small = 0;
-		for (auto& [id, tree] : population.members) {
-			if (tree.dbh < population.max_dbh / 2.0) {
-				no_small++;
+		if (logger.is_enabled(LogLevel::info)) {
+			int no_small = 0;
+			for (auto& [id, tree] : population.members) {
+				if (tree.dbh < population.max_dbh / 2.0) {
+					no_small++;
+				}
 			}
+			DBR_LOG(logger, LogLevel::info, "- Fraction small trees: %f \n", (float)no_small / (float)population.size());
 		}
-		printf("- Fraction small trees: %f \n", (float)no_small / (float)population.size());
 
 		initial_tree_cover = grid.tree_cover;
 		repopulate_grid(0);
@@ -273,7 +282,8 @@ public:
 			sum_of_sq += (population.recruitment_rates[i] - mean) * (population.recruitment_rates[i] - mean);
 		}
 		float stdev = sqrt(sum_of_sq / (float)population.recruitment_rates.size());
-		printf("Recruitment rate mean: %f, stdev: %f\n", mean, stdev);
+		DBR_LOG(logger, LogLevel::info, "Recruitment rate mean: %f, stdev: %f\n", mean, stdev);
+		logger.flush();
 	}
 	void get_state_table(float* state_table) {
 		int i = 0;
@@ -298,5 +308,6 @@ public:
 	Population population;
 	float initial_tree_cover = 0;
 	float saturation_threshold = 0;
+	Logger logger; // Log of the simulation run that owns this state (see logging.h).
 };
 
@@ -0,0 +1,505 @@
+#pragma once
+#include "ensemble.h"
+#include <deque>
+#include <condition_variable>
+
+
+template <typename T>
+class WorkStealingQueue {
+public:
+	// One deque per worker. Workers push and pop at the back of their own deque (so that follow-up work stays on the thread that
+	// created it) and, when it is empty, steal from the front of the other workers' deques.
+	void reset(int _no_workers) {
+		no_workers = _no_workers;
+		deques = vector<std::deque<T>>(no_workers);
+		locks = shared_ptr<std::mutex[]>(new std::mutex[no_workers]);
+		no_pending = 0;
+		no_steals = 0;
+	}
+	void push(int worker, T item) {
+		{
+			std::lock_guard<std::mutex> lock(locks[worker]);
+			deques[worker].push_back(item);
+		}
+		no_pending++;
+		idle.notify_one();
+	}
+	bool pop(int worker, T& item) {
+		for (int i = 0; i < no_workers; i++) {
+			int victim = (worker + i) % no_workers;
+			std::lock_guard<std::mutex> lock(locks[victim]);
+			if (deques[victim].empty()) continue;
+			if (victim == worker) {
+				item = deques[victim].back();
+				deques[victim].pop_back();
+			}
+			else {
+				item = deques[victim].front();
+				deques[victim].pop_front();
+				no_steals++;
+			}
+			return true;
+		}
+		return false;
+	}
+	void task_done() {
+		// Call once per popped item, after pushing any work that it produced.
+		if (--no_pending == 0) idle.notify_all();
+	}
+	bool wait_for_work() {
+		// Returns false once all pushed items are done.
+		std::unique_lock<std::mutex> lock(idle_mutex);
+		idle.wait_for(lock, std::chrono::milliseconds(50));
+		return no_pending > 0;
+	}
+	std::atomic<int> no_pending = 0; // Items pushed and not yet done.
+	std::atomic<int> no_steals = 0;
+private:
+	int no_workers = 0;
+	vector<std::deque<T>> deques;
+	shared_ptr<std::mutex[]> locks;
+	std::mutex idle_mutex;
+	std::condition_variable idle;
+};
+
+
+class SweepRun {
+public:
+	// A single simulation of a sweep, identified by its point, attempt (one secondary value per attempt) and rerun index.
+	int point = 0;
+	int attempt = 0;
+	int rerun = 0;
+	float secondary_value = 0;
+	unsigned int seed = 0;
+	RunStatistics run_statistics;
+	bool done = false;
+};
+
+
+class SweepAttempt {
+public:
+	float secondary_value = 0;
+	vector<SweepRun> runs; // One per rerun.
+	int no_done = 0;
+	float mean = 0; // Mean of the dependent variable over the reruns.
+	float result = 0; // Statistic that is minimized by the saddle search.
+};
+
+
+class SweepPoint {
+public:
+	// A value of the control variable and, for range sweeps, of the secondary variable.
+	float control_value = 0;
+	float secondary_value = 0;
+	vector<SweepAttempt> attempts;
+
+	// Saddle search state (see execute_saddle_search() in DBR-sim/batch.py).
+	float stepsize = 0.5f;
+	float best_result = 0;
+	float best_secondary_value = 0;
+	float best_positive_secondary_value = 0;
+	float best_negative_secondary_value = 0;
+	bool done = false;
+};
+
+
+class Sweep {
+public:
+	// Native counterpart of DBR-sim/batch.py. Parameter points are simulated by a pool of threads that share a work-stealing queue,
+	// so that long runs (typically those close to the bistability threshold) do not leave other threads idle.
+	// Settings (same semantics as the batch.py arguments):
+	//   batch_type          'range' (every combination of control and secondary value), 'constant' (a single control value), or
+	//                       'saddle_search' (for each control value, search the secondary value that minimizes the statistic)
+	//   control_variable    parameter name, or 'strategies-><vector>-><param>' / '<list param>-><idx><i>'
+	//   control_range       [min, max, stepsize]; values min, min + stepsize, ... below max
+	//   secondary_variable  optional
+	//   secondary_range     [min, stepsize, max] for range sweeps (inclusive); [min, max] for saddle searches
+	//   no_reruns           number of simulations per parameter point (range) or per attempt (saddle search)
+	//   attempts            number of secondary values tried per saddle search
+	//   dependent_var       'tree_cover_slope', 'tree_cover', 'largest_absolute_slope' or 'initial_no_dispersals'
+	//   statistic           'mean' (absolute mean of the dependent variable) or 'stdev'
+	//   progress_file       optional. Completed simulations are appended to it; an interrupted sweep that is restarted with the
+	//                       same settings skips them and continues where it left off. Without an explicit seed, the restarted
+	//                       sweep takes the seed recorded in the file.
+	Sweep(SimulationConfig _config, JsonValue _settings, int _no_threads = 0, int _base_seed = -999) :
+		config(_config), settings(_settings), no_threads(_no_threads)
+	{
+		seed_given = (_base_seed != -999);
+		base_seed = seed_given ? _base_seed : std::random_device()();
+		if (no_threads < 1) no_threads = max(1, (int)std::thread::hardware_concurrency());
+		batch_type = get_setting("batch_type", JsonValue("range")).as_string();
+		control_variable = settings.at("control_variable").as_string();
+		secondary_variable = get_setting("secondary_variable", JsonValue("")).as_string();
+		no_reruns = max(1, get_setting("no_reruns", JsonValue(1)).as_int());
+		no_attempts = max(2, get_setting("attempts", JsonValue(5)).as_int());
+		dependent_var = get_setting("dependent_var", JsonValue("tree_cover_slope")).as_string();
+		statistic = get_setting("statistic", JsonValue("mean")).as_string();
+		progress_path = get_setting("progress_file", JsonValue("")).as_string();
+		if (batch_type != "range" && batch_type != "constant" && batch_type != "saddle_search") {
+			throw std::runtime_error("Invalid batch type '" + batch_type + "'");
+		}
+		if (statistic != "mean" && statistic != "stdev") throw std::runtime_error("Invalid statistic '" + statistic + "'");
+		if (statistic == "stdev" && no_reruns < 2) throw std::runtime_error("The 'stdev' statistic requires at least two reruns");
+		if (batch_type == "saddle_search" && secondary_variable == "") throw std::runtime_error("A saddle search requires a secondary variable");
+		get_dependent_value(RunStatistics()); // Validate dependent_var
+		create_points();
+	}
+	void run() {
+		// Simulate all points. May be called again after an interruption to finish a sweep.
+		queue.reset(no_threads);
+		points.clear();
+		create_points();
+		load_progress();
+		for (int i = 0; i < points.size(); i++) {
+			std::lock_guard<std::mutex> lock(results_mutex);
+			if (points[i].attempts.size() == 0) start_point(i, i % no_threads);
+		}
+		vector<std::thread> threads;
+		for (int i = 0; i < no_threads; i++) threads.push_back(std::thread(&Sweep::work, this, i));
+		for (auto& thread : threads) thread.join();
+		if (progress_file != nullptr) fclose(progress_file);
+		progress_file = nullptr;
+		if (error != "") throw std::runtime_error(error);
+		printf("Sweep complete (%i simulations, %i of which were stolen by idle threads).\n", no_simulations, queue.no_steals.load());
+	}
+	JsonValue get_results() {
+		// One row per simulation (range and constant sweeps) or per control value (saddle searches).
+		JsonValue rows;
+		rows.type = JsonValue::Type::array;
+		for (auto& point : points) {
+			if (batch_type == "saddle_search") {
+				JsonValue row;
+				row.set(control_variable, (double)point.control_value);
+				row.set(secondary_variable, (double)point.best_secondary_value);
+				row.set(dependent_var, (double)point.best_result);
+				row.set("no_attempts", (int)point.attempts.size());
+				rows.array.push_back(row);
+				continue;
+			}
+			if (point.attempts.size() == 0) continue;
+			for (auto& run : point.attempts[0].runs) {
+				JsonValue row = get_run_record(run);
+				row.set(control_variable, (double)point.control_value);
+				if (secondary_variable != "") row.set(secondary_variable, (double)point.secondary_value);
+				rows.array.push_back(row);
+			}
+		}
+		return rows;
+	}
+	void write_results(string path) {
+		// Write the results as CSV (columns as in get_results()).
+		JsonValue rows = get_results();
+		FILE* file = fopen(path.c_str(), "w");
+		if (file == nullptr) throw std::runtime_error("Could not write sweep results to " + path);
+		for (int i = 0; i < rows.array.size(); i++) {
+			auto& columns = rows.array[i].object;
+			if (i == 0) {
+				for (int j = 0; j < columns.size(); j++) fprintf(file, j == 0 ? "%s" : ",%s", columns[j].first.c_str());
+				fprintf(file, "\n");
+			}
+			for (int j = 0; j < columns.size(); j++) fprintf(file, j == 0 ? "%s" : ",%s", columns[j].second.dump().c_str());
+			fprintf(file, "\n");
+		}
+		fclose(file);
+	}
+	SimulationConfig config;
+	JsonValue settings;
+	int no_threads = 1;
+	unsigned int base_seed = 0;
+	bool seed_given = false;	// Otherwise the seed is drawn at random, or taken from the progress file when resuming.
+	string batch_type;
+	string control_variable;
+	string secondary_variable;
+	int no_reruns = 1;
+	int no_attempts = 5;
+	string dependent_var;
+	string statistic;
+	string progress_path;
+	vector<SweepPoint> points;
+
+private:
+	JsonValue get_setting(string key, JsonValue default_value) {
+		return settings.has(key) ? settings.at(key) : default_value;
+	}
+	void create_points() {
+		vector<float> control_range = settings.at("control_range").as_float_vector();
+		vector<float> control_values = { control_range.at(0) };
+		if (batch_type != "constant") {
+			if (control_range.size() < 3 || control_range[2] <= 0) throw std::runtime_error("control_range must be [min, max, stepsize]");
+			control_values.clear();
+			for (int i = 0; control_range[0] + i * control_range[2] < control_range[1]; i++) {
+				control_values.push_back(control_range[0] + i * control_range[2]);
+			}
+		}
+		vector<float> secondary_values = { 0 };
+		if (secondary_variable != "") {
+			secondary_range = settings.at("secondary_range").as_float_vector();
+			if (batch_type == "saddle_search" && secondary_range.size() < 2) throw std::runtime_error("secondary_range must be [min, max]");
+			if (batch_type != "saddle_search") {
+				if (secondary_range.size() < 3 || secondary_range[1] <= 0) throw std::runtime_error("secondary_range must be [min, stepsize, max]");
+				secondary_values.clear();
+				for (int i = 0; secondary_range[0] + i * secondary_range[1] <= secondary_range[2] + 1e-6f; i++) {
+					secondary_values.push_back(secondary_range[0] + i * secondary_range[1]);
+				}
+			}
+		}
+		for (float control_value : control_values) {
+			if (batch_type == "saddle_search") secondary_values = { 0 };
+			for (float secondary_value : secondary_values) {
+				SweepPoint point;
+				point.control_value = control_value;
+				point.secondary_value = secondary_value;
+				points.push_back(point);
+			}
+		}
+	}
+	float get_dependent_value(const RunStatistics& run_statistics) {
+		if (dependent_var == "tree_cover_slope") return run_statistics.slope;
+		if (dependent_var == "tree_cover") return run_statistics.tree_cover;
+		if (dependent_var == "largest_absolute_slope") return run_statistics.largest_absolute_slope;
+		if (dependent_var == "initial_no_dispersals") return run_statistics.initial_no_dispersals;
+		throw std::runtime_error("Invalid dependent variable '" + dependent_var + "'");
+	}
+	unsigned int get_seed(int point, int attempt, int rerun) {
+		std::seed_seq sequence = { base_seed, (unsigned int)point, (unsigned int)attempt, (unsigned int)rerun };
+		unsigned int seed;
+		sequence.generate(&seed, &seed + 1);
+		return seed;
+	}
+
+	// Scheduling. The functions below are called with <results_mutex> held.
+	void start_point(int point_idx, int worker) {
+		SweepPoint& point = points[point_idx];
+		if (batch_type != "saddle_search") {
+			add_attempt(point_idx, point.secondary_value, worker);
+			return;
+		}
+		// The two bounds of the secondary range are independent, so both are submitted at once.
+		add_attempt(point_idx, secondary_range[0], worker);
+		add_attempt(point_idx, secondary_range[1], worker);
+	}
+	void add_attempt(int point_idx, float secondary_value, int worker) {
+		SweepPoint& point = points[point_idx];
+		SweepAttempt attempt;
+		attempt.secondary_value = secondary_value;
+		int attempt_idx = point.attempts.size();
+		for (int rerun = 0; rerun < no_reruns; rerun++) {
+			SweepRun run;
+			run.point = point_idx;
+			run.attempt = attempt_idx;
+			run.rerun = rerun;
+			run.secondary_value = secondary_value;
+			run.seed = get_seed(point_idx, attempt_idx, rerun);
+			attempt.runs.push_back(run);
+		}
+		point.attempts.push_back(attempt);
+		for (int rerun = 0; rerun < no_reruns; rerun++) {
+			auto completed = completed_runs.find({ point_idx, attempt_idx, rerun });
+			if (completed != completed_runs.end() && abs(completed->second.secondary_value - secondary_value) < 1e-6f * max(1.0f, abs(secondary_value))) {
+				complete_run(completed->second, worker, false);
+			}
+			else queue.push(worker, { point_idx, attempt_idx * no_reruns + rerun });
+		}
+	}
+	void complete_run(SweepRun& result, int worker, bool record) {
+		SweepPoint& point = points[result.point];
+		SweepAttempt& attempt = point.attempts[result.attempt];
+		SweepRun& run = attempt.runs[result.rerun];
+		run.run_statistics = result.run_statistics;
+		run.done = true;
+		if (record) write_progress(run);
+		if (++attempt.no_done < no_reruns) return;
+
+		// All reruns of the attempt are done
+		vector<double> values;
+		for (auto& run : attempt.runs) values.push_back(get_dependent_value(run.run_statistics));
+		attempt.mean = help::get_mean(&values);
+		attempt.result = (statistic == "mean") ? abs(attempt.mean) : help::get_stdev(&values, attempt.mean);
+		if (batch_type == "saddle_search") advance_saddle_search(result.point, worker);
+		else point.done = true;
+	}
+	void advance_saddle_search(int point_idx, int worker) {
+		// Choose the next secondary value, following execute_saddle_search() in DBR-sim/batch.py: after evaluating both bounds,
+		// interpolate between them, then bisect toward the best value on the other side of the threshold (for the tree cover
+		// slope) or hill-climb (for other dependent variables).
+		SweepPoint& point = points[point_idx];
+		vector<SweepAttempt>& attempts = point.attempts;
+		if (attempts.size() < 2) return; // Wait for the other bound
+		for (auto& attempt : attempts) if (attempt.no_done < no_reruns) return;
+		SweepAttempt& latest = attempts.back();
+		float next_value;
+		if (attempts.size() == 2) {
+			SweepAttempt& lower = attempts[0];
+			SweepAttempt& upper = attempts[1];
+			bool lower_is_best = (lower.result <= upper.result);
+			point.best_result = lower_is_best ? lower.result : upper.result;
+			point.best_secondary_value = lower_is_best ? lower.secondary_value : upper.secondary_value;
+			point.best_positive_secondary_value = lower.secondary_value;
+			point.best_negative_secondary_value = upper.secondary_value;
+			float cumulative_deviation = lower.result + upper.result;
+			float lower_deviation = (cumulative_deviation > 0) ? lower.result / cumulative_deviation : 0.5f;
+			next_value = lower.secondary_value + lower_deviation * (upper.secondary_value - lower.secondary_value);
+		}
+		else {
+			if (dependent_var == "tree_cover_slope") {
+				if (latest.mean > 0) next_value = (point.best_negative_secondary_value + latest.secondary_value) / 2.0f;
+				else next_value = (point.best_positive_secondary_value + latest.secondary_value) / 2.0f;
+			}
+			else next_value = hillclimb(point, latest);
+			point.stepsize *= 0.8f;
+			if (latest.result < point.best_result) {
+				point.best_result = latest.result;
+				point.best_secondary_value = latest.secondary_value;
+				if (latest.mean > 0) point.best_positive_secondary_value = latest.secondary_value;
+				else point.best_negative_secondary_value = latest.secondary_value;
+			}
+		}
+		if (attempts.size() >= no_attempts) {
+			point.done = true;
+			return;
+		}
+		add_attempt(point_idx, next_value, worker);
+	}
+	float hillclimb(SweepPoint& point, SweepAttempt& latest) {
+		float stepsize = point.stepsize * (secondary_range[1] - secondary_range[0]);
+		float diff;
+		if (latest.result > point.best_result) diff = point.best_secondary_value - latest.secondary_value;
+		else diff = latest.secondary_value - point.best_secondary_value;
+		float direction = (diff < 0) ? -1.0f : 1.0f;
+		float value = latest.secondary_value + stepsize * direction;
+		if (value < secondary_range[0]) value = (latest.secondary_value + secondary_range[0]) / 2.0f;
+		else if (value > secondary_range[1]) value = (latest.secondary_value + secondary_range[1]) / 2.0f;
+		return value;
+	}
+
+	// Execution
+	void work(int worker) {
+		while (true) {
+			pair<int, int> task;
+			if (!queue.pop(worker, task)) {
+				if (!queue.wait_for_work()) return;
+				continue;
+			}
+			SweepRun run;
+			float control_value;
+			{
+				std::lock_guard<std::mutex> lock(results_mutex);
+				SweepPoint& point = points[task.first];
+				run = point.attempts[task.second / no_reruns].runs[task.second % no_reruns];
+				control_value = point.control_value;
+			}
+			if (!failed) {
+				try {
+					SimulationConfig run_config = config;
+					run_config.set_batch_parameter(control_variable, control_value);
+					if (secondary_variable != "") run_config.set_batch_parameter(secondary_variable, run.secondary_value);
+					run.run_statistics = simulate(run_config, run.seed, lookup_tables);
+					std::lock_guard<std::mutex> lock(results_mutex);
+					no_simulations++;
+					complete_run(run, worker, true);
+				}
+				catch (std::exception& exception) {
+					// Stop scheduling new simulations; progress made so far is kept, so the sweep can be resumed.
+					std::lock_guard<std::mutex> lock(results_mutex);
+					if (!failed) error = exception.what();
+					failed = true;
+				}
+			}
+			queue.task_done();
+		}
+	}
+
+	// Progress file (JSON lines). The first line holds the sweep settings; each following line records one completed simulation.
+	JsonValue get_run_record(SweepRun& run) {
+		JsonValue record;
+		record.set("point", run.point);
+		record.set("attempt", run.attempt);
+		record.set("rerun", run.rerun);
+		record.set("secondary_value", (double)run.secondary_value);
+		record.set("seed", (double)run.seed);
+		record.set("tree_cover_slope", (double)run.run_statistics.slope);
+		record.set("largest_absolute_slope", (double)run.run_statistics.largest_absolute_slope);
+		record.set("tree_cover", (double)run.run_statistics.tree_cover);
+		record.set("initial_no_dispersals", run.run_statistics.initial_no_dispersals);
+		record.set("no_steps", run.run_statistics.no_steps);
+		record.set("termination_cause", run.run_statistics.termination_cause);
+		return record;
+	}
+	JsonValue get_progress_header() {
+		JsonValue header;
+		header.set("settings", settings);
+		header.set("base_seed", (double)base_seed);
+		header.set("config", config.params);
+		return header;
+	}
+	void load_progress() {
+		completed_runs.clear();
+		if (progress_path == "") return;
+		ifstream file(progress_path, std::ios::binary);
+		stringstream buffer;
+		if (file) buffer << file.rdbuf();
+		file.close();
+		string text = buffer.str();
+		size_t header_end = text.find('\n');
+		if (header_end != string::npos && header_end > 0) {
+			JsonValue header = JsonValue::parse(text.substr(0, header_end));
+			if (!seed_given && header.has("base_seed")) base_seed = (unsigned int)header.at("base_seed").number;
+			if (header.dump() != get_progress_header().dump()) {
+				throw std::runtime_error("Progress file " + progress_path + " belongs to a sweep with different settings.");
+			}
+			// Only lines that end in a newline are complete; the file is cut after the last complete record, so that records
+			// appended from here on start on a line of their own.
+			size_t end = header_end + 1;
+			for (size_t begin = end, line_end; (line_end = text.find('\n', begin)) != string::npos; begin = line_end + 1) {
+				string line = text.substr(begin, line_end - begin);
+				if (line == "") {
+					end = line_end + 1;
+					continue;
+				}
+				JsonValue record;
+				try {
+					record = JsonValue::parse(line);
+				}
+				catch (std::runtime_error&) {
+					break; // Incomplete line of an interrupted sweep
+				}
+				SweepRun run;
+				run.point = record.at("point").as_int();
+				run.attempt = record.at("attempt").as_int();
+				run.rerun = record.at("rerun").as_int();
+				run.secondary_value = record.at("secondary_value").as_float();
+				run.seed = (unsigned int)record.at("seed").number;
+				run.run_statistics.slope = record.at("tree_cover_slope").as_float();
+				run.run_statistics.largest_absolute_slope = record.at("largest_absolute_slope").as_float();
+				run.run_statistics.tree_cover = record.at("tree_cover").as_float();
+				run.run_statistics.initial_no_dispersals = record.at("initial_no_dispersals").as_int();
+				run.run_statistics.no_steps = record.at("no_steps").as_int();
+				run.run_statistics.termination_cause = record.at("termination_cause").as_string();
+				completed_runs[{ run.point, run.attempt, run.rerun }] = run;
+				end = line_end + 1;
+			}
+			if (end < text.size()) std::filesystem::resize_file(progress_path, end);
+			progress_file = fopen(progress_path.c_str(), "a");
+			printf("Resuming sweep: %i simulations were completed previously.\n", (int)completed_runs.size());
+		}
+		else {
+			progress_file = fopen(progress_path.c_str(), "w");
+			if (progress_file != nullptr) fprintf(progress_file, "%s\n", get_progress_header().dump().c_str());
+		}
+		if (progress_file == nullptr) throw std::runtime_error("Could not open progress file " + progress_path);
+	}
+	void write_progress(SweepRun& run) {
+		if (progress_file == nullptr) return;
+		fprintf(progress_file, "%s\n", get_run_record(run).dump().c_str());
+		fflush(progress_file);
+	}
+	vector<float> secondary_range;
+	WorkStealingQueue<pair<int, int>> queue; // Tasks are (point, attempt * no_reruns + rerun).
+	std::mutex results_mutex;
+	map<tuple<int, int, int>, SweepRun> completed_runs;
+	FILE* progress_file = nullptr;
+	LookupTableCache lookup_tables;
+	int no_simulations = 0;
+	string error = "";
+	std::atomic<bool> failed = false; // Set together with <error>; read by the workers without the lock.
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include "dynamics.h"
+#include "ensemble.h"
 
 class Tests {
 public:
@@ -183,6 +184,39 @@ public:
 		if (!success) failed_tests.push_back("readable_number");
 		return success;
 	}
+	bool test_ensemble_reproducibility(vector<string>& failed_tests) {
+		// Ensembles with the same base seed should give identical metrics, also when animals are dispersed on several threads and
+		// regardless of the number of replicate threads.
+		bool success = true;
+		SimulationConfig config;
+		config.data_in_dir = data_in_dir;
+		config.set("grid_width", "300"); // Large enough to hold animals at the default density.
+		config.set("resource_grid_width", "30");
+		config.set("strategy_distribution_params", "mixedkernel.json");
+		config.set("max_timesteps", "3");
+		config.set("animal_dispersal_threads", "2");
+		config.set("log_level", "warning");
+
+		vector<vector<Replicate>> results;
+		for (int no_threads : { 2, 2, 1 }) {
+			Ensemble ensemble(config, 2, no_threads, 12345);
+			ensemble.run();
+			results.push_back(ensemble.replicates);
+		}
+		for (int i = 1; i < results.size(); i++) {
+			for (int replicate = 0; replicate < results[0].size(); replicate++) {
+				Replicate& expected = results[0][replicate];
+				Replicate& obtained = results[i][replicate];
+				if (expected.error != "" || obtained.metrics != expected.metrics) {
+					if (verbosity > 0) printf("Case %i failed (replicate %i differs from the first ensemble) \n", i, replicate);
+					success = false;
+				}
+			}
+		}
+
+		if (!success) failed_tests.push_back("Ensemble reproducibility");
+		return success;
+	}
 	void run_all() {
 		printf("Beginning tests...\n");
 		vector<string> failed_tests = {};
@@ -195,6 +229,7 @@ public:
 		successes += test_is_float_equal(failed_tests);
 		successes += test_approx(failed_tests);
 		successes += test_readable_number(failed_tests);
+		successes += test_ensemble_reproducibility(failed_tests);
 
 		printf("Completed all tests. ");
 		if (failed_tests.size() > 0) {
@@ -205,5 +240,6 @@ public:
 	}
 	Dynamics dynamics;
 	int verbosity = 0;
+	string data_in_dir = "../data_in";
 };
 
@@ -0,0 +1,49 @@
+#pragma once
+#include "agents.h"
+
+
+enum class TreeEventType : uint8_t {
+	recruitment = 0,			// A seedling was recruited.
+	topkill = 1,				// The tree was topkilled by fire and resprouts.
+	fire_death = 2,				// The tree was killed by fire (resprouts do not resprout again).
+	light_limitation_death = 3,	// The tree died because it was too shaded to grow.
+	background_mortality = 4,	// The tree died of background mortality.
+	removal = 5					// The tree was removed for another reason (e.g. it had no valid crop or kernel).
+};
+
+inline string get_tree_event_name(TreeEventType type) {
+	switch (type) {
+	case TreeEventType::recruitment: return "recruitment";
+	case TreeEventType::topkill: return "topkill";
+	case TreeEventType::fire_death: return "fire_death";
+	case TreeEventType::light_limitation_death: return "light_limitation_death";
+	case TreeEventType::background_mortality: return "background_mortality";
+	default: return "removal";
+	}
+}
+
+
+class TreeEvent {
+public:
+	int time = 0;
+	int id = 0;
+	TreeEventType type = TreeEventType::removal;
+	pair<float, float> position;
+	float dbh = 0;		// Stem diameter at the time of the event (before a topkill or death).
+	Strategy strategy;
+};
+
+
+class TreeEventRecorder {
+public:
+	// Collects demographic events while enabled (see TreeLogWriter in tree_log.h). Disabled by default, in which case record()
+	// returns immediately.
+	void record(int time, TreeEventType type, Tree& tree, Population* population) {
+		if (!enabled) return;
+		auto crop = population->crops.find(tree.id);
+		bool has_strategy = (crop != population->crops.end() && crop->second.strategy != -1);
+		events.push_back({ time, tree.id, type, tree.position, tree.dbh, has_strategy ? *population->get_strategy(&crop->second) : Strategy() });
+	}
+	bool enabled = false;
+	vector<TreeEvent> events;
+};
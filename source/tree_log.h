@@ -0,0 +1,440 @@
+#pragma once
+#include "output_queue.h"
+#include "mapped_file.h"
+#include "compression.h"
+
+
+// Append-only, columnar log of tree demographics.
+//
+// A tree log consists of a TreeLogHeader followed by chunks, each a TreeLogChunkHeader and a payload compressed with LZCodec.
+// Every call to TreeLogWriter::record_step() appends up to three chunks:
+//   "STRT"  Strategies that occur in the log for the first time. Strategies are dictionary encoded: the other chunks refer to
+//           them by their code, which is their position in the dictionary.
+//   "EVNT"  The demographic events (see TreeEventType) since the previous call, in the order in which they happened.
+//   "SNAP"  A snapshot of all living trees, sorted by id (written every <snapshot_every> timesteps).
+// The payload of a chunk stores its rows column by column. Ids and positions are delta encoded (the difference with the previous
+// row, as a zigzag varint); positions are first quantized to multiples of the header's position resolution. Each chunk is
+// flushed to disk when it is written, so a log of an interrupted run can be read up to its last complete chunk.
+//
+// Columns:
+//   STRT  vector, seed_mass, diaspore_mass, no_seeds_per_diaspore, seed_tspeed, pulp_to_seed_ratio, recruitment_probability,
+//         relative_growth_rate, seed_reserve_mass, seedling_dbh (first code in the chunk header's time field)
+//   EVNT  time, id, type, x, y, dbh, strategy
+//   SNAP  id, x, y, dbh, life_phase, age, strategy
+
+
+inline uint64_t zigzag_encode(int64_t value) {
+	// Map signed to unsigned integers so that values close to zero have short varint encodings (0, -1, 1, -2, ... -> 0, 1, 2, 3, ...).
+	return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+inline int64_t zigzag_decode(uint64_t value) {
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+
+class TreeLogHeader {
+public:
+	char magic[8] = { 'D', 'B', 'R', 'T', 'L', 'O', 'G', '0' };
+	uint32_t version = 1;
+	uint32_t byte_order = 0x01020304;
+	float position_resolution = 0;
+	uint32_t snapshot_every = 0;
+};
+
+
+class TreeLogChunkHeader {
+public:
+	char tag[4] = {};
+	int32_t time = 0;
+	uint32_t no_rows = 0;
+	uint32_t size = 0;				// Uncompressed payload size.
+	uint64_t compressed_size = 0;
+};
+
+
+class TreeLogWriter {
+public:
+	// Attaches to <dynamics>, which records its tree events from now on. The log must be closed (or destroyed) before <dynamics>.
+	TreeLogWriter(string _path, Dynamics& _dynamics, int _snapshot_every = 1, float _position_resolution = 0.001f, int max_pending_steps = 4)
+		: output_queue(max_pending_steps)
+	{
+		path = _path;
+		dynamics = &_dynamics;
+		snapshot_every = max(_snapshot_every, 1);
+		position_resolution = _position_resolution;
+		file = fopen(path.c_str(), "wb");
+		if (file == nullptr) throw std::runtime_error("Could not write tree log to " + path);
+		TreeLogHeader header;
+		header.position_resolution = position_resolution;
+		header.snapshot_every = snapshot_every;
+		if (fwrite(&header, sizeof(header), 1, file) != 1) throw std::runtime_error("Could not write tree log to " + path);
+		dynamics->tree_events = TreeEventRecorder();
+		dynamics->tree_events.enabled = true;
+	}
+	TreeLogWriter(const TreeLogWriter&) = delete;
+	TreeLogWriter& operator=(const TreeLogWriter&) = delete;
+	~TreeLogWriter() {
+		try {
+			close();
+		}
+		catch (std::exception& error) {
+			printf("Error while closing tree log %s: %s\n", path.c_str(), error.what());
+		}
+	}
+	void record_step() {
+		// Log the events since the previous call and, every <snapshot_every> timesteps, a snapshot of the population. The rows are
+		// collected here; they are encoded and written by the output queue while the simulation continues.
+		if (file == nullptr) throw std::runtime_error("Tree log " + path + " is closed.");
+		shared_ptr<StepRows> rows = make_shared<StepRows>();
+		rows->time = dynamics->time;
+		rows->first_new_strategy = strategies.size();
+		for (TreeEvent& event : dynamics->tree_events.events) {
+			rows->events.push_back({ event.time, event.id, (uint8_t)event.type, event.position, event.dbh, 0, get_code(event.strategy) });
+		}
+		dynamics->tree_events.events.clear();
+		if (dynamics->time % snapshot_every == 0) {
+			Population* population = dynamics->pop;
+			vector<int> handle_codes; // Codes of the pool's strategy handles, which are only stable within a timestep.
+			for (auto& [id, tree] : population->members) {
+				int handle = population->get_crop(id)->strategy;
+				if (handle >= (int)handle_codes.size()) handle_codes.resize(handle + 1, -1);
+				if (handle >= 0 && handle_codes[handle] == -1) handle_codes[handle] = get_code(*population->strategies.get(handle));
+				rows->snapshot.push_back({ 0, id, (uint8_t)tree.life_phase, tree.position, tree.dbh, tree.age, (handle >= 0) ? handle_codes[handle] : 0 });
+			}
+			rows->has_snapshot = true;
+		}
+		rows->new_strategies.assign(strategies.begin() + rows->first_new_strategy, strategies.end());
+		output_queue.push([this, rows] { write_step(*rows); });
+	}
+	void close() {
+		// Write all pending rows and close the file. The simulation stops recording events.
+		if (file == nullptr) return;
+		dynamics->tree_events = TreeEventRecorder();
+		try {
+			output_queue.close();
+		}
+		catch (...) {
+			fclose(file);
+			file = nullptr;
+			throw;
+		}
+		bool success = (fclose(file) == 0);
+		file = nullptr;
+		if (!success) throw std::runtime_error("Could not write tree log to " + path);
+	}
+	string path;
+	int snapshot_every = 0;
+	float position_resolution = 0;
+
+private:
+	struct Row {
+		int time;
+		int id;
+		uint8_t type_or_life_phase;
+		pair<float, float> position;
+		float dbh;
+		int age;
+		int strategy;
+	};
+	struct StepRows {
+		int time = 0;
+		vector<Row> events;
+		vector<Row> snapshot;
+		bool has_snapshot = false;
+		int first_new_strategy = 0;
+		vector<Strategy> new_strategies;
+	};
+	int get_code(Strategy& strategy) {
+		auto it = codes.find(strategy);
+		if (it != codes.end()) return it->second;
+		int code = strategies.size();
+		codes[strategy] = code;
+		strategies.push_back(strategy);
+		return code;
+	}
+	void write_step(StepRows& rows) {
+		// Runs on the output queue's thread.
+		vector<char> payload;
+		if (!rows.new_strategies.empty()) {
+			for (Strategy& strategy : rows.new_strategies) put(payload, (int32_t)strategy.vector);
+			for (Strategy& strategy : rows.new_strategies) put(payload, strategy.seed_mass);
+			for (Strategy& strategy : rows.new_strategies) put(payload, strategy.diaspore_mass);
+			for (Strategy& strategy : rows.new_strategies) put(payload, (int32_t)strategy.no_seeds_per_diaspore);
+			for (Strategy& strategy : rows.new_strategies) put(payload, strategy.seed_tspeed);
+			for (Strategy& strategy : rows.new_strategies) put(payload, strategy.pulp_to_seed_ratio);
+			for (Strategy& strategy : rows.new_strategies) put(payload, strategy.recruitment_probability);
+			for (Strategy& strategy : rows.new_strategies) put(payload, strategy.relative_growth_rate);
+			for (Strategy& strategy : rows.new_strategies) put(payload, strategy.seed_reserve_mass);
+			for (Strategy& strategy : rows.new_strategies) put(payload, strategy.seedling_dbh);
+			write_chunk("STRT", rows.first_new_strategy, rows.new_strategies.size(), payload);
+		}
+		payload.clear();
+		int64_t previous = rows.time;
+		for (Row& row : rows.events) put_delta(payload, row.time, previous);
+		put_ids(payload, rows.events);
+		for (Row& row : rows.events) put(payload, row.type_or_life_phase);
+		put_positions(payload, rows.events);
+		for (Row& row : rows.events) put(payload, row.dbh);
+		for (Row& row : rows.events) put_varint(payload, row.strategy);
+		write_chunk("EVNT", rows.time, rows.events.size(), payload);
+		if (!rows.has_snapshot) return;
+
+		payload.clear();
+		sort(rows.snapshot.begin(), rows.snapshot.end(), [](const Row& a, const Row& b) { return a.id < b.id; });
+		put_ids(payload, rows.snapshot);
+		put_positions(payload, rows.snapshot);
+		for (Row& row : rows.snapshot) put(payload, row.dbh);
+		for (Row& row : rows.snapshot) put(payload, row.type_or_life_phase);
+		for (Row& row : rows.snapshot) put_varint(payload, zigzag_encode(row.age));
+		for (Row& row : rows.snapshot) put_varint(payload, row.strategy);
+		write_chunk("SNAP", rows.time, rows.snapshot.size(), payload);
+	}
+	void write_chunk(const char* tag, int time, int no_rows, vector<char>& payload) {
+		TreeLogChunkHeader header;
+		memcpy(header.tag, tag, sizeof(header.tag));
+		header.time = time;
+		header.no_rows = no_rows;
+		header.size = payload.size();
+		LZCodec::compress(payload.data(), payload.size(), compressed);
+		header.compressed_size = compressed.size();
+		bool success = (fwrite(&header, sizeof(header), 1, file) == 1);
+		success = success && (fwrite(compressed.data(), 1, compressed.size(), file) == compressed.size());
+		success = success && (fflush(file) == 0);
+		if (!success) throw std::runtime_error("Could not write tree log to " + path);
+	}
+	template<typename T> static void put(vector<char>& payload, T value) {
+		payload.insert(payload.end(), (const char*)&value, (const char*)&value + sizeof(T));
+	}
+	static void put_varint(vector<char>& payload, uint64_t value) {
+		for (; value >= 128; value >>= 7) payload.push_back((char)(value | 128));
+		payload.push_back((char)value);
+	}
+	static void put_delta(vector<char>& payload, int64_t value, int64_t& previous) {
+		put_varint(payload, zigzag_encode(value - previous));
+		previous = value;
+	}
+	void put_ids(vector<char>& payload, vector<Row>& rows) {
+		int64_t previous = 0;
+		for (Row& row : rows) put_delta(payload, row.id, previous);
+	}
+	void put_positions(vector<char>& payload, vector<Row>& rows) {
+		int64_t previous = 0;
+		for (Row& row : rows) put_delta(payload, llround(row.position.first / position_resolution), previous);
+		previous = 0;
+		for (Row& row : rows) put_delta(payload, llround(row.position.second / position_resolution), previous);
+	}
+	Dynamics* dynamics = 0;
+	FILE* file = nullptr;
+	unordered_map<Strategy, int, StrategyHash> codes;
+	vector<Strategy> strategies;
+	vector<char> compressed;
+	OutputQueue output_queue; // Declared last, so that its thread is stopped before the members it uses are destroyed.
+};
+
+
+class TreeLogTable {
+public:
+	// Rows selected from a tree log, stored column by column. Snapshot rows have no event type; event rows have no life phase or age.
+	vector<int> time;
+	vector<int> id;
+	vector<uint8_t> type;
+	vector<float> x;
+	vector<float> y;
+	vector<float> dbh;
+	vector<uint8_t> life_phase;
+	vector<int> age;
+	vector<int> strategy;
+	size_t size() {
+		return id.size();
+	}
+};
+
+
+class TreeLogReader {
+public:
+	TreeLogReader(string _path) {
+		path = _path;
+		if (!file.open(path)) throw std::runtime_error("Could not open tree log " + path);
+		if (file.size() < sizeof(TreeLogHeader)) throw std::runtime_error(path + " is not a tree log.");
+		memcpy(&header, file.data(), sizeof(header));
+		TreeLogHeader expected;
+		if (memcmp(header.magic, expected.magic, sizeof(expected.magic)) != 0) throw std::runtime_error(path + " is not a tree log.");
+		if (header.byte_order != expected.byte_order) throw std::runtime_error(path + " was written on a machine with a different byte order.");
+		if (header.version != expected.version) throw std::runtime_error("Unsupported tree log version in " + path);
+
+		// Locate the chunks; an incomplete last chunk is ignored.
+		size_t offset = sizeof(header);
+		int previous_event_time = INT_MIN;
+		while (offset + sizeof(TreeLogChunkHeader) <= file.size()) {
+			Chunk chunk;
+			memcpy(&chunk.header, file.data() + offset, sizeof(chunk.header));
+			chunk.offset = offset + sizeof(chunk.header);
+			if (chunk.header.compressed_size > file.size() - chunk.offset) break;
+			string tag(chunk.header.tag, sizeof(chunk.header.tag));
+			if (tag == "EVNT") {
+				chunk.first_time = previous_event_time;
+				previous_event_time = chunk.header.time;
+			}
+			if (tag == "STRT") read_strategies(chunk);
+			else chunks.push_back(chunk);
+			offset = chunk.offset + chunk.header.compressed_size;
+		}
+	}
+	TreeLogTable get_events(int begin_time = INT_MIN, int end_time = INT_MAX, vector<int> ids = {}) {
+		// Events with begin_time <= time <= end_time, optionally only those of the trees in <ids>.
+		TreeLogTable table;
+		sort(ids.begin(), ids.end());
+		vector<char> payload;
+		for (Chunk& chunk : chunks) {
+			if (string(chunk.header.tag, 4) != "EVNT") continue;
+			if (chunk.header.time < begin_time || chunk.first_time >= end_time) continue; // Events lie in (first_time, time].
+			int n = chunk.header.no_rows;
+			ColumnReader column = decompress(chunk, payload);
+			vector<int> time = column.get_deltas<int>(n, chunk.header.time);
+			vector<int> id = column.get_deltas<int>(n, 0);
+			vector<uint8_t> type = column.get_values<uint8_t>(n);
+			vector<float> x = get_positions(column, n);
+			vector<float> y = get_positions(column, n);
+			vector<float> dbh = column.get_values<float>(n);
+			vector<int> strategy = column.get_varints<int>(n);
+			for (int i = 0; i < n; i++) {
+				if (time[i] < begin_time || time[i] > end_time || !contains(ids, id[i])) continue;
+				table.time.push_back(time[i]);
+				table.id.push_back(id[i]);
+				table.type.push_back(type[i]);
+				table.x.push_back(x[i]);
+				table.y.push_back(y[i]);
+				table.dbh.push_back(dbh[i]);
+				table.strategy.push_back(strategy[i]);
+			}
+		}
+		return table;
+	}
+	TreeLogTable get_snapshots(int begin_time = INT_MIN, int end_time = INT_MAX, vector<int> ids = {}) {
+		// Snapshot rows with begin_time <= time <= end_time, optionally only those of the trees in <ids>.
+		TreeLogTable table;
+		sort(ids.begin(), ids.end());
+		vector<char> payload;
+		for (Chunk& chunk : chunks) {
+			if (string(chunk.header.tag, 4) != "SNAP") continue;
+			if (chunk.header.time < begin_time || chunk.header.time > end_time) continue;
+			int n = chunk.header.no_rows;
+			ColumnReader column = decompress(chunk, payload);
+			vector<int> id = column.get_deltas<int>(n, 0);
+			vector<float> x = get_positions(column, n);
+			vector<float> y = get_positions(column, n);
+			vector<float> dbh = column.get_values<float>(n);
+			vector<uint8_t> life_phase = column.get_values<uint8_t>(n);
+			vector<int> age = column.get_deltas<int>(n, 0, false);
+			vector<int> strategy = column.get_varints<int>(n);
+			for (int i = 0; i < n; i++) {
+				if (!contains(ids, id[i])) continue;
+				table.time.push_back(chunk.header.time);
+				table.id.push_back(id[i]);
+				table.x.push_back(x[i]);
+				table.y.push_back(y[i]);
+				table.dbh.push_back(dbh[i]);
+				table.life_phase.push_back(life_phase[i]);
+				table.age.push_back(age[i]);
+				table.strategy.push_back(strategy[i]);
+			}
+		}
+		return table;
+	}
+	vector<int> get_snapshot_times() {
+		vector<int> times;
+		for (Chunk& chunk : chunks) {
+			if (string(chunk.header.tag, 4) == "SNAP") times.push_back(chunk.header.time);
+		}
+		return times;
+	}
+	string path;
+	TreeLogHeader header;
+	vector<Strategy> strategies; // Strategy dictionary; rows refer to strategies by their index.
+
+private:
+	struct Chunk {
+		TreeLogChunkHeader header;
+		size_t offset = 0;
+		int first_time = INT_MIN;
+	};
+	class ColumnReader {
+	public:
+		ColumnReader(const vector<char>& _payload) : payload(_payload) {}
+		template<typename T> vector<T> get_values(int n) {
+			if (sizeof(T) * n > payload.size() - position) throw std::runtime_error("Corrupt tree log chunk.");
+			vector<T> values(n);
+			memcpy(values.data(), payload.data() + position, sizeof(T) * n);
+			position += sizeof(T) * n;
+			return values;
+		}
+		template<typename T> vector<T> get_varints(int n) {
+			vector<T> values(n);
+			for (int i = 0; i < n; i++) values[i] = get_varint();
+			return values;
+		}
+		template<typename T> vector<T> get_deltas(int n, int64_t previous, bool cumulative = true) {
+			// Decode zigzag varints, each the difference with the previous value (or, if not <cumulative>, with <previous>).
+			vector<T> values(n);
+			int64_t base = previous;
+			for (int i = 0; i < n; i++) {
+				int64_t value = base + zigzag_decode(get_varint());
+				values[i] = value;
+				if (cumulative) base = value;
+			}
+			return values;
+		}
+	private:
+		uint64_t get_varint() {
+			uint64_t value = 0;
+			for (int shift = 0; shift < 64; shift += 7) {
+				if (position >= payload.size()) break;
+				uint8_t byte = payload[position++];
+				value |= (uint64_t)(byte & 127) << shift;
+				if (byte < 128) return value;
+			}
+			throw std::runtime_error("Corrupt tree log chunk.");
+		}
+		const vector<char>& payload;
+		size_t position = 0;
+	};
+	ColumnReader decompress(Chunk& chunk, vector<char>& payload) {
+		payload.resize(chunk.header.size);
+		LZCodec::decompress(file.data() + chunk.offset, chunk.header.compressed_size, payload.data(), payload.size());
+		return ColumnReader(payload);
+	}
+	vector<float> get_positions(ColumnReader& column, int n) {
+		vector<int64_t> quantized = column.get_deltas<int64_t>(n, 0);
+		vector<float> positions(n);
+		for (int i = 0; i < n; i++) positions[i] = quantized[i] * header.position_resolution;
+		return positions;
+	}
+	static bool contains(vector<int>& sorted_ids, int id) {
+		return sorted_ids.empty() || binary_search(sorted_ids.begin(), sorted_ids.end(), id);
+	}
+	void read_strategies(Chunk& chunk) {
+		vector<char> payload;
+		ColumnReader column = decompress(chunk, payload);
+		int n = chunk.header.no_rows;
+		if (chunk.header.time != strategies.size()) throw std::runtime_error("Corrupt strategy dictionary in tree log " + path);
+		vector<int32_t> dispersal_vector = column.get_values<int32_t>(n);
+		vector<float> seed_mass = column.get_values<float>(n);
+		vector<float> diaspore_mass = column.get_values<float>(n);
+		vector<int32_t> no_seeds_per_diaspore = column.get_values<int32_t>(n);
+		vector<float> seed_tspeed = column.get_values<float>(n);
+		vector<float> pulp_to_seed_ratio = column.get_values<float>(n);
+		vector<float> recruitment_probability = column.get_values<float>(n);
+		vector<float> relative_growth_rate = column.get_values<float>(n);
+		vector<float> seed_reserve_mass = column.get_values<float>(n);
+		vector<float> seedling_dbh = column.get_values<float>(n);
+		for (int i = 0; i < n; i++) {
+			strategies.push_back(Strategy(
+				(DispersalVector)dispersal_vector[i], seed_mass[i], diaspore_mass[i], no_seeds_per_diaspore[i], seed_tspeed[i], pulp_to_seed_ratio[i],
+				recruitment_probability[i], seedling_dbh[i], relative_growth_rate[i], seed_reserve_mass[i]
+			));
+		}
+	}
+	MappedFile file;
+	vector<Chunk> chunks;
+};